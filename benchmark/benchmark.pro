@@ -0,0 +1,16 @@
+include(../common.pri)
+
+TEMPLATE = app
+TARGET = QDbfBenchmark
+DESTDIR = $$BUILD_TREE/bin
+
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+# the number parser is internal to the library and not exported
+HEADERS += \
+    ../src/qdbfnumeric_p.h
+SOURCES += \
+    main.cpp \
+    ../src/qdbfnumeric.cpp
@@ -0,0 +1,120 @@
+#include "qdbfnumeric_p.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Times the in place N/F field parser against the QByteArray::mid() and
+// toDouble() path records used before it, on right-justified N(12,2)
+// values laid out like the fields of consecutive records.
+
+const int FIELD_LENGTH = 12;
+const int FIELD_SCALE = 2;
+const int DEFAULT_VALUES_COUNT = 1000000;
+const int ROUNDS = 5;
+
+typedef double (*SumFunction)(const QByteArray &fields, int count);
+
+static QByteArray makeFields(int count)
+{
+    QByteArray fields;
+    fields.reserve(count * FIELD_LENGTH);
+
+    for (int i = 0; i < count; ++i) {
+        // every fiftieth value is blank, like an unset field
+        if (i % 50 == 0) {
+            fields.append(QByteArray(FIELD_LENGTH, ' '));
+            continue;
+        }
+        const qint64 cents = static_cast<qint64>(i) * 7919 % 20000000 - 10000000;
+        const QByteArray value = QByteArray::number(static_cast<double>(cents) / 100.0, 'f',
+                                                    FIELD_SCALE);
+        fields.append(value.rightJustified(FIELD_LENGTH, ' '));
+    }
+
+    return fields;
+}
+
+static double sumToDouble(const QByteArray &fields, int count)
+{
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += fields.mid(i * FIELD_LENGTH, FIELD_LENGTH).toDouble();
+    }
+
+    return sum;
+}
+
+static double sumParseNumber(const QByteArray &fields, int count)
+{
+    const char *data = fields.constData();
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        double value = 0.0;
+        QDbf::Internal::parseNumber(data + i * FIELD_LENGTH, FIELD_LENGTH, &value);
+        sum += value;
+    }
+
+    return sum;
+}
+
+static double sumParseScaledNumber(const QByteArray &fields, int count)
+{
+    const char *data = fields.constData();
+    qint64 sum = 0;
+    for (int i = 0; i < count; ++i) {
+        qint64 value = 0;
+        QDbf::Internal::parseScaledNumber(data + i * FIELD_LENGTH, FIELD_LENGTH, FIELD_SCALE,
+                                          &value);
+        sum += value;
+    }
+
+    return static_cast<double>(sum) / 100.0;
+}
+
+static qint64 bestTime(SumFunction function, const QByteArray &fields, int count, double *sum)
+{
+    qint64 best = -1;
+    for (int round = 0; round < ROUNDS; ++round) {
+        QElapsedTimer timer;
+        timer.start();
+        *sum = function(fields, count);
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+static void report(const char *name, qint64 elapsed, qint64 baseline, int count, double sum)
+{
+    printf("%-24s %10.2f ms %8.1f ns/value %6.2fx   sum %.2f\n", name,
+           static_cast<double>(elapsed) / 1e6, static_cast<double>(elapsed) / count,
+           static_cast<double>(baseline) / static_cast<double>(qMax(Q_INT64_C(1), elapsed)),
+           sum);
+}
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? qMax(1, atoi(argv[1])) : DEFAULT_VALUES_COUNT;
+    const QByteArray fields = makeFields(count);
+
+    printf("%d N(%d,%d) values, best of %d rounds\n", count, FIELD_LENGTH, FIELD_SCALE, ROUNDS);
+
+    double toDoubleSum = 0.0;
+    double parseSum = 0.0;
+    double scaledSum = 0.0;
+    const qint64 toDoubleTime = bestTime(sumToDouble, fields, count, &toDoubleSum);
+    const qint64 parseTime = bestTime(sumParseNumber, fields, count, &parseSum);
+    const qint64 scaledTime = bestTime(sumParseScaledNumber, fields, count, &scaledSum);
+
+    report("mid().toDouble()", toDoubleTime, toDoubleTime, count, toDoubleSum);
+    report("parseNumber()", parseTime, toDoubleTime, count, parseSum);
+    report("parseScaledNumber()", scaledTime, toDoubleTime, count, scaledSum);
+
+    return 0;
+}
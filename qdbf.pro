@@ -2,4 +2,5 @@ TARGET = qdbf
 TEMPLATE = subdirs
 CONFIG += ordered 
 SUBDIRS = src \
-          example
+          example \
+          benchmark
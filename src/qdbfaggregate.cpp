@@ -0,0 +1,494 @@
+#include "qdbfaggregate.h"
+#include "qdbfaggregate_p.h"
+
+#include "qdbfnumeric_p.h"
+#include "qdbfrecord.h"
+#include "qdbfrecordview.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QVariant>
+
+#include <float.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DATE_LENGTH = 8;
+const int MAX_SCALE = 17;
+
+class QDbfAggregatePrivate
+{
+public:
+    QDbfAggregatePrivate();
+
+    double value(qint64 scaledValue) const;
+
+    QAtomicInt ref;
+    QString m_fieldName;
+    QDbfField::QDbfType m_type;
+    int m_scale;
+    bool m_scaled;
+    double m_scaleFactor;
+    qint64 m_recordsCount;
+    QDbfAccumulator m_accumulator;
+};
+
+QDbfAggregatePrivate::QDbfAggregatePrivate() :
+    ref(1),
+    m_type(QDbfField::UnknownDataType),
+    m_scale(0),
+    m_scaled(false),
+    m_scaleFactor(1.0),
+    m_recordsCount(0)
+{
+}
+
+double QDbfAggregatePrivate::value(qint64 scaledValue) const
+{
+    return static_cast<double>(scaledValue) / m_scaleFactor;
+}
+
+static bool isBlank(const char *data, int length)
+{
+    for (int i = 0; i < length; ++i) {
+        if (data[i] != ' ') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QDbfAccumulator::QDbfAccumulator() :
+    count(0),
+    blankCount(0),
+    invalidCount(0),
+    exact(true),
+    scaledSum(0),
+    sum(0.0),
+    scaledMinimum(Q_INT64_C(0x7FFFFFFFFFFFFFFF)),
+    scaledMaximum(-Q_INT64_C(0x7FFFFFFFFFFFFFFF) - 1),
+    minimum(DBL_MAX),
+    maximum(-DBL_MAX)
+{
+}
+
+void QDbfAccumulator::addScaled(qint64 value)
+{
+    ++count;
+
+    // past the range of qint64 the sum goes on in double, still in scaled units
+    if (exact) {
+        if ((value > 0 && scaledSum > Q_INT64_C(0x7FFFFFFFFFFFFFFF) - value) ||
+            (value < 0 && scaledSum < -Q_INT64_C(0x7FFFFFFFFFFFFFFF) - 1 - value)) {
+            exact = false;
+            sum = static_cast<double>(scaledSum) + static_cast<double>(value);
+        } else {
+            scaledSum += value;
+        }
+    } else {
+        sum += static_cast<double>(value);
+    }
+
+    scaledMinimum = qMin(scaledMinimum, value);
+    scaledMaximum = qMax(scaledMaximum, value);
+}
+
+void QDbfAccumulator::addDouble(double value)
+{
+    ++count;
+
+    // scaled fields land here with values past the range of qint64
+    if (exact) {
+        exact = false;
+        sum = static_cast<double>(scaledSum);
+    }
+    sum += value;
+    minimum = qMin(minimum, value);
+    maximum = qMax(maximum, value);
+}
+
+void QDbfAccumulator::merge(const QDbfAccumulator &other)
+{
+    count += other.count;
+    blankCount += other.blankCount;
+    invalidCount += other.invalidCount;
+
+    if (exact && other.exact) {
+        const qint64 value = other.scaledSum;
+        if ((value > 0 && scaledSum > Q_INT64_C(0x7FFFFFFFFFFFFFFF) - value) ||
+            (value < 0 && scaledSum < -Q_INT64_C(0x7FFFFFFFFFFFFFFF) - 1 - value)) {
+            exact = false;
+            sum = static_cast<double>(scaledSum) + static_cast<double>(value);
+        } else {
+            scaledSum += value;
+        }
+    } else {
+        sum = (exact ? static_cast<double>(scaledSum) : sum) +
+                (other.exact ? static_cast<double>(other.scaledSum) : other.sum);
+        exact = false;
+    }
+
+    scaledMinimum = qMin(scaledMinimum, other.scaledMinimum);
+    scaledMaximum = qMax(scaledMaximum, other.scaledMaximum);
+    minimum = qMin(minimum, other.minimum);
+    maximum = qMax(maximum, other.maximum);
+}
+
+QDbfAggregator::QDbfAggregator()
+{
+}
+
+QDbfAggregator::~QDbfAggregator()
+{
+    qDeleteAll(m_partials);
+}
+
+bool QDbfAggregator::addField(const QDbfRecord &record, const QString &fieldName)
+{
+    const int index = record.indexOf(fieldName);
+    if (index < 0) {
+        qWarning("QDbfAggregator::addField(): no field %s", qPrintable(fieldName));
+        return false;
+    }
+
+    const QDbfField field = record.field(index);
+
+    Field aggregated;
+    aggregated.name = field.name();
+    aggregated.type = field.dbfType();
+    aggregated.offset = field.offset();
+    aggregated.length = field.length();
+    aggregated.scale = 0;
+    aggregated.scaleFactor = 1.0;
+    aggregated.scaled = true;
+
+    switch (aggregated.type) {
+    case QDbfField::Number:
+        // precisions the scaled parser can not represent are summed in double
+        aggregated.scale = qMax(0, field.precision());
+        aggregated.scaled = aggregated.scale <= MAX_SCALE;
+        for (int i = 0; i < aggregated.scale; ++i) {
+            aggregated.scaleFactor *= 10.0;
+        }
+        break;
+    case QDbfField::FloatingPoint:
+        aggregated.scaled = false;
+        break;
+    case QDbfField::Date:
+        if (aggregated.length < DATE_LENGTH) {
+            return false;
+        }
+        break;
+    case QDbfField::Logical:
+        if (aggregated.length < 1) {
+            return false;
+        }
+        break;
+    default:
+        qWarning("QDbfAggregator::addField(): field %s can not be aggregated",
+                 qPrintable(fieldName));
+        return false;
+    }
+
+    m_fields.append(aggregated);
+
+    return true;
+}
+
+void QDbfAggregator::setThreadCount(int threadCount)
+{
+    qDeleteAll(m_partials);
+    m_partials.clear();
+
+    for (int i = 0; i < threadCount; ++i) {
+        Partial *partial = new Partial();
+        partial->recordsCount = 0;
+        partial->accumulators.resize(m_fields.size());
+        m_partials.append(partial);
+    }
+}
+
+bool QDbfAggregator::processRecord(const QDbfRecordView &record, int threadIndex)
+{
+    Partial *partial = m_partials.at(threadIndex);
+    ++partial->recordsCount;
+
+    const char *data = record.data();
+    for (int i = 0; i < m_fields.size(); ++i) {
+        const Field &field = m_fields.at(i);
+        add(field, data + field.offset, &partial->accumulators[i]);
+    }
+
+    return true;
+}
+
+void QDbfAggregator::add(const Field &field, const char *data, QDbfAccumulator *accumulator) const
+{
+    switch (field.type) {
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint: {
+        NumberStatus status;
+        if (field.scaled) {
+            qint64 value = 0;
+            status = parseScaledNumber(data, field.length, field.scale, &value);
+            if (status == NumberValid) {
+                accumulator->addScaled(value);
+            } else if (status == NumberOverflow) {
+                // too many digits for qint64, '*' filled fields stay invalid
+                double number = 0.0;
+                status = parseNumber(data, field.length, &number);
+                if (status == NumberValid) {
+                    accumulator->addDouble(number * field.scaleFactor);
+                }
+            }
+        } else {
+            double value = 0.0;
+            status = parseNumber(data, field.length, &value);
+            if (status == NumberValid) {
+                accumulator->addDouble(value);
+            }
+        }
+        if (status == NumberBlank) {
+            ++accumulator->blankCount;
+        } else if (status != NumberValid) {
+            ++accumulator->invalidCount;
+        }
+        break;
+    }
+    case QDbfField::Date: {
+        // YYYYMMDD as a number orders like the date
+        const int value = parseDigits(data, DATE_LENGTH);
+        if (value >= 0) {
+            accumulator->addScaled(value);
+        } else if (isBlank(data, DATE_LENGTH)) {
+            ++accumulator->blankCount;
+        } else {
+            ++accumulator->invalidCount;
+        }
+        break;
+    }
+    case QDbfField::Logical:
+        switch (data[0]) {
+        case 'T': case 't': case 'Y': case 'y':
+            accumulator->addScaled(1);
+            break;
+        case 'F': case 'f': case 'N': case 'n':
+            accumulator->addScaled(0);
+            break;
+        case ' ': case '?':
+            ++accumulator->blankCount;
+            break;
+        default:
+            ++accumulator->invalidCount;
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+QVector<QDbfAggregate> QDbfAggregator::results() const
+{
+    qint64 recordsCount = 0;
+    for (int i = 0; i < m_partials.size(); ++i) {
+        recordsCount += m_partials.at(i)->recordsCount;
+    }
+
+    QVector<QDbfAggregate> results;
+    results.reserve(m_fields.size());
+
+    for (int i = 0; i < m_fields.size(); ++i) {
+        const Field &field = m_fields.at(i);
+
+        QDbfAggregate aggregate;
+        QDbfAggregatePrivate *d = aggregate.d;
+        d->m_fieldName = field.name;
+        d->m_type = field.type;
+        d->m_scale = field.scale;
+        d->m_scaled = field.scaled;
+        d->m_scaleFactor = field.scaleFactor;
+        d->m_recordsCount = recordsCount;
+        for (int j = 0; j < m_partials.size(); ++j) {
+            d->m_accumulator.merge(m_partials.at(j)->accumulators.at(i));
+        }
+
+        results.append(aggregate);
+    }
+
+    return results;
+}
+
+} // namespace Internal
+
+QDbfAggregate::QDbfAggregate() :
+    d(new Internal::QDbfAggregatePrivate())
+{
+}
+
+QDbfAggregate::QDbfAggregate(const QDbfAggregate &other) :
+    d(other.d)
+{
+    d->ref.ref();
+}
+
+QDbfAggregate &QDbfAggregate::operator=(const QDbfAggregate &other)
+{
+    if (this == &other) return *this;
+    qAtomicAssign(d, other.d);
+    return *this;
+}
+
+QDbfAggregate::~QDbfAggregate()
+{
+    if (!d->ref.deref()) {
+        delete d;
+    }
+}
+
+bool QDbfAggregate::isValid() const
+{
+    return d->m_type != QDbfField::UnknownDataType;
+}
+
+QString QDbfAggregate::fieldName() const
+{
+    return d->m_fieldName;
+}
+
+QDbfField::QDbfType QDbfAggregate::fieldType() const
+{
+    return d->m_type;
+}
+
+qint64 QDbfAggregate::recordsCount() const
+{
+    return d->m_recordsCount;
+}
+
+qint64 QDbfAggregate::count() const
+{
+    return d->m_accumulator.count;
+}
+
+qint64 QDbfAggregate::blankCount() const
+{
+    return d->m_accumulator.blankCount;
+}
+
+qint64 QDbfAggregate::invalidCount() const
+{
+    return d->m_accumulator.invalidCount;
+}
+
+QVariant QDbfAggregate::sum() const
+{
+    const Internal::QDbfAccumulator &accumulator = d->m_accumulator;
+    if (accumulator.count == 0) {
+        return QVariant();
+    }
+
+    switch (d->m_type) {
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint:
+        if (!d->m_scaled) {
+            return accumulator.sum;
+        }
+        return accumulator.exact ? d->value(accumulator.scaledSum) : accumulator.sum / d->m_scaleFactor;
+    case QDbfField::Logical:
+        return accumulator.scaledSum;
+    default:
+        return QVariant();
+    }
+}
+
+qint64 QDbfAggregate::scaledSum(bool *exact) const
+{
+    // only sums of N fields kept as scaled integers are exact
+    const bool isExact = d->m_scaled && d->m_accumulator.exact &&
+            (d->m_type == QDbfField::Number || d->m_type == QDbfField::Logical);
+
+    if (exact) {
+        *exact = isExact;
+    }
+
+    return isExact ? d->m_accumulator.scaledSum : 0;
+}
+
+int QDbfAggregate::scale() const
+{
+    return d->m_scale;
+}
+
+QVariant QDbfAggregate::average() const
+{
+    if (d->m_accumulator.count == 0 ||
+        (d->m_type != QDbfField::Number && d->m_type != QDbfField::FloatingPoint)) {
+        return QVariant();
+    }
+
+    return sum().toDouble() / static_cast<double>(d->m_accumulator.count);
+}
+
+QVariant QDbfAggregate::minimum() const
+{
+    const Internal::QDbfAccumulator &accumulator = d->m_accumulator;
+    if (accumulator.count == 0) {
+        return QVariant();
+    }
+
+    switch (d->m_type) {
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint:
+        if (!d->m_scaled) {
+            return accumulator.minimum;
+        }
+        // values past the range of qint64 are kept in double, in scaled units
+        if (accumulator.scaledMinimum > accumulator.scaledMaximum) {
+            return accumulator.minimum / d->m_scaleFactor;
+        }
+        return qMin(static_cast<double>(accumulator.scaledMinimum), accumulator.minimum) /
+                d->m_scaleFactor;
+    case QDbfField::Date: {
+        const int value = static_cast<int>(accumulator.scaledMinimum);
+        return QDate(value / 10000, value / 100 % 100, value % 100);
+    }
+    case QDbfField::Logical:
+        return accumulator.scaledMinimum != 0;
+    default:
+        return QVariant();
+    }
+}
+
+QVariant QDbfAggregate::maximum() const
+{
+    const Internal::QDbfAccumulator &accumulator = d->m_accumulator;
+    if (accumulator.count == 0) {
+        return QVariant();
+    }
+
+    switch (d->m_type) {
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint:
+        if (!d->m_scaled) {
+            return accumulator.maximum;
+        }
+        if (accumulator.scaledMinimum > accumulator.scaledMaximum) {
+            return accumulator.maximum / d->m_scaleFactor;
+        }
+        return qMax(static_cast<double>(accumulator.scaledMaximum), accumulator.maximum) /
+                d->m_scaleFactor;
+    case QDbfField::Date: {
+        const int value = static_cast<int>(accumulator.scaledMaximum);
+        return QDate(value / 10000, value / 100 % 100, value % 100);
+    }
+    case QDbfField::Logical:
+        return accumulator.scaledMaximum != 0;
+    default:
+        return QVariant();
+    }
+}
+
+} // namespace QDbf
@@ -0,0 +1,54 @@
+#ifndef QDBFAGGREGATE_H
+#define QDBFAGGREGATE_H
+
+#include "qdbf_global.h"
+#include "qdbffield.h"
+
+QT_BEGIN_NAMESPACE
+class QString;
+class QVariant;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfAggregatePrivate;
+class QDbfAggregator;
+} // namespace Internal
+
+// Count, sum, minimum and maximum of one N, F, D or L field as computed by
+// QDbfTable::aggregate(). N fields are summed exactly as integers scaled by
+// their precision; only values or a sum beyond the range of qint64 fall
+// back to double. The sum of an L field is the number of true values.
+class QDBF_EXPORT QDbfAggregate
+{
+public:
+    QDbfAggregate();
+    QDbfAggregate(const QDbfAggregate &other);
+    QDbfAggregate &operator=(const QDbfAggregate &other);
+    ~QDbfAggregate();
+
+    bool isValid() const;
+    QString fieldName() const;
+    QDbfField::QDbfType fieldType() const;
+
+    qint64 recordsCount() const;
+    qint64 count() const;
+    qint64 blankCount() const;
+    qint64 invalidCount() const;
+
+    QVariant sum() const;
+    qint64 scaledSum(bool *exact = 0) const;
+    int scale() const;
+    QVariant average() const;
+    QVariant minimum() const;
+    QVariant maximum() const;
+
+private:
+    Internal::QDbfAggregatePrivate *d;
+
+    friend class Internal::QDbfAggregator;
+};
+
+} // namespace QDbf
+
+#endif // QDBFAGGREGATE_H
@@ -0,0 +1,78 @@
+#ifndef QDBFAGGREGATE_P_H
+#define QDBFAGGREGATE_P_H
+
+#include "qdbfaggregate.h"
+#include "qdbftable.h"
+
+#include <QString>
+#include <QVector>
+
+namespace QDbf {
+namespace Internal {
+
+// running values of one field, one set per scanning thread
+struct QDbfAccumulator
+{
+    QDbfAccumulator();
+
+    void addScaled(qint64 value);
+    void addDouble(double value);
+    void merge(const QDbfAccumulator &other);
+
+    qint64 count;
+    qint64 blankCount;
+    qint64 invalidCount;
+    bool exact;
+    qint64 scaledSum;
+    double sum;
+    qint64 scaledMinimum;
+    qint64 scaledMaximum;
+    double minimum;
+    double maximum;
+};
+
+// Collects the aggregates of some fields from the stored bytes of the
+// records handed to it by QDbfTable::scanParallel().
+class QDbfAggregator : public QDbfScanHandler
+{
+public:
+    QDbfAggregator();
+    ~QDbfAggregator();
+
+    bool addField(const QDbfRecord &record, const QString &fieldName);
+    void setThreadCount(int threadCount);
+
+    bool processRecord(const QDbfRecordView &record, int threadIndex);
+    QVector<QDbfAggregate> results() const;
+
+private:
+    Q_DISABLE_COPY(QDbfAggregator)
+
+    struct Field
+    {
+        QString name;
+        QDbfField::QDbfType type;
+        int offset;
+        int length;
+        int scale;
+        double scaleFactor;
+        bool scaled;
+    };
+
+    // allocated one by one, so threads never write to the same cache line
+    struct Partial
+    {
+        qint64 recordsCount;
+        QVector<QDbfAccumulator> accumulators;
+    };
+
+    void add(const Field &field, const char *data, QDbfAccumulator *accumulator) const;
+
+    QVector<Field> m_fields;
+    QVector<Partial *> m_partials;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFAGGREGATE_P_H
@@ -0,0 +1,810 @@
+#include "qdbfarrowwriter.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbffield.h"
+#include "qdbfmemofile_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfreader_p.h"
+#include "qdbfrecord.h"
+#include "qdbftable_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DEFAULT_ARROW_BATCH_SIZE = 64 * 1024;
+const int ARROW_ALIGNMENT = 8;
+const int ARROW_BLOCK_LENGTH = 24;
+const char ARROW_MAGIC[] = "ARROW1";
+const int ARROW_MAGIC_LENGTH = 6;
+const quint32 ARROW_CONTINUATION = 0xFFFFFFFF;
+const int DATE_LENGTH = 8;
+const int MAX_DECIMAL_SCALE = 17;
+// every 18 digit value fits the qint64 the decimals are parsed into
+const int MAX_DECIMAL_PRECISION = 18;
+const int DECIMAL_BIT_WIDTH = 128;
+const int UNIX_EPOCH_JULIAN_DAY = 2440588;
+const char DELETED_MARK = '*';
+
+// values of the Arrow flatbuffers schema (Schema.fbs, Message.fbs, File.fbs)
+const int METADATA_V5 = 4;
+const int HEADER_SCHEMA = 1;
+const int HEADER_RECORD_BATCH = 3;
+const int TYPE_FLOATING_POINT = 3;
+const int TYPE_UTF8 = 5;
+const int TYPE_BOOL = 6;
+const int TYPE_DECIMAL = 7;
+const int TYPE_DATE = 8;
+const int PRECISION_DOUBLE = 2;
+const int DATE_UNIT_DAY = 0;
+const int ENDIANNESS_LITTLE = 0;
+
+static inline void setBit(QByteArray *bits, int index)
+{
+    (*bits)[index / 8] = static_cast<char>((*bits)[index / 8] | (1 << (index % 8)));
+}
+
+static void appendLittleEndian(QByteArray *out, quint64 value, int size)
+{
+    char bytes[8];
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out->append(bytes, size);
+}
+
+static void writeLittleEndian(char *out, quint64 value, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+static void padTo(QByteArray *data, int alignment)
+{
+    const int padding = (alignment - data->size() % alignment) % alignment;
+    if (padding > 0) {
+        data->append(QByteArray(padding, '\0'));
+    }
+}
+
+// Just enough of a flatbuffers builder for the Arrow metadata. Like the
+// reference builder it fills the buffer back to front, so an object is
+// complete before anything refers to it and all offsets point forward.
+// Offsets returned here count from the end of the buffer.
+class QDbfFlatBufferBuilder
+{
+public:
+    QDbfFlatBufferBuilder();
+
+    int createString(const QByteArray &string);
+    int createStructVector(const QByteArray &elements, int count, int alignment);
+    int createOffsetVector(const QVector<int> &offsets);
+
+    // tables can not be nested, their strings, vectors and child tables
+    // have to be created before startTable()
+    void startTable();
+    void addScalar(int field, qint64 value, int size);
+    void addOffset(int field, int offset);
+    int endTable();
+
+    QByteArray finish(int root);
+
+private:
+    void prepare(int alignment, int additional);
+    void push(quint64 value, int size);
+    void setField(int field);
+    inline int offset() const { return m_data.size(); }
+
+    QByteArray m_data;
+    QVector<int> m_fields;
+    int m_tableEnd;
+    int m_minAlignment;
+};
+
+QDbfFlatBufferBuilder::QDbfFlatBufferBuilder() :
+    m_tableEnd(0),
+    m_minAlignment(1)
+{
+}
+
+void QDbfFlatBufferBuilder::prepare(int alignment, int additional)
+{
+    m_minAlignment = qMax(m_minAlignment, alignment);
+    const int padding = (alignment - (m_data.size() + additional) % alignment) % alignment;
+    if (padding > 0) {
+        m_data.prepend(QByteArray(padding, '\0'));
+    }
+}
+
+void QDbfFlatBufferBuilder::push(quint64 value, int size)
+{
+    char bytes[8];
+    writeLittleEndian(bytes, value, size);
+    m_data.prepend(QByteArray(bytes, size));
+}
+
+void QDbfFlatBufferBuilder::setField(int field)
+{
+    while (m_fields.size() <= field) {
+        m_fields.append(0);
+    }
+    m_fields[field] = offset();
+}
+
+int QDbfFlatBufferBuilder::createString(const QByteArray &string)
+{
+    prepare(4, string.size() + 1);
+    push(0, 1);
+    m_data.prepend(string);
+    push(string.size(), 4);
+
+    return offset();
+}
+
+int QDbfFlatBufferBuilder::createStructVector(const QByteArray &elements, int count,
+                                              int alignment)
+{
+    prepare(4, elements.size());
+    prepare(alignment, elements.size());
+    m_data.prepend(elements);
+    push(count, 4);
+
+    return offset();
+}
+
+int QDbfFlatBufferBuilder::createOffsetVector(const QVector<int> &offsets)
+{
+    prepare(4, 4 * offsets.size());
+    for (int i = offsets.size() - 1; i >= 0; --i) {
+        push(offset() + 4 - offsets.at(i), 4);
+    }
+    push(offsets.size(), 4);
+
+    return offset();
+}
+
+void QDbfFlatBufferBuilder::startTable()
+{
+    m_fields.clear();
+    m_tableEnd = offset();
+}
+
+void QDbfFlatBufferBuilder::addScalar(int field, qint64 value, int size)
+{
+    prepare(size, 0);
+    push(static_cast<quint64>(value), size);
+    setField(field);
+}
+
+void QDbfFlatBufferBuilder::addOffset(int field, int target)
+{
+    prepare(4, 0);
+    push(offset() + 4 - target, 4);
+    setField(field);
+}
+
+int QDbfFlatBufferBuilder::endTable()
+{
+    // the table starts with the distance back to its vtable, which is
+    // written right in front of it
+    prepare(4, 0);
+    push(0, 4);
+    const int table = offset();
+
+    for (int i = m_fields.size() - 1; i >= 0; --i) {
+        push(m_fields.at(i) ? table - m_fields.at(i) : 0, 2);
+    }
+    push(table - m_tableEnd, 2);
+    push(2 * (m_fields.size() + 2), 2);
+
+    writeLittleEndian(m_data.data() + m_data.size() - table, offset() - table, 4);
+    m_fields.clear();
+
+    return table;
+}
+
+QByteArray QDbfFlatBufferBuilder::finish(int root)
+{
+    prepare(m_minAlignment, 4);
+    push(offset() + 4 - root, 4);
+
+    return m_data;
+}
+
+struct QDbfArrowColumn
+{
+    QDbfField::QDbfType dbfType;
+    int type;
+    int offset;
+    int length;
+    int scale;
+    int precision;
+    QByteArray name;
+};
+
+class QDbfArrowWriterPrivate
+{
+public:
+    QDbfArrowWriterPrivate();
+
+    bool setColumns(const QDbfTablePrivate *table);
+    int createSchema(QDbfFlatBufferBuilder *builder) const;
+    QByteArray schemaMessage() const;
+    QByteArray recordBatchMessage(int length, const QByteArray &nodes, const QByteArray &buffers,
+                                  qint64 bodyLength) const;
+    QByteArray footer(const QByteArray &blocks) const;
+
+    void encodeColumn(const QDbfArrowColumn &column, const QByteArray &records, int count,
+                      int recordLength, const QDbfCodec *codec, QDbfMemoFile *memo,
+                      QByteArray *body, QByteArray *nodes, QByteArray *buffers) const;
+
+    bool write(QIODevice *device, const QByteArray &data);
+    bool writeMessage(QIODevice *device, const QByteArray &metadata, const QByteArray &body,
+                      QByteArray *blocks);
+
+    static void appendBuffer(const QByteArray &buffer, QByteArray *body, QByteArray *buffers);
+
+    QDbfTable::DbfTableError m_error;
+    QDbfArrowWriter::Format m_format;
+    QStringList m_fieldNames;
+    int m_batchSize;
+    bool m_decimalEnabled;
+    bool m_skipDeleted;
+    int m_recordsCount;
+    qint64 m_position;
+    QVector<QDbfArrowColumn> m_columns;
+};
+
+QDbfArrowWriterPrivate::QDbfArrowWriterPrivate() :
+    m_error(QDbfTable::NoError),
+    m_format(QDbfArrowWriter::File),
+    m_batchSize(DEFAULT_ARROW_BATCH_SIZE),
+    m_decimalEnabled(true),
+    m_skipDeleted(true),
+    m_recordsCount(0),
+    m_position(0)
+{
+}
+
+bool QDbfArrowWriterPrivate::setColumns(const QDbfTablePrivate *table)
+{
+    // fields are read from the record bytes, so a projection does not hide any
+    QStringList names = m_fieldNames;
+    if (names.isEmpty()) {
+        for (int i = 0; i < table->m_record.count(); ++i) {
+            names.append(table->m_record.fieldName(i));
+        }
+    }
+
+    m_columns.clear();
+    m_columns.reserve(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        const int index = table->m_tableRecord.indexOf(names.at(i));
+        if (index < 0) {
+            qWarning("QDbfArrowWriter::writeTable(): unknown field %s", qPrintable(names.at(i)));
+            return false;
+        }
+
+        const QDbfField field = table->m_tableRecord.field(index);
+        QDbfArrowColumn column;
+        column.dbfType = field.dbfType();
+        column.offset = field.offset();
+        column.length = field.length();
+        column.scale = qMax(0, field.precision());
+        column.precision = 0;
+        column.name = field.name().toUtf8();
+
+        switch (column.dbfType) {
+        case QDbfField::Number: {
+            // the digits of the field, without the decimal point
+            const int digits = column.length - (column.scale > 0 ? 1 : 0);
+            if (m_decimalEnabled && column.scale <= MAX_DECIMAL_SCALE &&
+                digits <= MAX_DECIMAL_PRECISION) {
+                column.type = TYPE_DECIMAL;
+                column.precision = qMax(1, qMax(column.scale, digits));
+            } else {
+                column.type = TYPE_FLOATING_POINT;
+            }
+            break;
+        }
+        case QDbfField::FloatingPoint:
+            column.type = TYPE_FLOATING_POINT;
+            break;
+        case QDbfField::Date:
+            column.type = column.length >= DATE_LENGTH ? TYPE_DATE : TYPE_UTF8;
+            break;
+        case QDbfField::Logical:
+            column.type = TYPE_BOOL;
+            break;
+        default:
+            column.type = TYPE_UTF8;
+            break;
+        }
+
+        m_columns.append(column);
+    }
+
+    return true;
+}
+
+int QDbfArrowWriterPrivate::createSchema(QDbfFlatBufferBuilder *builder) const
+{
+    QVector<int> fields;
+    fields.reserve(m_columns.size());
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const QDbfArrowColumn &column = m_columns.at(i);
+
+        const int name = builder->createString(column.name);
+        const int children = builder->createOffsetVector(QVector<int>());
+
+        builder->startTable();
+        switch (column.type) {
+        case TYPE_FLOATING_POINT:
+            builder->addScalar(0, PRECISION_DOUBLE, 2);
+            break;
+        case TYPE_DECIMAL:
+            builder->addScalar(0, column.precision, 4);
+            builder->addScalar(1, column.scale, 4);
+            builder->addScalar(2, DECIMAL_BIT_WIDTH, 4);
+            break;
+        case TYPE_DATE:
+            builder->addScalar(0, DATE_UNIT_DAY, 2);
+            break;
+        default:
+            break;
+        }
+        const int type = builder->endTable();
+
+        builder->startTable();
+        builder->addOffset(0, name);
+        builder->addOffset(3, type);
+        builder->addOffset(5, children);
+        builder->addScalar(1, 1, 1);
+        builder->addScalar(2, column.type, 1);
+        fields.append(builder->endTable());
+    }
+
+    const int fieldsVector = builder->createOffsetVector(fields);
+
+    builder->startTable();
+    builder->addOffset(1, fieldsVector);
+    builder->addScalar(0, ENDIANNESS_LITTLE, 2);
+
+    return builder->endTable();
+}
+
+QByteArray QDbfArrowWriterPrivate::schemaMessage() const
+{
+    QDbfFlatBufferBuilder builder;
+    const int schema = createSchema(&builder);
+
+    builder.startTable();
+    builder.addScalar(3, 0, 8);
+    builder.addOffset(2, schema);
+    builder.addScalar(0, METADATA_V5, 2);
+    builder.addScalar(1, HEADER_SCHEMA, 1);
+
+    return builder.finish(builder.endTable());
+}
+
+QByteArray QDbfArrowWriterPrivate::recordBatchMessage(int length, const QByteArray &nodes,
+                                                      const QByteArray &buffers,
+                                                      qint64 bodyLength) const
+{
+    QDbfFlatBufferBuilder builder;
+    const int nodesVector = builder.createStructVector(nodes, nodes.size() / 16, 8);
+    const int buffersVector = builder.createStructVector(buffers, buffers.size() / 16, 8);
+
+    builder.startTable();
+    builder.addScalar(0, length, 8);
+    builder.addOffset(1, nodesVector);
+    builder.addOffset(2, buffersVector);
+    const int recordBatch = builder.endTable();
+
+    builder.startTable();
+    builder.addScalar(3, bodyLength, 8);
+    builder.addOffset(2, recordBatch);
+    builder.addScalar(0, METADATA_V5, 2);
+    builder.addScalar(1, HEADER_RECORD_BATCH, 1);
+
+    return builder.finish(builder.endTable());
+}
+
+QByteArray QDbfArrowWriterPrivate::footer(const QByteArray &blocks) const
+{
+    QDbfFlatBufferBuilder builder;
+    const int schema = createSchema(&builder);
+    const int dictionaries = builder.createStructVector(QByteArray(), 0, 8);
+    const int recordBatches = builder.createStructVector(blocks, blocks.size() / ARROW_BLOCK_LENGTH,
+                                                         8);
+
+    builder.startTable();
+    builder.addOffset(1, schema);
+    builder.addOffset(2, dictionaries);
+    builder.addOffset(3, recordBatches);
+    builder.addScalar(0, METADATA_V5, 2);
+
+    return builder.finish(builder.endTable());
+}
+
+void QDbfArrowWriterPrivate::appendBuffer(const QByteArray &buffer, QByteArray *body,
+                                          QByteArray *buffers)
+{
+    appendLittleEndian(buffers, body->size(), 8);
+    appendLittleEndian(buffers, buffer.size(), 8);
+    body->append(buffer);
+    padTo(body, ARROW_ALIGNMENT);
+}
+
+void QDbfArrowWriterPrivate::encodeColumn(const QDbfArrowColumn &column, const QByteArray &records,
+                                          int count, int recordLength, const QDbfCodec *codec,
+                                          QDbfMemoFile *memo, QByteArray *body, QByteArray *nodes,
+                                          QByteArray *buffers) const
+{
+    QByteArray validity((count + 7) / 8, '\0');
+    QByteArray values;
+    QByteArray data;
+    int validCount = 0;
+
+    switch (column.type) {
+    case TYPE_DECIMAL:
+        values.fill('\0', count * 16);
+        break;
+    case TYPE_FLOATING_POINT:
+        values.fill('\0', count * 8);
+        break;
+    case TYPE_DATE:
+        values.fill('\0', count * 4);
+        break;
+    case TYPE_BOOL:
+        values.fill('\0', (count + 7) / 8);
+        break;
+    default:
+        values.fill('\0', (count + 1) * 4);
+        data.reserve(count * column.length);
+        break;
+    }
+
+    char *out = values.data();
+    for (int i = 0; i < count; ++i) {
+        const char *value = records.constData() + i * recordLength + column.offset;
+        bool valid = false;
+
+        switch (column.type) {
+        case TYPE_DECIMAL: {
+            qint64 scaled = 0;
+            valid = parseScaledNumber(value, column.length, column.scale, &scaled) == NumberValid;
+            if (valid) {
+                writeLittleEndian(out + i * 16, static_cast<quint64>(scaled), 8);
+                writeLittleEndian(out + i * 16 + 8, scaled < 0 ? ~Q_UINT64_C(0) : 0, 8);
+            }
+            break; }
+        case TYPE_FLOATING_POINT: {
+            double number = 0.0;
+            valid = parseNumber(value, column.length, &number) == NumberValid;
+            if (valid) {
+                quint64 bits = 0;
+                memcpy(&bits, &number, sizeof(bits));
+                writeLittleEndian(out + i * 8, bits, 8);
+            }
+            break; }
+        case TYPE_DATE: {
+            const int year = parseDigits(value, 4);
+            const int month = parseDigits(value + 4, 2);
+            const int day = parseDigits(value + 6, 2);
+            const QDate date = year > 0 && month > 0 && day > 0 ? QDate(year, month, day) : QDate();
+            valid = date.isValid();
+            if (valid) {
+                const qint64 days = date.toJulianDay() - UNIX_EPOCH_JULIAN_DAY;
+                writeLittleEndian(out + i * 4, static_cast<quint64>(days), 4);
+            }
+            break; }
+        case TYPE_BOOL:
+            // '?' and blanks are unknown values
+            switch (column.length > 0 ? value[0] : ' ') {
+            case 'T': case 't': case 'Y': case 'y':
+                setBit(&values, i);
+                valid = true;
+                break;
+            case 'F': case 'f': case 'N': case 'n':
+                valid = true;
+                break;
+            default:
+                break;
+            }
+            break;
+        default:
+            // character fields always have a value, memo fields only when
+            // they point to a block
+            if (column.dbfType == QDbfField::Memo) {
+                const quint32 block = QDbfMemoFile::blockNumber(value, column.length);
+                valid = memo && block > 0;
+                if (valid) {
+                    const QByteArray text = memo->read(block);
+                    codec->appendUtf8(text.constData(), text.size(), &data);
+                }
+            } else {
+                int length = column.length;
+                while (length > 0 && value[length - 1] == ' ') {
+                    --length;
+                }
+                codec->appendUtf8(value, length, &data);
+                valid = true;
+            }
+            writeLittleEndian(out + (i + 1) * 4, data.size(), 4);
+            break;
+        }
+
+        if (valid) {
+            setBit(&validity, i);
+            ++validCount;
+        }
+    }
+
+    const int nullCount = count - validCount;
+    appendLittleEndian(nodes, count, 8);
+    appendLittleEndian(nodes, nullCount, 8);
+
+    // the validity bitmap may be left out when every value is set
+    appendBuffer(nullCount > 0 ? validity : QByteArray(), body, buffers);
+    appendBuffer(values, body, buffers);
+    if (column.type == TYPE_UTF8) {
+        appendBuffer(data, body, buffers);
+    }
+}
+
+bool QDbfArrowWriterPrivate::write(QIODevice *device, const QByteArray &data)
+{
+    if (device->write(data) != data.size()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    m_position += data.size();
+
+    return true;
+}
+
+bool QDbfArrowWriterPrivate::writeMessage(QIODevice *device, const QByteArray &metadata,
+                                          const QByteArray &body, QByteArray *blocks)
+{
+    // continuation marker and metadata length, then the metadata padded to
+    // keep the body aligned
+    QByteArray message;
+    message.reserve(8 + metadata.size() + ARROW_ALIGNMENT);
+    appendLittleEndian(&message, ARROW_CONTINUATION, 4);
+    appendLittleEndian(&message, 0, 4);
+    message.append(metadata);
+    padTo(&message, ARROW_ALIGNMENT);
+    writeLittleEndian(message.data() + 4, message.size() - 8, 4);
+
+    if (blocks) {
+        appendLittleEndian(blocks, m_position, 8);
+        appendLittleEndian(blocks, message.size(), 4);
+        appendLittleEndian(blocks, 0, 4);
+        appendLittleEndian(blocks, body.size(), 8);
+    }
+
+    return write(device, message) && write(device, body);
+}
+
+} // namespace Internal
+
+QDbfArrowWriter::QDbfArrowWriter() :
+    d(new Internal::QDbfArrowWriterPrivate())
+{
+}
+
+QDbfArrowWriter::~QDbfArrowWriter()
+{
+    delete d;
+}
+
+void QDbfArrowWriter::setFormat(Format format)
+{
+    d->m_format = format;
+}
+
+QDbfArrowWriter::Format QDbfArrowWriter::format() const
+{
+    return d->m_format;
+}
+
+void QDbfArrowWriter::setFieldNames(const QStringList &fieldNames)
+{
+    d->m_fieldNames = fieldNames;
+}
+
+QStringList QDbfArrowWriter::fieldNames() const
+{
+    return d->m_fieldNames;
+}
+
+void QDbfArrowWriter::setBatchSize(int size)
+{
+    d->m_batchSize = qMax(1, size);
+}
+
+int QDbfArrowWriter::batchSize() const
+{
+    return d->m_batchSize;
+}
+
+void QDbfArrowWriter::setDecimalEnabled(bool enabled)
+{
+    d->m_decimalEnabled = enabled;
+}
+
+bool QDbfArrowWriter::isDecimalEnabled() const
+{
+    return d->m_decimalEnabled;
+}
+
+void QDbfArrowWriter::setSkipDeleted(bool skip)
+{
+    d->m_skipDeleted = skip;
+}
+
+bool QDbfArrowWriter::skipDeleted() const
+{
+    return d->m_skipDeleted;
+}
+
+bool QDbfArrowWriter::writeTable(const QDbfTable &table, QIODevice *device,
+                                 QDbfProgressHandler *handler)
+{
+    d->m_recordsCount = 0;
+    d->m_position = 0;
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfArrowWriter::writeTable(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!device || !device->isWritable()) {
+        qWarning("QDbfArrowWriter::writeTable(): output device is not writable");
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (!d->setColumns(table.d)) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    // the reader opens the file on its own and must see every written record
+    if (table.d->m_file.isWritable()) {
+        table.d->m_file.flush();
+    }
+
+    Internal::QDbfReader reader;
+    if (!reader.open(table.d)) {
+        d->m_error = reader.error();
+        return false;
+    }
+
+    const bool file = d->m_format == QDbfArrowWriter::File;
+    if (file) {
+        QByteArray magic(Internal::ARROW_MAGIC, Internal::ARROW_MAGIC_LENGTH);
+        Internal::padTo(&magic, Internal::ARROW_ALIGNMENT);
+        if (!d->write(device, magic)) {
+            return false;
+        }
+    }
+
+    if (!d->writeMessage(device, d->schemaMessage(), QByteArray(), 0)) {
+        return false;
+    }
+
+    const int recordsCount = reader.size();
+    const int recordLength = table.d->m_recordLength;
+    QByteArray blocks;
+    QByteArray records;
+    records.reserve(qMin(d->m_batchSize, recordsCount) * recordLength);
+
+    int index = 0;
+    while (index < recordsCount) {
+        // the live records of the batch are copied together, then decoded
+        // column by column
+        records.clear();
+        int count = 0;
+        for (; index < recordsCount && count < d->m_batchSize; ++index) {
+            const char *data = reader.recordPointer(index);
+            if (!data) {
+                d->m_error = reader.error();
+                return false;
+            }
+            if (d->m_skipDeleted && data[0] == Internal::DELETED_MARK) {
+                continue;
+            }
+            records.append(data, recordLength);
+            ++count;
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        QByteArray body;
+        QByteArray nodes;
+        QByteArray buffers;
+        for (int i = 0; i < d->m_columns.size(); ++i) {
+            d->encodeColumn(d->m_columns.at(i), records, count, recordLength, reader.codec(),
+                            reader.memoFile(), &body, &nodes, &buffers);
+        }
+
+        const QByteArray metadata = d->recordBatchMessage(count, nodes, buffers, body.size());
+        if (!d->writeMessage(device, metadata, body, file ? &blocks : 0)) {
+            return false;
+        }
+
+        d->m_recordsCount += count;
+
+        if (handler) {
+            handler->progress(index, recordsCount);
+        }
+    }
+
+    // end of stream marker
+    QByteArray end;
+    Internal::appendLittleEndian(&end, Internal::ARROW_CONTINUATION, 4);
+    Internal::appendLittleEndian(&end, 0, 4);
+    if (!d->write(device, end)) {
+        return false;
+    }
+
+    if (file) {
+        QByteArray footer = d->footer(blocks);
+        Internal::appendLittleEndian(&footer, footer.size(), 4);
+        footer.append(Internal::ARROW_MAGIC, Internal::ARROW_MAGIC_LENGTH);
+        if (!d->write(device, footer)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool QDbfArrowWriter::writeTable(const QDbfTable &table, const QString &fileName,
+                                 QDbfProgressHandler *handler)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("QDbfArrowWriter::writeTable(): unable to open file %s", qPrintable(fileName));
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!writeTable(table, &file, handler)) {
+        return false;
+    }
+
+    if (!file.flush()) {
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    return true;
+}
+
+QDbfTable::DbfTableError QDbfArrowWriter::error() const
+{
+    return d->m_error;
+}
+
+int QDbfArrowWriter::recordsCount() const
+{
+    return d->m_recordsCount;
+}
+
+} // namespace QDbf
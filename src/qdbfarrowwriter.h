@@ -0,0 +1,68 @@
+#ifndef QDBFARROWWRITER_H
+#define QDBFARROWWRITER_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QString;
+class QStringList;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfArrowWriterPrivate;
+} // namespace Internal
+
+// Writes a table in the Apache Arrow IPC file or stream format without any
+// Arrow library. Records are gathered batchSize at a time and every column
+// of the batch is decoded from the record bytes into Arrow buffers:
+// C and memo fields become utf8, N fields decimal128 (float64 when decimals
+// are disabled or the field has more than 18 digits), F fields float64,
+// D fields date32 and L fields bool. Blank and unreadable values are nulls.
+class QDBF_EXPORT QDbfArrowWriter
+{
+public:
+    enum Format {
+        File = 0,
+        Stream
+    };
+
+    QDbfArrowWriter();
+    ~QDbfArrowWriter();
+
+    void setFormat(Format format);
+    Format format() const;
+
+    // fields of the table record in the given order; when empty the fields
+    // of the table projection are written
+    void setFieldNames(const QStringList &fieldNames);
+    QStringList fieldNames() const;
+
+    void setBatchSize(int size);
+    int batchSize() const;
+
+    void setDecimalEnabled(bool enabled);
+    bool isDecimalEnabled() const;
+
+    void setSkipDeleted(bool skip);
+    bool skipDeleted() const;
+
+    bool writeTable(const QDbfTable &table, QIODevice *device,
+                    QDbfProgressHandler *handler = 0);
+    bool writeTable(const QDbfTable &table, const QString &fileName,
+                    QDbfProgressHandler *handler = 0);
+
+    QDbfTable::DbfTableError error() const;
+    int recordsCount() const;
+
+private:
+    Q_DISABLE_COPY(QDbfArrowWriter)
+
+    Internal::QDbfArrowWriterPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFARROWWRITER_H
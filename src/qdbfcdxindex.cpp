@@ -0,0 +1,386 @@
+#include "qdbfcdxindex_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QList>
+#include <QPair>
+#include <QtEndian>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int CDX_NODE_SIZE = 512;
+const int CDX_HEADER_SIZE = 1024;
+const int CDX_ROOT_OFFSET = 0;
+const int CDX_KEY_LENGTH_OFFSET = 12;
+const int CDX_OPTIONS_OFFSET = 14;
+const int CDX_DESCENDING_OFFSET = 502;
+const int CDX_EXPRESSION_OFFSET = 512;
+const int CDX_MAX_KEY_LENGTH = 240;
+const char CDX_UNIQUE = 0x01;
+const quint16 CDX_ROOT_NODE = 0x01;
+const quint16 CDX_LEAF_NODE = 0x02;
+const int CDX_LEFT_SIBLING_OFFSET = 4;
+const int CDX_RIGHT_SIBLING_OFFSET = 8;
+const int CDX_LEAF_FREE_SPACE_OFFSET = 12;
+const int CDX_INTERIOR_ENTRIES_OFFSET = 12;
+const int CDX_LEAF_RECORD_MASK_OFFSET = 14;
+const int CDX_LEAF_BITS_OFFSET = 20;
+const int CDX_LEAF_INFO_LENGTH_OFFSET = 23;
+const int CDX_LEAF_ENTRIES_OFFSET = 24;
+
+QDbfCdxIndex::QDbfCdxIndex(const QDbfCodec *codec) :
+    QDbfIndexFile(codec),
+    m_root(0),
+    m_headerOffset(0),
+    m_nextNode(0)
+{
+}
+
+bool QDbfCdxIndex::load(const QString &tagName)
+{
+    if (!readHeader(0)) {
+        return false;
+    }
+
+    // the directory index maps tag names to the offsets of their headers
+    QList<QPair<QString, quint32> > tags;
+    for (bool found = first(); found; found = next()) {
+        const QString name = headerString(key(), m_keyLength);
+        tags.append(qMakePair(name, static_cast<quint32>(recordIndex() + 1)));
+    }
+
+    for (int i = 0; i < tags.size(); ++i) {
+        if (tagName.isEmpty() || tags.at(i).first.compare(tagName, Qt::CaseInsensitive) == 0) {
+            m_tagName = tags.at(i).first;
+            // new nodes are appended at the end of the file
+            m_nextNode = static_cast<quint32>((m_file.size() + CDX_NODE_SIZE - 1) / CDX_NODE_SIZE) *
+                    CDX_NODE_SIZE;
+            return readHeader(tags.at(i).second);
+        }
+    }
+
+    qWarning("QDbfCdxIndex::load(): no tag %s in %s", qPrintable(tagName), qPrintable(fileName()));
+    return false;
+}
+
+bool QDbfCdxIndex::readHeader(quint32 offset)
+{
+    char header[CDX_HEADER_SIZE];
+    if (!readBlock(offset, header, CDX_HEADER_SIZE)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(header);
+    m_headerOffset = offset;
+    m_root = qFromLittleEndian<quint32>(data + CDX_ROOT_OFFSET);
+    m_keyLength = qFromLittleEndian<quint16>(data + CDX_KEY_LENGTH_OFFSET);
+    m_unique = (header[CDX_OPTIONS_OFFSET] & CDX_UNIQUE) != 0;
+    m_descending = qFromLittleEndian<quint16>(data + CDX_DESCENDING_OFFSET) != 0;
+    m_expression = headerString(header + CDX_EXPRESSION_OFFSET, CDX_HEADER_SIZE - CDX_EXPRESSION_OFFSET);
+
+    if (m_keyLength <= 0 || m_keyLength > CDX_MAX_KEY_LENGTH) {
+        qWarning("QDbfCdxIndex::readHeader(): invalid header in %s", qPrintable(fileName()));
+        return false;
+    }
+
+    return true;
+}
+
+quint32 QDbfCdxIndex::rootNode() const
+{
+    return m_root;
+}
+
+bool QDbfCdxIndex::readNode(quint32 address, QDbfIndexNode *node)
+{
+    char block[CDX_NODE_SIZE];
+    if (!readBlock(address, block, CDX_NODE_SIZE)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(block);
+    node->address = address;
+    node->leaf = (qFromLittleEndian<quint16>(data) & CDX_LEAF_NODE) != 0;
+    node->count = qFromLittleEndian<quint16>(data + 2);
+    node->leftSibling = qFromLittleEndian<quint32>(data + CDX_LEFT_SIBLING_OFFSET);
+    node->rightSibling = qFromLittleEndian<quint32>(data + CDX_RIGHT_SIBLING_OFFSET);
+
+    if (node->leaf) {
+        return readLeaf(data, node);
+    }
+
+    const int entryLength = m_keyLength + 8;
+    if (CDX_INTERIOR_ENTRIES_OFFSET + node->count * entryLength > CDX_NODE_SIZE) {
+        return false;
+    }
+
+    node->keys.resize(node->count * m_keyLength);
+    node->pointers.resize(node->count);
+    node->keyRecords.resize(node->count);
+
+    for (int i = 0; i < node->count; ++i) {
+        const uchar *entry = data + CDX_INTERIOR_ENTRIES_OFFSET + i * entryLength;
+        memcpy(node->keys.data() + i * m_keyLength, entry, m_keyLength);
+        node->keyRecords[i] = qFromBigEndian<quint32>(entry + m_keyLength);
+        node->pointers[i] = qFromBigEndian<quint32>(entry + m_keyLength + 4);
+    }
+
+    return true;
+}
+
+bool QDbfCdxIndex::readLeaf(const uchar *data, QDbfIndexNode *node) const
+{
+    const quint32 recordMask = qFromLittleEndian<quint32>(data + CDX_LEAF_RECORD_MASK_OFFSET);
+    const quint32 duplicateMask = data[CDX_LEAF_RECORD_MASK_OFFSET + 4];
+    const quint32 trailingMask = data[CDX_LEAF_RECORD_MASK_OFFSET + 5];
+    const int recordBits = data[CDX_LEAF_BITS_OFFSET];
+    const int duplicateBits = data[CDX_LEAF_BITS_OFFSET + 1];
+    const int infoLength = data[CDX_LEAF_INFO_LENGTH_OFFSET];
+
+    if (infoLength <= 0 || infoLength > 8 ||
+        CDX_LEAF_ENTRIES_OFFSET + node->count * infoLength > CDX_NODE_SIZE) {
+        return false;
+    }
+
+    node->keys.resize(node->count * m_keyLength);
+    node->pointers.resize(node->count);
+
+    // key bytes are packed from the end of the node towards the entries,
+    // every key shares `duplicate' leading bytes with its predecessor and
+    // drops `trailing' padding bytes
+    const char padding = m_keyKind == NumericKeys || m_keyKind == DateKeys ? '\0' : ' ';
+    const int keysStart = CDX_LEAF_ENTRIES_OFFSET + node->count * infoLength;
+    int keyPosition = CDX_NODE_SIZE;
+    char *previousKey = 0;
+
+    for (int i = 0; i < node->count; ++i) {
+        const uchar *entry = data + CDX_LEAF_ENTRIES_OFFSET + i * infoLength;
+        quint64 info = 0;
+        for (int byte = infoLength - 1; byte >= 0; --byte) {
+            info = (info << 8) | entry[byte];
+        }
+
+        const int duplicate = static_cast<int>((info >> recordBits) & duplicateMask);
+        const int trailing = static_cast<int>((info >> (recordBits + duplicateBits)) & trailingMask);
+        const int length = m_keyLength - duplicate - trailing;
+        if (length < 0 || (duplicate > 0 && !previousKey)) {
+            return false;
+        }
+
+        keyPosition -= length;
+        if (keyPosition < keysStart) {
+            return false;
+        }
+
+        char *key = node->keys.data() + i * m_keyLength;
+        if (duplicate > 0) {
+            memcpy(key, previousKey, duplicate);
+        }
+        memcpy(key + duplicate, data + keyPosition, length);
+        memset(key + duplicate + length, padding, trailing);
+
+        node->pointers[i] = static_cast<quint32>(info & recordMask);
+        previousKey = key;
+    }
+
+    return true;
+}
+
+QByteArray QDbfCdxIndex::encodeNumber(double value) const
+{
+    if (m_keyKind != NumericKeys) {
+        return QByteArray();
+    }
+
+    return binaryKey(value);
+}
+
+QByteArray QDbfCdxIndex::encodeDate(const QDate &date) const
+{
+    if (m_keyKind != DateKeys) {
+        return QByteArray();
+    }
+
+    return binaryKey(static_cast<double>(date.toJulianDay()));
+}
+
+QByteArray QDbfCdxIndex::binaryKey(double value)
+{
+    if (value == 0.0) {
+        value = 0.0;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & Q_UINT64_C(0x8000000000000000)) ? ~bits : bits ^ Q_UINT64_C(0x8000000000000000);
+
+    QByteArray key(sizeof(bits), '\0');
+    qToBigEndian<quint64>(bits, reinterpret_cast<uchar *>(key.data()));
+    return key;
+}
+
+int QDbfCdxIndex::nodeSize() const
+{
+    return CDX_NODE_SIZE;
+}
+
+int QDbfCdxIndex::nodeLoad(const QDbfIndexNode &node) const
+{
+    if (node.leaf) {
+        return leafLayout(node).size;
+    }
+
+    return CDX_INTERIOR_ENTRIES_OFFSET + node.count * (m_keyLength + 8);
+}
+
+bool QDbfCdxIndex::hasRightmostPointer() const
+{
+    return false;
+}
+
+bool QDbfCdxIndex::hasSiblingLinks() const
+{
+    return true;
+}
+
+bool QDbfCdxIndex::writeNode(const QDbfIndexNode &node)
+{
+    char block[CDX_NODE_SIZE];
+    memset(block, 0, CDX_NODE_SIZE);
+
+    uchar *data = reinterpret_cast<uchar *>(block);
+    const quint16 attributes = (node.leaf ? CDX_LEAF_NODE : 0) |
+            (node.address == m_root ? CDX_ROOT_NODE : 0);
+    qToLittleEndian<quint16>(attributes, data);
+    qToLittleEndian<quint16>(node.count, data + 2);
+    qToLittleEndian<quint32>(node.leftSibling, data + CDX_LEFT_SIBLING_OFFSET);
+    qToLittleEndian<quint32>(node.rightSibling, data + CDX_RIGHT_SIBLING_OFFSET);
+
+    if (node.leaf) {
+        writeLeaf(node, data);
+    } else {
+        const int entryLength = m_keyLength + 8;
+        for (int i = 0; i < node.count; ++i) {
+            uchar *entry = data + CDX_INTERIOR_ENTRIES_OFFSET + i * entryLength;
+            memcpy(entry, node.key(i, m_keyLength), m_keyLength);
+            qToBigEndian<quint32>(node.keyRecords.at(i), entry + m_keyLength);
+            qToBigEndian<quint32>(node.pointers.at(i), entry + m_keyLength + 4);
+        }
+    }
+
+    return writeBlock(node.address, block, CDX_NODE_SIZE);
+}
+
+quint32 QDbfCdxIndex::allocateNode()
+{
+    const quint32 address = m_nextNode;
+    m_nextNode += CDX_NODE_SIZE;
+    return address;
+}
+
+void QDbfCdxIndex::setRootNode(quint32 address)
+{
+    m_root = address;
+}
+
+bool QDbfCdxIndex::writeHeader()
+{
+    uchar value[4];
+    qToLittleEndian<quint32>(m_root, value);
+
+    return writeBlock(m_headerOffset + CDX_ROOT_OFFSET, reinterpret_cast<const char *>(value),
+                      sizeof(value));
+}
+
+QDbfCdxIndex::LeafLayout QDbfCdxIndex::leafLayout(const QDbfIndexNode &node) const
+{
+    quint32 maxRecord = 0;
+    for (int i = 0; i < node.pointers.size(); ++i) {
+        maxRecord = qMax(maxRecord, node.pointers.at(i));
+    }
+
+    LeafLayout layout;
+    layout.keyBits = 0;
+    for (int length = m_keyLength; length > 0; length >>= 1) {
+        ++layout.keyBits;
+    }
+    int recordBits = 1;
+    while (recordBits < 32 && (maxRecord >> recordBits) != 0) {
+        ++recordBits;
+    }
+
+    // the record number takes the bits the counts leave in whole bytes
+    layout.infoLength = (recordBits + 2 * layout.keyBits + 7) / 8;
+    layout.recordBits = qMin(layout.infoLength * 8 - 2 * layout.keyBits, 32);
+
+    layout.size = CDX_LEAF_ENTRIES_OFFSET + node.count * layout.infoLength;
+    for (int i = 0; i < node.count; ++i) {
+        int duplicate;
+        int trailing;
+        compressKey(node, i, &duplicate, &trailing);
+        layout.size += m_keyLength - duplicate - trailing;
+    }
+
+    return layout;
+}
+
+void QDbfCdxIndex::compressKey(const QDbfIndexNode &node, int i, int *duplicate, int *trailing) const
+{
+    const char padding = m_keyKind == NumericKeys || m_keyKind == DateKeys ? '\0' : ' ';
+    const char *key = node.key(i, m_keyLength);
+
+    *trailing = 0;
+    while (*trailing < m_keyLength && key[m_keyLength - 1 - *trailing] == padding) {
+        ++*trailing;
+    }
+
+    *duplicate = 0;
+    if (i > 0) {
+        const char *previousKey = node.key(i - 1, m_keyLength);
+        const int maxDuplicate = m_keyLength - *trailing;
+        while (*duplicate < maxDuplicate && key[*duplicate] == previousKey[*duplicate]) {
+            ++*duplicate;
+        }
+    }
+}
+
+void QDbfCdxIndex::writeLeaf(const QDbfIndexNode &node, uchar *data) const
+{
+    const LeafLayout layout = leafLayout(node);
+    const quint32 keyMask = (1u << layout.keyBits) - 1;
+
+    qToLittleEndian<quint16>(CDX_NODE_SIZE - layout.size, data + CDX_LEAF_FREE_SPACE_OFFSET);
+    qToLittleEndian<quint32>(layout.recordBits == 32 ? 0xFFFFFFFF : (1u << layout.recordBits) - 1,
+                             data + CDX_LEAF_RECORD_MASK_OFFSET);
+    data[CDX_LEAF_RECORD_MASK_OFFSET + 4] = keyMask;
+    data[CDX_LEAF_RECORD_MASK_OFFSET + 5] = keyMask;
+    data[CDX_LEAF_BITS_OFFSET] = layout.recordBits;
+    data[CDX_LEAF_BITS_OFFSET + 1] = layout.keyBits;
+    data[CDX_LEAF_BITS_OFFSET + 2] = layout.keyBits;
+    data[CDX_LEAF_INFO_LENGTH_OFFSET] = layout.infoLength;
+
+    int keyPosition = CDX_NODE_SIZE;
+    for (int i = 0; i < node.count; ++i) {
+        int duplicate;
+        int trailing;
+        compressKey(node, i, &duplicate, &trailing);
+
+        const quint64 info = node.pointers.at(i) |
+                (static_cast<quint64>(duplicate) << layout.recordBits) |
+                (static_cast<quint64>(trailing) << (layout.recordBits + layout.keyBits));
+        uchar *entry = data + CDX_LEAF_ENTRIES_OFFSET + i * layout.infoLength;
+        for (int byte = 0; byte < layout.infoLength; ++byte) {
+            entry[byte] = static_cast<uchar>(info >> (8 * byte));
+        }
+
+        const int length = m_keyLength - duplicate - trailing;
+        keyPosition -= length;
+        memcpy(data + keyPosition, node.key(i, m_keyLength) + duplicate, length);
+    }
+}
+
+} // namespace Internal
+} // namespace QDbf
@@ -0,0 +1,59 @@
+#ifndef QDBFCDXINDEX_P_H
+#define QDBFCDXINDEX_P_H
+
+#include "qdbfindex_p.h"
+
+namespace QDbf {
+namespace Internal {
+
+// FoxPro compound index: the file starts with a directory index whose keys
+// are the tag names and whose record numbers locate the tag headers. Leaf
+// nodes are prefix compressed, numeric and date keys are big-endian doubles
+// with the sign bit flipped so that all keys compare bytewise.
+class QDbfCdxIndex : public QDbfIndexFile
+{
+public:
+    explicit QDbfCdxIndex(const QDbfCodec *codec);
+
+protected:
+    bool load(const QString &tagName);
+    quint32 rootNode() const;
+    bool readNode(quint32 address, QDbfIndexNode *node);
+    QByteArray encodeNumber(double value) const;
+    QByteArray encodeDate(const QDate &date) const;
+
+    int nodeSize() const;
+    int nodeLoad(const QDbfIndexNode &node) const;
+    bool hasRightmostPointer() const;
+    bool hasSiblingLinks() const;
+    bool writeNode(const QDbfIndexNode &node);
+    quint32 allocateNode();
+    void setRootNode(quint32 address);
+    bool writeHeader();
+
+private:
+    struct LeafLayout
+    {
+        int recordBits;
+        int keyBits;
+        int infoLength;
+        int size;
+    };
+
+    static QByteArray binaryKey(double value);
+
+    bool readHeader(quint32 offset);
+    bool readLeaf(const uchar *data, QDbfIndexNode *node) const;
+    LeafLayout leafLayout(const QDbfIndexNode &node) const;
+    void compressKey(const QDbfIndexNode &node, int i, int *duplicate, int *trailing) const;
+    void writeLeaf(const QDbfIndexNode &node, uchar *data) const;
+
+    quint32 m_root;
+    quint32 m_headerOffset;
+    quint32 m_nextNode;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFCDXINDEX_P_H
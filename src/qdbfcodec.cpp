@@ -0,0 +1,263 @@
+#include "qdbfcodec_p.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextCodec>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+namespace QDbf {
+namespace Internal {
+
+// IBM437 is not shipped with every Qt build, its upper half is kept here
+static const ushort IBM437_UPPER_HALF[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+static QTextCodec *textCodecForCodepage(QDbfTable::Codepage codepage)
+{
+    switch (codepage) {
+    case QDbfTable::IBM437:
+        return QTextCodec::codecForName("IBM437");
+    case QDbfTable::IBM850:
+        return QTextCodec::codecForName("IBM 850");
+    case QDbfTable::IBM866:
+        return QTextCodec::codecForName("IBM 866");
+    case QDbfTable::Windows1251:
+        return QTextCodec::codecForName("Windows-1251");
+    case QDbfTable::Windows1252:
+        return QTextCodec::codecForName("Windows-1252");
+    default:
+        return 0;
+    }
+}
+
+QDbfCodec::QDbfCodec(QTextCodec *textCodec) :
+    m_textCodec(textCodec),
+    m_singleByte(false)
+{
+    memset(m_toUnicode, 0, sizeof(m_toUnicode));
+}
+
+QDbfCodec::QDbfCodec(QTextCodec *textCodec, const ushort *upperHalf) :
+    m_textCodec(textCodec),
+    m_singleByte(true)
+{
+    for (int i = 0; i < 128; ++i) {
+        m_toUnicode[i] = static_cast<ushort>(i);
+    }
+
+    for (int i = 128; i < 256; ++i) {
+        if (upperHalf) {
+            m_toUnicode[i] = upperHalf[i - 128];
+            continue;
+        }
+
+        const char c = static_cast<char>(i);
+        const QString string = textCodec->toUnicode(&c, 1);
+        m_toUnicode[i] = string.size() == 1
+                ? string.at(0).unicode()
+                : static_cast<ushort>(QChar::ReplacementCharacter);
+    }
+
+    buildFromUnicode();
+}
+
+void QDbfCodec::buildFromUnicode()
+{
+    for (int i = 255; i >= 128; --i) {
+        if (m_toUnicode[i] != QChar::ReplacementCharacter) {
+            m_fromUnicode.insert(m_toUnicode[i], static_cast<char>(i));
+        }
+    }
+}
+
+const QDbfCodec *QDbfCodec::codecForCodepage(QDbfTable::Codepage codepage)
+{
+    static QMutex mutex;
+    static QHash<int, QDbfCodec *> singleByteCodecs;
+    static QHash<QTextCodec *, QDbfCodec *> textCodecs;
+
+    QMutexLocker locker(&mutex);
+
+    if (QDbfCodec *codec = singleByteCodecs.value(codepage)) {
+        return codec;
+    }
+
+    QTextCodec *textCodec = textCodecForCodepage(codepage);
+
+    if (textCodec || codepage == QDbfTable::IBM437) {
+        QDbfCodec *codec = new QDbfCodec(textCodec, textCodec ? 0 : IBM437_UPPER_HALF);
+        singleByteCodecs.insert(codepage, codec);
+        return codec;
+    }
+
+    textCodec = QTextCodec::codecForLocale();
+
+    QDbfCodec *codec = textCodecs.value(textCodec);
+    if (!codec) {
+        codec = new QDbfCodec(textCodec);
+        textCodecs.insert(textCodec, codec);
+    }
+
+    return codec;
+}
+
+QString QDbfCodec::toUnicode(const char *data, int length) const
+{
+    if (!m_singleByte) {
+        return m_textCodec->toUnicode(data, length);
+    }
+
+    QString string;
+    string.resize(length);
+    convert(data, length, reinterpret_cast<ushort *>(string.data()));
+
+    return string;
+}
+
+QByteArray QDbfCodec::fromUnicode(const QString &string) const
+{
+    if (!m_singleByte) {
+        return m_textCodec->fromUnicode(string);
+    }
+
+    const int length = string.length();
+    const QChar *source = string.constData();
+
+    QByteArray data;
+    data.resize(length);
+    char *out = data.data();
+
+    for (int i = 0; i < length; ++i) {
+        const ushort unicode = source[i].unicode();
+        out[i] = unicode < 128 ? static_cast<char>(unicode) : m_fromUnicode.value(unicode, '?');
+    }
+
+    return data;
+}
+
+int QDbfCodec::fromUnicode(const QChar *source, int count, char *out, int length) const
+{
+    if (!m_singleByte) {
+        // drop whole characters from the end until the encoding fits, never
+        // splitting a surrogate pair or a multibyte sequence
+        int chars = qMin(count, length);
+        QByteArray data;
+        for (;;) {
+            if (chars > 0 && chars < count && source[chars].isLowSurrogate()) {
+                --chars;
+            }
+            data = m_textCodec->fromUnicode(source, chars);
+            if (data.size() <= length || chars == 0) {
+                break;
+            }
+            --chars;
+        }
+        const int size = qMin(data.size(), length);
+        memcpy(out, data.constData(), size);
+        return size;
+    }
+
+    count = qMin(count, length);
+
+    for (int i = 0; i < count; ++i) {
+        const ushort unicode = source[i].unicode();
+        out[i] = unicode < 128 ? static_cast<char>(unicode) : m_fromUnicode.value(unicode, '?');
+    }
+
+    return count;
+}
+
+void QDbfCodec::convert(const char *data, int length, ushort *out) const
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    // pure ASCII blocks are widened sixteen bytes at a time
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (_mm_movemask_epi8(chunk) == 0) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), _mm_unpackhi_epi8(chunk, zero));
+            i += 16;
+            continue;
+        }
+        for (const int end = i + 16; i < end; ++i) {
+            out[i] = m_toUnicode[static_cast<uchar>(data[i])];
+        }
+    }
+#else
+    // pure ASCII blocks are detected eight bytes at a time
+    while (i + 8 <= length) {
+        quint64 chunk;
+        memcpy(&chunk, data + i, sizeof(chunk));
+        if ((chunk & Q_UINT64_C(0x8080808080808080)) == 0) {
+            for (const int end = i + 8; i < end; ++i) {
+                out[i] = static_cast<uchar>(data[i]);
+            }
+            continue;
+        }
+        for (const int end = i + 8; i < end; ++i) {
+            out[i] = m_toUnicode[static_cast<uchar>(data[i])];
+        }
+    }
+#endif
+
+    for (; i < length; ++i) {
+        out[i] = m_toUnicode[static_cast<uchar>(data[i])];
+    }
+}
+
+void QDbfCodec::appendUtf8(const char *data, int length, QByteArray *out) const
+{
+    if (!m_singleByte) {
+        out->append(m_textCodec->toUnicode(data, length).toUtf8());
+        return;
+    }
+
+    // a code unit of a single-byte codepage takes at most three UTF-8 bytes
+    const int size = out->size();
+    out->resize(size + length * 3);
+    char *pointer = out->data() + size;
+
+    for (int i = 0; i < length; ++i) {
+        const ushort c = m_toUnicode[static_cast<uchar>(data[i])];
+        if (c < 0x80) {
+            *pointer++ = static_cast<char>(c);
+        } else if (c < 0x800) {
+            *pointer++ = static_cast<char>(0xC0 | (c >> 6));
+            *pointer++ = static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            *pointer++ = static_cast<char>(0xE0 | (c >> 12));
+            *pointer++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *pointer++ = static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    out->resize(pointer - out->constData());
+}
+
+} // namespace Internal
+} // namespace QDbf
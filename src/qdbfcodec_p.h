@@ -0,0 +1,53 @@
+#ifndef QDBFCODEC_P_H
+#define QDBFCODEC_P_H
+
+#include "qdbftable.h"
+
+#include <QHash>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QByteArray;
+class QTextCodec;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+
+// Text conversion for one table codepage. Single-byte codepages are served
+// from a 256 entry lookup table, anything else goes through QTextCodec.
+class QDbfCodec
+{
+public:
+    static const QDbfCodec *codecForCodepage(QDbfTable::Codepage codepage);
+
+    inline bool isSingleByte() const { return m_singleByte; }
+    inline QTextCodec *textCodec() const { return m_textCodec; }
+
+    QString toUnicode(const char *data, int length) const;
+    QByteArray fromUnicode(const QString &string) const;
+
+    // writes at most length bytes and returns how many were written
+    int fromUnicode(const QChar *source, int count, char *out, int length) const;
+
+    // single-byte codepages only, writes exactly length UTF-16 code units
+    void convert(const char *data, int length, ushort *out) const;
+
+    void appendUtf8(const char *data, int length, QByteArray *out) const;
+
+private:
+    explicit QDbfCodec(QTextCodec *textCodec);
+    QDbfCodec(QTextCodec *textCodec, const ushort *upperHalf);
+
+    void buildFromUnicode();
+
+    QTextCodec *m_textCodec;
+    bool m_singleByte;
+    ushort m_toUnicode[256];
+    QHash<ushort, char> m_fromUnicode;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFCODEC_P_H
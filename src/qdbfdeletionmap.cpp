@@ -0,0 +1,187 @@
+#include "qdbfdeletionmap_p.h"
+
+namespace QDbf {
+namespace Internal {
+
+const int WORD_BITS = 64;
+const int SELECT_SAMPLE = 1024;
+
+static inline int populationCount(quint64 word)
+{
+    word = word - ((word >> 1) & Q_UINT64_C(0x5555555555555555));
+    word = (word & Q_UINT64_C(0x3333333333333333)) + ((word >> 2) & Q_UINT64_C(0x3333333333333333));
+    word = (word + (word >> 4)) & Q_UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return static_cast<int>((word * Q_UINT64_C(0x0101010101010101)) >> 56);
+}
+
+// position of the n-th set bit of the word, counted from zero
+static inline int selectBit(quint64 word, int n)
+{
+    int position = 0;
+    for (int width = 32; width > 0; width /= 2) {
+        const quint64 mask = (Q_UINT64_C(1) << width) - 1;
+        const int count = populationCount(word & mask);
+        if (n >= count) {
+            n -= count;
+            word >>= width;
+            position += width;
+        }
+    }
+
+    return position;
+}
+
+QDbfDeletionMap::QDbfDeletionMap() :
+    m_size(0),
+    m_deletedCount(0),
+    m_directoryValid(false)
+{
+}
+
+void QDbfDeletionMap::clear()
+{
+    m_liveWords.clear();
+    m_ranks.clear();
+    m_samples.clear();
+    m_size = 0;
+    m_deletedCount = 0;
+    m_directoryValid = false;
+}
+
+void QDbfDeletionMap::resize(int size)
+{
+    const int wordsCount = (size + WORD_BITS - 1) / WORD_BITS;
+    const int previousWordsCount = m_liveWords.size();
+
+    // records appended are live
+    m_liveWords.resize(wordsCount);
+    for (int i = previousWordsCount; i < wordsCount; ++i) {
+        m_liveWords[i] = ~Q_UINT64_C(0);
+    }
+    if (size > m_size && m_size % WORD_BITS != 0) {
+        m_liveWords[m_size / WORD_BITS] |= ~((Q_UINT64_C(1) << (m_size % WORD_BITS)) - 1);
+    }
+
+    // bits past the end stay clear, so counting never has to mask them
+    if (size % WORD_BITS != 0) {
+        m_liveWords[wordsCount - 1] &= (Q_UINT64_C(1) << (size % WORD_BITS)) - 1;
+    }
+
+    if (size < m_size) {
+        int liveCount = 0;
+        for (int i = 0; i < wordsCount; ++i) {
+            liveCount += populationCount(m_liveWords.at(i));
+        }
+        m_deletedCount = size - liveCount;
+    }
+
+    m_size = size;
+    m_directoryValid = false;
+}
+
+void QDbfDeletionMap::setDeleted(int index, bool deleted)
+{
+    if (index < 0 || index >= m_size || isDeleted(index) == deleted) {
+        return;
+    }
+
+    const quint64 bit = Q_UINT64_C(1) << (index % WORD_BITS);
+    if (deleted) {
+        m_liveWords[index / WORD_BITS] &= ~bit;
+        ++m_deletedCount;
+    } else {
+        m_liveWords[index / WORD_BITS] |= bit;
+        --m_deletedCount;
+    }
+
+    m_directoryValid = false;
+}
+
+bool QDbfDeletionMap::isDeleted(int index) const
+{
+    if (index < 0 || index >= m_size) {
+        return false;
+    }
+
+    return !(m_liveWords.at(index / WORD_BITS) & (Q_UINT64_C(1) << (index % WORD_BITS)));
+}
+
+int QDbfDeletionMap::size() const
+{
+    return m_size;
+}
+
+int QDbfDeletionMap::deletedCount() const
+{
+    return m_deletedCount;
+}
+
+int QDbfDeletionMap::liveCount() const
+{
+    return m_size - m_deletedCount;
+}
+
+int QDbfDeletionMap::row(int index) const
+{
+    if (index < 0 || index >= m_size || isDeleted(index)) {
+        return -1;
+    }
+
+    updateDirectory();
+
+    const int word = index / WORD_BITS;
+    const quint64 below = (Q_UINT64_C(1) << (index % WORD_BITS)) - 1;
+
+    return m_ranks.at(word) + populationCount(m_liveWords.at(word) & below);
+}
+
+int QDbfDeletionMap::recordIndex(int row) const
+{
+    if (row < 0 || row >= liveCount()) {
+        return -1;
+    }
+
+    updateDirectory();
+
+    // the samples narrow the search down to the words between two of them
+    const int sample = row / SELECT_SAMPLE;
+    int low = m_samples.at(sample);
+    int high = sample + 1 < m_samples.size() ? m_samples.at(sample + 1) : m_liveWords.size() - 1;
+    while (low < high) {
+        const int middle = low + (high - low + 1) / 2;
+        if (m_ranks.at(middle) <= row) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return low * WORD_BITS + selectBit(m_liveWords.at(low), row - m_ranks.at(low));
+}
+
+void QDbfDeletionMap::updateDirectory() const
+{
+    if (m_directoryValid) {
+        return;
+    }
+
+    const int wordsCount = m_liveWords.size();
+    m_ranks.resize(wordsCount);
+    m_samples.clear();
+
+    int rank = 0;
+    for (int i = 0; i < wordsCount; ++i) {
+        m_ranks[i] = rank;
+        const int count = populationCount(m_liveWords.at(i));
+        // word holding the live record of every sampled row
+        while (m_samples.size() * SELECT_SAMPLE < rank + count) {
+            m_samples.append(i);
+        }
+        rank += count;
+    }
+
+    m_directoryValid = true;
+}
+
+} // namespace Internal
+} // namespace QDbf
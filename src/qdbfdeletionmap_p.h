@@ -0,0 +1,44 @@
+#ifndef QDBFDELETIONMAP_P_H
+#define QDBFDELETIONMAP_P_H
+
+#include <QVector>
+
+namespace QDbf {
+namespace Internal {
+
+// One bit per record telling whether it is live (not flagged with '*'),
+// with a rank directory mapping between record indexes and the rows of
+// the live records. The directory is rebuilt on the first lookup after a
+// change; appends and deletions only touch the bits.
+class QDbfDeletionMap
+{
+public:
+    QDbfDeletionMap();
+
+    void clear();
+    void resize(int size);
+    void setDeleted(int index, bool deleted);
+    bool isDeleted(int index) const;
+
+    int size() const;
+    int deletedCount() const;
+    int liveCount() const;
+
+    int row(int index) const;
+    int recordIndex(int row) const;
+
+private:
+    void updateDirectory() const;
+
+    QVector<quint64> m_liveWords;
+    int m_size;
+    int m_deletedCount;
+    mutable QVector<int> m_ranks;
+    mutable QVector<int> m_samples;
+    mutable bool m_directoryValid;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFDELETIONMAP_P_H
@@ -0,0 +1,789 @@
+#include "qdbfexporter.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbffield.h"
+#include "qdbfmemofile_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfreader_p.h"
+#include "qdbfrecord.h"
+#include "qdbftable_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <qnumeric.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DEFAULT_EXPORT_BUFFER_SIZE = 4 * 1024 * 1024;
+const int EXPORT_CHUNKS_PER_THREAD = 2;
+const int DATE_LENGTH = 8;
+const int MAX_EXPORT_SCALE = 17;
+const char DELETED_MARK = '*';
+
+struct QDbfExportColumn
+{
+    QDbfField::QDbfType type;
+    int offset;
+    int length;
+    int precision;
+    QByteArray name;
+};
+
+class QDbfExporterPrivate
+{
+public:
+    QDbfExporterPrivate();
+
+    bool setColumns(const QDbfTablePrivate *table);
+    QByteArray header() const;
+    void formatRecord(const char *data, const QDbfCodec *codec, QDbfMemoFile *memo,
+                      QByteArray *text, QByteArray *out) const;
+
+    void appendText(const QByteArray &text, QByteArray *out) const;
+    void appendNull(QByteArray *out) const;
+    void appendName(const QByteArray &name, QByteArray *out) const;
+
+    static bool appendNumber(const QDbfExportColumn &column, const char *data, QByteArray *out);
+    static bool appendStoredNumber(const char *data, int length, QByteArray *out);
+    static bool appendDate(const char *data, bool quoted, QByteArray *out);
+
+    QDbfTable::DbfTableError m_error;
+    QDbfExporter::Format m_format;
+    QStringList m_fieldNames;
+    char m_delimiter;
+    bool m_headerEnabled;
+    bool m_skipDeleted;
+    int m_threadCount;
+    int m_bufferSize;
+    int m_recordsCount;
+    QVector<QDbfExportColumn> m_columns;
+};
+
+// chunks formatted by the workers wait in a ring of slots until the writer
+// takes them in order; workers never run more than the ring size ahead
+class QDbfExportQueue
+{
+public:
+    QDbfExportQueue(int chunksCount, int slotsCount) :
+        m_chunks(slotsCount),
+        m_counts(slotsCount, 0),
+        m_ready(slotsCount, false),
+        m_nextChunk(0),
+        m_writtenChunks(0),
+        m_chunksCount(chunksCount),
+        m_stopped(false)
+    {
+    }
+
+    bool takeChunk(int *chunk)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_stopped && m_nextChunk < m_chunksCount &&
+               m_nextChunk >= m_writtenChunks + m_chunks.size()) {
+            m_slotFree.wait(&m_mutex);
+        }
+        if (m_stopped || m_nextChunk >= m_chunksCount) {
+            return false;
+        }
+        *chunk = m_nextChunk++;
+        return true;
+    }
+
+    void putChunk(int chunk, const QByteArray &data, int count)
+    {
+        QMutexLocker locker(&m_mutex);
+        const int slot = chunk % m_chunks.size();
+        m_chunks[slot] = data;
+        m_counts[slot] = count;
+        m_ready[slot] = true;
+        m_chunkReady.wakeAll();
+    }
+
+    bool writeChunk(int chunk, QByteArray *data, int *count)
+    {
+        QMutexLocker locker(&m_mutex);
+        const int slot = chunk % m_chunks.size();
+        while (!m_stopped && !m_ready.at(slot)) {
+            m_chunkReady.wait(&m_mutex);
+        }
+        if (m_stopped) {
+            return false;
+        }
+        *data = m_chunks.at(slot);
+        *count = m_counts.at(slot);
+        m_chunks[slot] = QByteArray();
+        m_ready[slot] = false;
+        ++m_writtenChunks;
+        m_slotFree.wakeAll();
+        return true;
+    }
+
+    void stop()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        m_chunkReady.wakeAll();
+        m_slotFree.wakeAll();
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_chunkReady;
+    QWaitCondition m_slotFree;
+    QVector<QByteArray> m_chunks;
+    QVector<int> m_counts;
+    QVector<bool> m_ready;
+    int m_nextChunk;
+    int m_writtenChunks;
+    int m_chunksCount;
+    bool m_stopped;
+};
+
+class QDbfExportTask : public QRunnable
+{
+public:
+    QDbfExportTask(const QDbfExporterPrivate *exporter, QDbfExportQueue *queue,
+                   int chunkSize, int recordsCount) :
+        m_error(QDbfTable::NoError),
+        m_exporter(exporter),
+        m_queue(queue),
+        m_chunkSize(chunkSize),
+        m_recordsCount(recordsCount)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        int chunk = 0;
+        while (m_queue->takeChunk(&chunk)) {
+            QByteArray data;
+            int count = 0;
+            if (!formatChunk(chunk, &data, &count)) {
+                m_queue->stop();
+                return;
+            }
+            m_queue->putChunk(chunk, data, count);
+        }
+    }
+
+    bool formatChunk(int chunk, QByteArray *out, int *count)
+    {
+        const int begin = chunk * m_chunkSize;
+        const int end = qMin(begin + m_chunkSize, m_recordsCount);
+        const QDbfCodec *codec = m_reader.codec();
+        QDbfMemoFile *memo = m_reader.memoFile();
+
+        out->reserve(m_reader.bufferSize());
+        *count = 0;
+        for (int i = begin; i < end; ++i) {
+            const char *data = m_reader.recordPointer(i);
+            if (!data) {
+                m_error = m_reader.error();
+                return false;
+            }
+            if (m_exporter->m_skipDeleted && data[0] == DELETED_MARK) {
+                continue;
+            }
+            m_exporter->formatRecord(data, codec, memo, &m_text, out);
+            ++*count;
+        }
+
+        return true;
+    }
+
+    QDbfReader m_reader;
+    QDbfTable::DbfTableError m_error;
+
+private:
+    const QDbfExporterPrivate *m_exporter;
+    QDbfExportQueue *m_queue;
+    int m_chunkSize;
+    int m_recordsCount;
+    QByteArray m_text;
+};
+
+QDbfExporterPrivate::QDbfExporterPrivate() :
+    m_error(QDbfTable::NoError),
+    m_format(QDbfExporter::Csv),
+    m_delimiter(','),
+    m_headerEnabled(true),
+    m_skipDeleted(true),
+    m_threadCount(0),
+    m_bufferSize(DEFAULT_EXPORT_BUFFER_SIZE),
+    m_recordsCount(0)
+{
+}
+
+bool QDbfExporterPrivate::setColumns(const QDbfTablePrivate *table)
+{
+    // fields are read from the record bytes, so a projection does not hide any
+    QStringList names = m_fieldNames;
+    if (names.isEmpty()) {
+        for (int i = 0; i < table->m_record.count(); ++i) {
+            names.append(table->m_record.fieldName(i));
+        }
+    }
+
+    m_columns.clear();
+    m_columns.reserve(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        const int index = table->m_tableRecord.indexOf(names.at(i));
+        if (index < 0) {
+            qWarning("QDbfExporter::exportTable(): unknown field %s", qPrintable(names.at(i)));
+            return false;
+        }
+
+        const QDbfField field = table->m_tableRecord.field(index);
+        QDbfExportColumn column;
+        column.type = field.dbfType();
+        column.offset = field.offset();
+        column.length = field.length();
+        column.precision = field.precision();
+        column.name = field.name().toUtf8();
+        m_columns.append(column);
+    }
+
+    return true;
+}
+
+QByteArray QDbfExporterPrivate::header() const
+{
+    QByteArray out;
+    if (m_format != QDbfExporter::Csv || !m_headerEnabled) {
+        return out;
+    }
+
+    for (int i = 0; i < m_columns.size(); ++i) {
+        if (i > 0) {
+            out.append(m_delimiter);
+        }
+        appendText(m_columns.at(i).name, &out);
+    }
+    out.append("\r\n");
+
+    return out;
+}
+
+void QDbfExporterPrivate::appendText(const QByteArray &text, QByteArray *out) const
+{
+    const char *data = text.constData();
+    const int size = text.size();
+
+    if (m_format == QDbfExporter::Csv) {
+        bool quoted = false;
+        for (int i = 0; i < size && !quoted; ++i) {
+            const char c = data[i];
+            quoted = c == m_delimiter || c == '"' || c == '\r' || c == '\n';
+        }
+        if (!quoted) {
+            out->append(text);
+            return;
+        }
+
+        out->append('"');
+        for (int i = 0; i < size; ++i) {
+            if (data[i] == '"') {
+                out->append('"');
+            }
+            out->append(data[i]);
+        }
+        out->append('"');
+        return;
+    }
+
+    static const char hexDigits[] = "0123456789abcdef";
+
+    // UTF-8 sequences pass through, only quotes, backslashes and control
+    // characters are escaped
+    out->append('"');
+    int begin = 0;
+    for (int i = 0; i < size; ++i) {
+        const uchar c = static_cast<uchar>(data[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out->append(data + begin, i - begin);
+        begin = i + 1;
+        switch (c) {
+        case '"':
+            out->append("\\\"");
+            break;
+        case '\\':
+            out->append("\\\\");
+            break;
+        case '\n':
+            out->append("\\n");
+            break;
+        case '\r':
+            out->append("\\r");
+            break;
+        case '\t':
+            out->append("\\t");
+            break;
+        default: {
+            const char escaped[] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xF] };
+            out->append(escaped, sizeof(escaped));
+            break; }
+        }
+    }
+    out->append(data + begin, size - begin);
+    out->append('"');
+}
+
+void QDbfExporterPrivate::appendNull(QByteArray *out) const
+{
+    if (m_format == QDbfExporter::Ndjson) {
+        out->append("null");
+    }
+}
+
+void QDbfExporterPrivate::appendName(const QByteArray &name, QByteArray *out) const
+{
+    appendText(name, out);
+    out->append(':');
+}
+
+bool QDbfExporterPrivate::appendNumber(const QDbfExportColumn &column, const char *data,
+                                       QByteArray *out)
+{
+    // N values keep their decimals exactly, anything else keeps its stored digits
+    qint64 scaled = 0;
+    if (column.type == QDbfField::Number && column.precision <= MAX_EXPORT_SCALE &&
+        parseScaledNumber(data, column.length, column.precision, &scaled) == NumberValid) {
+        char buffer[32];
+        char *end = buffer + sizeof(buffer);
+        char *p = end;
+        quint64 magnitude = scaled < 0 ? 0 - static_cast<quint64>(scaled) :
+                                         static_cast<quint64>(scaled);
+        for (int i = 0; i < column.precision; ++i) {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        }
+        if (column.precision > 0) {
+            *--p = '.';
+        }
+        do {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (scaled < 0) {
+            *--p = '-';
+        }
+        out->append(p, static_cast<int>(end - p));
+        return true;
+    }
+
+    double value = 0.0;
+    if (parseNumber(data, column.length, &value) != NumberValid || !qIsFinite(value)) {
+        return false;
+    }
+
+    return appendStoredNumber(data, column.length, out);
+}
+
+bool QDbfExporterPrivate::appendStoredNumber(const char *data, int length, QByteArray *out)
+{
+    // the field text without padding, reduced to a JSON number: no '+' sign,
+    // no leading zeros and at least one digit on both sides of the point
+    int begin = 0;
+    int end = length;
+    while (begin < end && (data[begin] == ' ' || data[begin] == '\0')) {
+        ++begin;
+    }
+    while (end > begin && (data[end - 1] == ' ' || data[end - 1] == '\0')) {
+        --end;
+    }
+
+    char buffer[64];
+    if (end - begin + 2 > static_cast<int>(sizeof(buffer))) {
+        return false;
+    }
+
+    char *p = buffer;
+    int i = begin;
+    if (data[i] == '-') {
+        *p++ = '-';
+        ++i;
+    } else if (data[i] == '+') {
+        ++i;
+    }
+
+    while (i + 1 < end && data[i] == '0' && data[i + 1] >= '0' && data[i + 1] <= '9') {
+        ++i;
+    }
+
+    int digits = 0;
+    for (; i < end && data[i] >= '0' && data[i] <= '9'; ++i, ++digits) {
+        *p++ = data[i];
+    }
+    if (digits == 0) {
+        *p++ = '0';
+    }
+
+    if (i < end && data[i] == '.') {
+        ++i;
+        const char *point = p;
+        *p++ = '.';
+        for (; i < end && data[i] >= '0' && data[i] <= '9'; ++i, ++digits) {
+            *p++ = data[i];
+        }
+        if (p == point + 1) {
+            --p;
+        }
+    }
+
+    if (digits == 0) {
+        return false;
+    }
+
+    if (i < end && (data[i] == 'e' || data[i] == 'E')) {
+        *p++ = 'e';
+        ++i;
+        if (i < end && (data[i] == '-' || data[i] == '+')) {
+            if (data[i] == '-') {
+                *p++ = '-';
+            }
+            ++i;
+        }
+        const int exponentStart = i;
+        for (; i < end && data[i] >= '0' && data[i] <= '9'; ++i) {
+            *p++ = data[i];
+        }
+        if (i == exponentStart) {
+            return false;
+        }
+    }
+
+    if (i != end) {
+        return false;
+    }
+
+    out->append(buffer, static_cast<int>(p - buffer));
+    return true;
+}
+
+bool QDbfExporterPrivate::appendDate(const char *data, bool quoted, QByteArray *out)
+{
+    const int year = parseDigits(data, 4);
+    const int month = parseDigits(data + 4, 2);
+    const int day = parseDigits(data + 6, 2);
+    if (year <= 0 || month <= 0 || day <= 0 || !QDate(year, month, day).isValid()) {
+        return false;
+    }
+
+    // the date is plain ASCII, quoting it is enough for JSON
+    const char date[] = { '"', data[0], data[1], data[2], data[3], '-', data[4], data[5], '-',
+                          data[6], data[7], '"' };
+    if (quoted) {
+        out->append(date, sizeof(date));
+    } else {
+        out->append(date + 1, sizeof(date) - 2);
+    }
+
+    return true;
+}
+
+void QDbfExporterPrivate::formatRecord(const char *data, const QDbfCodec *codec,
+                                       QDbfMemoFile *memo, QByteArray *text,
+                                       QByteArray *out) const
+{
+    const bool json = m_format == QDbfExporter::Ndjson;
+    if (json) {
+        out->append('{');
+    }
+
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const QDbfExportColumn &column = m_columns.at(i);
+        const char *value = data + column.offset;
+
+        if (i > 0) {
+            out->append(json ? ',' : m_delimiter);
+        }
+        if (json) {
+            appendName(column.name, out);
+        }
+
+        bool valid = true;
+        switch (column.type) {
+        case QDbfField::Number:
+        case QDbfField::FloatingPoint:
+            valid = appendNumber(column, value, out);
+            break;
+        case QDbfField::Date:
+            valid = column.length >= DATE_LENGTH && appendDate(value, json, out);
+            break;
+        case QDbfField::Logical:
+            switch (column.length > 0 ? value[0] : ' ') {
+            case 'T': case 't': case 'Y': case 'y':
+                out->append("true");
+                break;
+            case 'F': case 'f': case 'N': case 'n':
+                out->append("false");
+                break;
+            default:
+                valid = false;
+                break;
+            }
+            break;
+        case QDbfField::Memo: {
+            const quint32 block = QDbfMemoFile::blockNumber(value, column.length);
+            valid = memo && block > 0;
+            if (valid) {
+                const QByteArray body = memo->read(block);
+                text->clear();
+                codec->appendUtf8(body.constData(), body.size(), text);
+                appendText(*text, out);
+            }
+            break; }
+        default: {
+            int length = column.length;
+            while (length > 0 && value[length - 1] == ' ') {
+                --length;
+            }
+            text->clear();
+            codec->appendUtf8(value, length, text);
+            appendText(*text, out);
+            break; }
+        }
+
+        if (!valid) {
+            appendNull(out);
+        }
+    }
+
+    out->append(json ? "}\n" : "\r\n");
+}
+
+} // namespace Internal
+
+QDbfExporter::QDbfExporter() :
+    d(new Internal::QDbfExporterPrivate())
+{
+}
+
+QDbfExporter::~QDbfExporter()
+{
+    delete d;
+}
+
+void QDbfExporter::setFormat(Format format)
+{
+    d->m_format = format;
+}
+
+QDbfExporter::Format QDbfExporter::format() const
+{
+    return d->m_format;
+}
+
+void QDbfExporter::setFieldNames(const QStringList &fieldNames)
+{
+    d->m_fieldNames = fieldNames;
+}
+
+QStringList QDbfExporter::fieldNames() const
+{
+    return d->m_fieldNames;
+}
+
+void QDbfExporter::setDelimiter(char delimiter)
+{
+    d->m_delimiter = delimiter;
+}
+
+char QDbfExporter::delimiter() const
+{
+    return d->m_delimiter;
+}
+
+void QDbfExporter::setHeaderEnabled(bool enabled)
+{
+    d->m_headerEnabled = enabled;
+}
+
+bool QDbfExporter::isHeaderEnabled() const
+{
+    return d->m_headerEnabled;
+}
+
+void QDbfExporter::setSkipDeleted(bool skip)
+{
+    d->m_skipDeleted = skip;
+}
+
+bool QDbfExporter::skipDeleted() const
+{
+    return d->m_skipDeleted;
+}
+
+void QDbfExporter::setThreadCount(int threadCount)
+{
+    d->m_threadCount = threadCount;
+}
+
+int QDbfExporter::threadCount() const
+{
+    return d->m_threadCount;
+}
+
+void QDbfExporter::setBufferSize(int size)
+{
+    d->m_bufferSize = qMax(0, size);
+}
+
+int QDbfExporter::bufferSize() const
+{
+    return d->m_bufferSize;
+}
+
+bool QDbfExporter::exportTable(const QDbfTable &table, QIODevice *device,
+                               QDbfProgressHandler *handler)
+{
+    d->m_recordsCount = 0;
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfExporter::exportTable(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!device || !device->isWritable()) {
+        qWarning("QDbfExporter::exportTable(): output device is not writable");
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (!d->setColumns(table.d)) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    // readers open the file on their own and must see every written record
+    if (table.d->m_file.isWritable()) {
+        table.d->m_file.flush();
+    }
+
+    const int recordsCount = table.d->size();
+    const int chunkSize = qMax(1, table.d->m_readBufferSize /
+                                  qMax(1, static_cast<int>(table.d->m_recordLength)));
+    const int chunksCount = recordsCount > 0 ? (recordsCount - 1) / chunkSize + 1 : 0;
+
+    int threadCount = d->m_threadCount > 0 ? d->m_threadCount : QThread::idealThreadCount();
+    threadCount = qBound(1, threadCount, qMax(1, chunksCount));
+
+    Internal::QDbfExportQueue queue(chunksCount, threadCount * Internal::EXPORT_CHUNKS_PER_THREAD);
+    QVector<Internal::QDbfExportTask *> tasks;
+    tasks.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        Internal::QDbfExportTask *task =
+                new Internal::QDbfExportTask(d, &queue, chunkSize, recordsCount);
+        tasks.append(task);
+        if (!task->m_reader.open(table.d)) {
+            d->m_error = task->m_reader.error();
+            qDeleteAll(tasks);
+            return false;
+        }
+    }
+
+    QByteArray buffer = d->header();
+    buffer.reserve(d->m_bufferSize + table.d->m_readBufferSize);
+
+    // a single worker formats in the calling thread between writes, more
+    // workers run ahead in a pool while the calling thread writes
+    QThreadPool pool;
+    if (threadCount > 1) {
+        pool.setMaxThreadCount(threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            pool.start(tasks.at(i));
+        }
+    }
+
+    for (int chunk = 0; chunk < chunksCount; ++chunk) {
+        QByteArray data;
+        int count = 0;
+        if (threadCount > 1) {
+            if (!queue.writeChunk(chunk, &data, &count)) {
+                break;
+            }
+        } else if (!tasks.first()->formatChunk(chunk, &data, &count)) {
+            break;
+        }
+
+        buffer.append(data);
+        d->m_recordsCount += count;
+
+        if (buffer.size() >= d->m_bufferSize) {
+            if (device->write(buffer) != buffer.size()) {
+                d->m_error = QDbfTable::WriteError;
+                queue.stop();
+                break;
+            }
+            buffer.clear();
+        }
+
+        if (handler) {
+            handler->progress(qMin((chunk + 1) * chunkSize, recordsCount), recordsCount);
+        }
+    }
+
+    pool.waitForDone();
+
+    for (int i = 0; i < threadCount && d->m_error == QDbfTable::NoError; ++i) {
+        d->m_error = tasks.at(i)->m_error;
+    }
+
+    qDeleteAll(tasks);
+
+    if (d->m_error == QDbfTable::NoError && !buffer.isEmpty() &&
+        device->write(buffer) != buffer.size()) {
+        d->m_error = QDbfTable::WriteError;
+    }
+
+    return d->m_error == QDbfTable::NoError;
+}
+
+bool QDbfExporter::exportTable(const QDbfTable &table, const QString &fileName,
+                               QDbfProgressHandler *handler)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("QDbfExporter::exportTable(): unable to open file %s", qPrintable(fileName));
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!exportTable(table, &file, handler)) {
+        return false;
+    }
+
+    if (!file.flush()) {
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    return true;
+}
+
+QDbfTable::DbfTableError QDbfExporter::error() const
+{
+    return d->m_error;
+}
+
+int QDbfExporter::recordsCount() const
+{
+    return d->m_recordsCount;
+}
+
+} // namespace QDbf
@@ -0,0 +1,73 @@
+#ifndef QDBFEXPORTER_H
+#define QDBFEXPORTER_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QString;
+class QStringList;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfExporterPrivate;
+} // namespace Internal
+
+// Writes the records of a table as CSV (RFC 4180) or as newline delimited
+// JSON objects. Values are formatted straight from the record bytes, chunk
+// by chunk on worker threads, and written in record order through one output
+// buffer; only a couple of chunks per thread are held in memory at a time.
+// Text is converted from the table codepage to UTF-8.
+class QDBF_EXPORT QDbfExporter
+{
+public:
+    enum Format {
+        Csv = 0,
+        Ndjson
+    };
+
+    QDbfExporter();
+    ~QDbfExporter();
+
+    void setFormat(Format format);
+    Format format() const;
+
+    // fields of the table record in the given order; when empty the fields
+    // of the table projection are written
+    void setFieldNames(const QStringList &fieldNames);
+    QStringList fieldNames() const;
+
+    void setDelimiter(char delimiter);
+    char delimiter() const;
+
+    void setHeaderEnabled(bool enabled);
+    bool isHeaderEnabled() const;
+
+    void setSkipDeleted(bool skip);
+    bool skipDeleted() const;
+
+    void setThreadCount(int threadCount);
+    int threadCount() const;
+
+    void setBufferSize(int size);
+    int bufferSize() const;
+
+    bool exportTable(const QDbfTable &table, QIODevice *device,
+                     QDbfProgressHandler *handler = 0);
+    bool exportTable(const QDbfTable &table, const QString &fileName,
+                     QDbfProgressHandler *handler = 0);
+
+    QDbfTable::DbfTableError error() const;
+    int recordsCount() const;
+
+private:
+    Q_DISABLE_COPY(QDbfExporter)
+
+    Internal::QDbfExporterPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFEXPORTER_H
@@ -28,8 +28,8 @@ public:
         Date,
         FloatingPoint,
         Logical,
-        //Memo,
-        Number
+        Number,
+        Memo
     };
 
     void setValue(const QVariant &value);
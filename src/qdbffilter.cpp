@@ -0,0 +1,344 @@
+#include "qdbffilter.h"
+#include "qdbffilter_p.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfschema_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QString>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DATE_LENGTH = 8;
+
+class QDbfFilterPrivate
+{
+public:
+    QDbfFilterPrivate();
+    QDbfFilterPrivate(const QDbfFilterPrivate &other);
+
+    enum ConditionKind {
+        Equal,
+        Prefix,
+        DateRange,
+        NumberRange,
+        Logical
+    };
+
+    struct Condition {
+        Condition() : kind(Equal), minimum(0.0), maximum(0.0), logical(false) {}
+
+        ConditionKind kind;
+        QString fieldName;
+        QString text;
+        QDate minimumDate;
+        QDate maximumDate;
+        double minimum;
+        double maximum;
+        bool logical;
+    };
+
+    void append(ConditionKind kind, const QString &fieldName, Condition *condition);
+
+    QAtomicInt ref;
+    QVector<Condition> m_conditions;
+    QDbfFilter::DeletedState m_deletedState;
+};
+
+QDbfFilterPrivate::QDbfFilterPrivate() :
+    ref(1),
+    m_deletedState(QDbfFilter::AnyRecord)
+{
+}
+
+QDbfFilterPrivate::QDbfFilterPrivate(const QDbfFilterPrivate &other) :
+    ref(1),
+    m_conditions(other.m_conditions),
+    m_deletedState(other.m_deletedState)
+{
+}
+
+void QDbfFilterPrivate::append(ConditionKind kind, const QString &fieldName, Condition *condition)
+{
+    condition->kind = kind;
+    condition->fieldName = fieldName;
+    m_conditions.append(*condition);
+}
+
+static QByteArray dateBytes(const QDate &date)
+{
+    if (!date.isValid() || date.year() <= 0 || date.year() > 9999) {
+        return QByteArray();
+    }
+
+    QByteArray data(DATE_LENGTH, '0');
+    formatDigits(date.year(), data.data(), 4);
+    formatDigits(date.month(), data.data() + 4, 2);
+    formatDigits(date.day(), data.data() + 6, 2);
+
+    return data;
+}
+
+static bool isTrue(char c)
+{
+    return c == 'T' || c == 't' || c == 'Y' || c == 'y';
+}
+
+static bool isFalse(char c)
+{
+    return c == 'F' || c == 'f' || c == 'N' || c == 'n';
+}
+
+QDbfFilterMatcher::QDbfFilterMatcher(const QDbfFilter &filter, const QDbfSchema *schema,
+                                     const QDbfCodec *codec) :
+    m_deletedState(filter.d->m_deletedState),
+    m_valid(schema != 0 && codec != 0)
+{
+    if (!m_valid) {
+        return;
+    }
+
+    const QVector<QDbfFilterPrivate::Condition> &conditions = filter.d->m_conditions;
+    m_terms.reserve(conditions.size());
+
+    for (int i = 0; i < conditions.size(); ++i) {
+        const QDbfFilterPrivate::Condition &condition = conditions.at(i);
+        const int index = schema->indexOf(condition.fieldName);
+        if (index < 0) {
+            qWarning("QDbfFilterMatcher: unknown field %s", qPrintable(condition.fieldName));
+            m_valid = false;
+            return;
+        }
+
+        const QDbfField::QDbfType type = schema->m_types.at(index);
+
+        Term term;
+        term.offset = schema->m_offsets.at(index);
+        term.length = schema->m_lengths.at(index);
+        term.minimumNumber = 0.0;
+        term.maximumNumber = 0.0;
+        term.logical = false;
+
+        bool typeMatches = false;
+        switch (condition.kind) {
+        case QDbfFilterPrivate::Equal:
+            typeMatches = type == QDbfField::Character;
+            term.kind = EqualTerm;
+            term.minimum = codec->fromUnicode(condition.text);
+            // stored values are padded with spaces, a longer value never matches
+            if (term.minimum.size() < term.length) {
+                term.minimum.append(QByteArray(term.length - term.minimum.size(), ' '));
+            }
+            break;
+        case QDbfFilterPrivate::Prefix:
+            typeMatches = type == QDbfField::Character;
+            term.kind = PrefixTerm;
+            term.minimum = codec->fromUnicode(condition.text);
+            break;
+        case QDbfFilterPrivate::DateRange:
+            // yyyyMMdd compares in date order byte by byte
+            typeMatches = type == QDbfField::Date && term.length == DATE_LENGTH;
+            term.kind = DateRangeTerm;
+            term.minimum = dateBytes(condition.minimumDate);
+            term.maximum = dateBytes(condition.maximumDate);
+            break;
+        case QDbfFilterPrivate::NumberRange:
+            typeMatches = type == QDbfField::Number || type == QDbfField::FloatingPoint;
+            term.kind = NumberRangeTerm;
+            term.minimumNumber = condition.minimum;
+            term.maximumNumber = condition.maximum;
+            break;
+        case QDbfFilterPrivate::Logical:
+            typeMatches = type == QDbfField::Logical && term.length > 0;
+            term.kind = LogicalTerm;
+            term.logical = condition.logical;
+            break;
+        }
+
+        if (!typeMatches) {
+            qWarning("QDbfFilterMatcher: condition does not fit the type of field %s",
+                     qPrintable(condition.fieldName));
+            m_valid = false;
+            return;
+        }
+
+        m_terms.append(term);
+    }
+}
+
+bool QDbfFilterMatcher::isValid() const
+{
+    return m_valid;
+}
+
+bool QDbfFilterMatcher::matches(const char *data) const
+{
+    if (!m_valid) {
+        return false;
+    }
+
+    switch (m_deletedState) {
+    case QDbfFilter::NotDeleted:
+        if (data[0] == '*') {
+            return false;
+        }
+        break;
+    case QDbfFilter::DeletedOnly:
+        if (data[0] != '*') {
+            return false;
+        }
+        break;
+    case QDbfFilter::AnyRecord:
+        break;
+    }
+
+    for (int i = 0; i < m_terms.size(); ++i) {
+        if (!matches(m_terms.at(i), data)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool QDbfFilterMatcher::matches(const Term &term, const char *data) const
+{
+    const char *field = data + term.offset;
+
+    switch (term.kind) {
+    case EqualTerm:
+        return term.minimum.size() == term.length &&
+               memcmp(field, term.minimum.constData(), term.length) == 0;
+    case PrefixTerm:
+        return term.minimum.size() <= term.length &&
+               memcmp(field, term.minimum.constData(), term.minimum.size()) == 0;
+    case DateRangeTerm:
+        if (field[0] == ' ') {
+            return false;
+        }
+        if (!term.minimum.isEmpty() && memcmp(field, term.minimum.constData(), DATE_LENGTH) < 0) {
+            return false;
+        }
+        if (!term.maximum.isEmpty() && memcmp(field, term.maximum.constData(), DATE_LENGTH) > 0) {
+            return false;
+        }
+        return true;
+    case NumberRangeTerm: {
+        double value = 0.0;
+        if (parseNumber(field, term.length, &value) != NumberValid) {
+            return false;
+        }
+        return value >= term.minimumNumber && value <= term.maximumNumber;
+    }
+    case LogicalTerm:
+        return term.logical ? isTrue(field[0]) : isFalse(field[0]);
+    }
+
+    return false;
+}
+
+} // namespace Internal
+
+QDbfFilter::QDbfFilter() :
+    d(new Internal::QDbfFilterPrivate())
+{
+}
+
+QDbfFilter::QDbfFilter(const QDbfFilter &other) :
+    d(other.d)
+{
+    d->ref.ref();
+}
+
+QDbfFilter &QDbfFilter::operator=(const QDbfFilter &other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    qAtomicAssign(d, other.d);
+    return *this;
+}
+
+QDbfFilter::~QDbfFilter()
+{
+    if (!d->ref.deref()) {
+        delete d;
+    }
+}
+
+void QDbfFilter::addEqual(const QString &fieldName, const QString &value)
+{
+    detach();
+    Internal::QDbfFilterPrivate::Condition condition;
+    condition.text = value;
+    d->append(Internal::QDbfFilterPrivate::Equal, fieldName, &condition);
+}
+
+void QDbfFilter::addPrefix(const QString &fieldName, const QString &prefix)
+{
+    detach();
+    Internal::QDbfFilterPrivate::Condition condition;
+    condition.text = prefix;
+    d->append(Internal::QDbfFilterPrivate::Prefix, fieldName, &condition);
+}
+
+void QDbfFilter::addDateRange(const QString &fieldName, const QDate &minimum, const QDate &maximum)
+{
+    detach();
+    Internal::QDbfFilterPrivate::Condition condition;
+    condition.minimumDate = minimum;
+    condition.maximumDate = maximum;
+    d->append(Internal::QDbfFilterPrivate::DateRange, fieldName, &condition);
+}
+
+void QDbfFilter::addNumberRange(const QString &fieldName, double minimum, double maximum)
+{
+    detach();
+    Internal::QDbfFilterPrivate::Condition condition;
+    condition.minimum = minimum;
+    condition.maximum = maximum;
+    d->append(Internal::QDbfFilterPrivate::NumberRange, fieldName, &condition);
+}
+
+void QDbfFilter::addLogical(const QString &fieldName, bool value)
+{
+    detach();
+    Internal::QDbfFilterPrivate::Condition condition;
+    condition.logical = value;
+    d->append(Internal::QDbfFilterPrivate::Logical, fieldName, &condition);
+}
+
+void QDbfFilter::setDeletedState(DeletedState state)
+{
+    detach();
+    d->m_deletedState = state;
+}
+
+QDbfFilter::DeletedState QDbfFilter::deletedState() const
+{
+    return d->m_deletedState;
+}
+
+bool QDbfFilter::isEmpty() const
+{
+    return d->m_conditions.isEmpty() && d->m_deletedState == QDbfFilter::AnyRecord;
+}
+
+void QDbfFilter::clear()
+{
+    detach();
+    d->m_conditions.clear();
+    d->m_deletedState = QDbfFilter::AnyRecord;
+}
+
+void QDbfFilter::detach()
+{
+    qAtomicDetach(d);
+}
+
+} // namespace QDbf
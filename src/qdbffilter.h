@@ -0,0 +1,55 @@
+#ifndef QDBFFILTER_H
+#define QDBFFILTER_H
+
+#include "qdbf_global.h"
+
+QT_BEGIN_NAMESPACE
+class QDate;
+class QString;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfFilterMatcher;
+class QDbfFilterPrivate;
+} // namespace Internal
+
+// Conjunction of simple conditions that are evaluated on the stored bytes of
+// a record, before anything is decoded. Invalid dates and infinite numbers
+// leave that side of a range open.
+class QDBF_EXPORT QDbfFilter
+{
+public:
+    enum DeletedState {
+        AnyRecord = 0,
+        NotDeleted,
+        DeletedOnly
+    };
+
+    QDbfFilter();
+    QDbfFilter(const QDbfFilter &other);
+    QDbfFilter &operator=(const QDbfFilter &other);
+    ~QDbfFilter();
+
+    void addEqual(const QString &fieldName, const QString &value);
+    void addPrefix(const QString &fieldName, const QString &prefix);
+    void addDateRange(const QString &fieldName, const QDate &minimum, const QDate &maximum);
+    void addNumberRange(const QString &fieldName, double minimum, double maximum);
+    void addLogical(const QString &fieldName, bool value);
+
+    void setDeletedState(DeletedState state);
+    DeletedState deletedState() const;
+
+    bool isEmpty() const;
+    void clear();
+
+private:
+    Internal::QDbfFilterPrivate *d;
+    void detach();
+
+    friend class Internal::QDbfFilterMatcher;
+};
+
+} // namespace QDbf
+
+#endif // QDBFFILTER_H
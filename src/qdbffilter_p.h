@@ -0,0 +1,54 @@
+#ifndef QDBFFILTER_P_H
+#define QDBFFILTER_P_H
+
+#include "qdbffilter.h"
+
+#include <QByteArray>
+#include <QVector>
+
+namespace QDbf {
+namespace Internal {
+
+class QDbfCodec;
+class QDbfSchema;
+
+// QDbfFilter resolved against the field offsets of one table
+class QDbfFilterMatcher
+{
+public:
+    QDbfFilterMatcher(const QDbfFilter &filter, const QDbfSchema *schema, const QDbfCodec *codec);
+
+    bool isValid() const;
+    bool matches(const char *data) const;
+
+private:
+    enum TermKind {
+        EqualTerm,
+        PrefixTerm,
+        DateRangeTerm,
+        NumberRangeTerm,
+        LogicalTerm
+    };
+
+    struct Term {
+        TermKind kind;
+        int offset;
+        int length;
+        QByteArray minimum;
+        QByteArray maximum;
+        double minimumNumber;
+        double maximumNumber;
+        bool logical;
+    };
+
+    bool matches(const Term &term, const char *data) const;
+
+    QVector<Term> m_terms;
+    QDbfFilter::DeletedState m_deletedState;
+    bool m_valid;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFFILTER_P_H
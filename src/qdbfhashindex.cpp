@@ -0,0 +1,627 @@
+#include "qdbfhashindex.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfrecordview.h"
+#include "qdbfschema_p.h"
+#include "qdbftable_p.h"
+
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QVarLengthArray>
+#include <QVariant>
+#include <QtEndian>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const char HASH_INDEX_MAGIC[] = "QDBFHIX2";
+const int HASH_INDEX_MAGIC_LENGTH = 8;
+const int HASH_INDEX_HEADER_LENGTH = 64;
+const int HASH_INDEX_FIELD_NAME_LENGTH = 11;
+const int MIN_SLOTS_COUNT = 16;
+const int DATE_LENGTH = 8;
+
+class QDbfHashIndexPrivate
+{
+public:
+    QDbfHashIndexPrivate();
+
+    void clear();
+    bool setField(const QDbfTablePrivate *table, const QString &fieldName);
+    void normalize(const char *data, char *key) const;
+    bool encodeValue(const QVariant &value, char *key) const;
+    int findKey(const char *key) const;
+    void buildSlots(int slotsCount);
+
+    static quint32 hash(const char *key, int length);
+
+    QDbfTable::DbfTableError m_error;
+    QString m_fieldName;
+    QDbfField::QDbfType m_type;
+    const QDbfCodec *m_codec;
+    int m_offset;
+    int m_width;
+    int m_precision;
+    int m_recordsCount;
+    qint64 m_tableSize;
+    qint64 m_tableModified;
+    bool m_valid;
+
+    // distinct keys back to back, the records of key i are
+    // m_records[m_offsets[i]] .. m_records[m_offsets[i + 1] - 1]
+    QByteArray m_keys;
+    QVector<quint32> m_offsets;
+    QVector<quint32> m_records;
+    QVector<qint32> m_slots;
+};
+
+// copies the key field of every record into its place of a flat buffer
+class QDbfHashKeyCollector : public QDbfScanHandler
+{
+public:
+    QDbfHashKeyCollector(const QDbfHashIndexPrivate *index, char *keys) :
+        m_index(index),
+        m_keys(keys)
+    {
+    }
+
+    bool processRecord(const QDbfRecordView &record, int threadIndex)
+    {
+        Q_UNUSED(threadIndex)
+        m_index->normalize(record.data() + m_index->m_offset,
+                           m_keys + static_cast<qint64>(record.recordIndex()) * m_index->m_width);
+        return true;
+    }
+
+private:
+    const QDbfHashIndexPrivate *m_index;
+    char *m_keys;
+};
+
+QDbfHashIndexPrivate::QDbfHashIndexPrivate() :
+    m_error(QDbfTable::NoError),
+    m_type(QDbfField::UnknownDataType),
+    m_codec(0),
+    m_offset(0),
+    m_width(0),
+    m_precision(0),
+    m_recordsCount(0),
+    m_tableSize(0),
+    m_tableModified(0),
+    m_valid(false)
+{
+}
+
+void QDbfHashIndexPrivate::clear()
+{
+    m_fieldName.clear();
+    m_recordsCount = 0;
+    m_tableSize = 0;
+    m_tableModified = 0;
+    m_valid = false;
+    m_keys.clear();
+    m_offsets.clear();
+    m_records.clear();
+    m_slots.clear();
+}
+
+bool QDbfHashIndexPrivate::setField(const QDbfTablePrivate *table, const QString &fieldName)
+{
+    const int fieldIndex = table->m_tableRecord.indexOf(fieldName);
+    if (fieldIndex < 0) {
+        qWarning("QDbfHashIndex: no field %s", qPrintable(fieldName));
+        return false;
+    }
+
+    const QDbfField field = table->m_tableRecord.field(fieldIndex);
+    switch (field.dbfType()) {
+    case QDbfField::Character:
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint:
+    case QDbfField::Date:
+    case QDbfField::Logical:
+        break;
+    default:
+        qWarning("QDbfHashIndex: field %s can not be indexed", qPrintable(fieldName));
+        return false;
+    }
+
+    m_fieldName = field.name();
+    m_type = field.dbfType();
+    m_codec = table->m_codec;
+    m_offset = field.offset();
+    m_width = field.length();
+    m_precision = field.precision();
+
+    return m_width > 0;
+}
+
+void QDbfHashIndexPrivate::normalize(const char *data, char *key) const
+{
+    // numbers and logicals are stored in more than one way
+    switch (m_type) {
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint: {
+        double value = 0.0;
+        if (parseNumber(data, m_width, &value) != NumberValid ||
+            !formatNumber(value, m_precision, key, m_width)) {
+            memcpy(key, data, m_width);
+        }
+        break;
+    }
+    case QDbfField::Logical:
+        memset(key, ' ', m_width);
+        switch (data[0]) {
+        case 'T': case 't': case 'Y': case 'y':
+            key[0] = 'T';
+            break;
+        case 'F': case 'f': case 'N': case 'n':
+            key[0] = 'F';
+            break;
+        default:
+            break;
+        }
+        break;
+    default:
+        memcpy(key, data, m_width);
+        break;
+    }
+}
+
+bool QDbfHashIndexPrivate::encodeValue(const QVariant &value, char *key) const
+{
+    memset(key, ' ', m_width);
+
+    switch (m_type) {
+    case QDbfField::Character: {
+        const QString string = value.toString();
+        m_codec->fromUnicode(string.constData(), string.length(), key, m_width);
+        return true;
+    }
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint: {
+        bool ok = false;
+        const double number = value.toDouble(&ok);
+        return ok && formatNumber(number, m_precision, key, m_width);
+    }
+    case QDbfField::Date: {
+        const QDate date = value.toDate();
+        if (date.isValid() && m_width >= DATE_LENGTH) {
+            formatDigits(date.year(), key, 4);
+            formatDigits(date.month(), key + 4, 2);
+            formatDigits(date.day(), key + 6, 2);
+        }
+        return true;
+    }
+    case QDbfField::Logical:
+        key[0] = value.toBool() ? 'T' : 'F';
+        return true;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+int QDbfHashIndexPrivate::findKey(const char *key) const
+{
+    if (m_slots.isEmpty()) {
+        return -1;
+    }
+
+    const quint32 mask = m_slots.size() - 1;
+    for (quint32 slot = hash(key, m_width) & mask; ; slot = (slot + 1) & mask) {
+        const qint32 keyIndex = m_slots.at(slot);
+        if (keyIndex < 0) {
+            return -1;
+        }
+        if (memcmp(m_keys.constData() + static_cast<qint64>(keyIndex) * m_width, key, m_width) == 0) {
+            return keyIndex;
+        }
+    }
+}
+
+void QDbfHashIndexPrivate::buildSlots(int slotsCount)
+{
+    m_slots.fill(-1, slotsCount);
+
+    const quint32 mask = slotsCount - 1;
+    const int keysCount = m_offsets.size() - 1;
+    for (int i = 0; i < keysCount; ++i) {
+        quint32 slot = hash(m_keys.constData() + static_cast<qint64>(i) * m_width, m_width) & mask;
+        while (m_slots.at(slot) >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = i;
+    }
+}
+
+quint32 QDbfHashIndexPrivate::hash(const char *key, int length)
+{
+    // FNV-1a, stable across runs so that saved slots stay usable
+    quint32 result = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        result = (result ^ static_cast<uchar>(key[i])) * 16777619u;
+    }
+
+    return result;
+}
+
+static int slotsCountFor(int keysCount)
+{
+    // at most half of the slots are used
+    int count = MIN_SLOTS_COUNT;
+    while (count < 2 * keysCount) {
+        count *= 2;
+    }
+
+    return count;
+}
+
+static void writeArray(QByteArray *data, const quint32 *values, int count)
+{
+    const int offset = data->size();
+    data->resize(offset + count * 4);
+    uchar *out = reinterpret_cast<uchar *>(data->data() + offset);
+    for (int i = 0; i < count; ++i) {
+        qToLittleEndian<quint32>(values[i], out + i * 4);
+    }
+}
+
+static bool readArray(const QByteArray &data, int *offset, quint32 *values, int count)
+{
+    if (count < 0 || data.size() - *offset < static_cast<qint64>(count) * 4) {
+        return false;
+    }
+
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData() + *offset);
+    for (int i = 0; i < count; ++i) {
+        values[i] = qFromLittleEndian<quint32>(in + i * 4);
+    }
+    *offset += count * 4;
+
+    return true;
+}
+
+} // namespace Internal
+
+QDbfHashIndex::QDbfHashIndex() :
+    d(new Internal::QDbfHashIndexPrivate())
+{
+}
+
+QDbfHashIndex::~QDbfHashIndex()
+{
+    delete d;
+}
+
+bool QDbfHashIndex::build(const QDbfTable &table, const QString &fieldName, int threadCount)
+{
+    d->clear();
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfHashIndex::build(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!d->setField(table.d, fieldName)) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    // scanParallel() flushes pending writes, the file info is taken after it
+    const int recordsCount = table.size();
+    const int width = d->m_width;
+
+    // the key bytes of all records are gathered in parallel, the table of
+    // distinct keys is filled afterwards in record order
+    QByteArray keys(recordsCount * width, ' ');
+    Internal::QDbfHashKeyCollector collector(d, keys.data());
+    if (!table.scanParallel(&collector, threadCount)) {
+        d->m_error = table.error();
+        return false;
+    }
+
+    QVector<quint32> keyIndexes(recordsCount);
+    QVector<quint32> counts;
+    d->m_slots.fill(-1, Internal::slotsCountFor(recordsCount));
+    const quint32 mask = d->m_slots.size() - 1;
+
+    for (int i = 0; i < recordsCount; ++i) {
+        const char *key = keys.constData() + static_cast<qint64>(i) * width;
+        quint32 slot = Internal::QDbfHashIndexPrivate::hash(key, width) & mask;
+        for (;;) {
+            const qint32 keyIndex = d->m_slots.at(slot);
+            if (keyIndex < 0) {
+                d->m_slots[slot] = counts.size();
+                d->m_keys.append(key, width);
+                keyIndexes[i] = counts.size();
+                counts.append(1);
+                break;
+            }
+            if (memcmp(d->m_keys.constData() + static_cast<qint64>(keyIndex) * width, key, width) == 0) {
+                keyIndexes[i] = keyIndex;
+                ++counts[keyIndex];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    keys.clear();
+
+    d->m_offsets.resize(counts.size() + 1);
+    d->m_offsets[0] = 0;
+    for (int i = 0; i < counts.size(); ++i) {
+        d->m_offsets[i + 1] = d->m_offsets.at(i) + counts.at(i);
+        counts[i] = d->m_offsets.at(i);
+    }
+
+    d->m_records.resize(recordsCount);
+    for (int i = 0; i < recordsCount; ++i) {
+        d->m_records[counts[keyIndexes.at(i)]++] = i;
+    }
+
+    // size the slots for the distinct keys instead of all records
+    d->buildSlots(Internal::slotsCountFor(counts.size()));
+
+    const QFileInfo tableInfo(table.d->m_fileName);
+    d->m_tableSize = tableInfo.size();
+    d->m_tableModified = tableInfo.lastModified().toMSecsSinceEpoch();
+    d->m_recordsCount = recordsCount;
+    d->m_valid = true;
+    d->m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfHashIndex::load(const QDbfTable &table, const QString &fieldName, const QString &fileName)
+{
+    d->clear();
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfHashIndex::load(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!d->setField(table.d, fieldName)) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    if (data.size() < Internal::HASH_INDEX_HEADER_LENGTH ||
+        memcmp(data.constData(), Internal::HASH_INDEX_MAGIC, Internal::HASH_INDEX_MAGIC_LENGTH) != 0) {
+        d->m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    if (table.d->m_file.isWritable()) {
+        table.d->m_file.flush();
+    }
+
+    const QFileInfo tableInfo(table.d->m_fileName);
+    const uchar *header = reinterpret_cast<const uchar *>(data.constData());
+    const QByteArray storedName(data.constData() + 40, Internal::HASH_INDEX_FIELD_NAME_LENGTH);
+    const qint64 tableSize = qFromLittleEndian<qint64>(header + 8);
+    const qint64 tableModified = qFromLittleEndian<qint64>(header + 16);
+
+    // anything that changed since save() makes the sidecar file useless
+    if (tableSize != tableInfo.size() ||
+        tableModified != tableInfo.lastModified().toMSecsSinceEpoch() ||
+        static_cast<int>(qFromLittleEndian<quint32>(header + 24)) != table.size() ||
+        static_cast<int>(qFromLittleEndian<quint32>(header + 28)) != d->m_offset ||
+        static_cast<int>(qFromLittleEndian<quint32>(header + 32)) != d->m_width ||
+        header[36] != static_cast<uchar>(Internal::typeCharacter(d->m_type)) ||
+        QString::fromLatin1(storedName.constData()).compare(d->m_fieldName, Qt::CaseInsensitive) != 0) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    const int keysCount = qFromLittleEndian<quint32>(header + 52);
+    const int slotsCount = qFromLittleEndian<quint32>(header + 56);
+    const int recordsCount = table.size();
+
+    int offset = Internal::HASH_INDEX_HEADER_LENGTH;
+    if (keysCount < 0 || slotsCount < Internal::slotsCountFor(keysCount) ||
+        (slotsCount & (slotsCount - 1)) != 0 ||
+        data.size() - offset < static_cast<qint64>(keysCount) * d->m_width) {
+        d->m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    d->m_keys = data.mid(offset, keysCount * d->m_width);
+    offset += keysCount * d->m_width;
+
+    d->m_offsets.resize(keysCount + 1);
+    d->m_records.resize(recordsCount);
+    QVector<quint32> storedSlots(slotsCount);
+    if (!Internal::readArray(data, &offset, d->m_offsets.data(), keysCount + 1) ||
+        !Internal::readArray(data, &offset, d->m_records.data(), recordsCount) ||
+        !Internal::readArray(data, &offset, storedSlots.data(), slotsCount) ||
+        d->m_offsets.last() != static_cast<quint32>(recordsCount)) {
+        d->clear();
+        d->m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    d->m_slots.resize(slotsCount);
+    for (int i = 0; i < slotsCount; ++i) {
+        d->m_slots[i] = static_cast<qint32>(storedSlots.at(i));
+        if (d->m_slots.at(i) >= keysCount) {
+            d->clear();
+            d->m_error = QDbfTable::ReadError;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < recordsCount; ++i) {
+        if (d->m_records.at(i) >= static_cast<quint32>(recordsCount)) {
+            d->clear();
+            d->m_error = QDbfTable::ReadError;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < keysCount; ++i) {
+        if (d->m_offsets.at(i) > d->m_offsets.at(i + 1)) {
+            d->clear();
+            d->m_error = QDbfTable::ReadError;
+            return false;
+        }
+    }
+
+    d->m_recordsCount = recordsCount;
+    d->m_tableSize = tableSize;
+    d->m_tableModified = tableModified;
+    d->m_valid = true;
+    d->m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfHashIndex::save(const QString &fileName) const
+{
+    if (!d->m_valid) {
+        qWarning("QDbfHashIndex::save(): index is not built");
+        return false;
+    }
+
+    const int keysCount = d->m_offsets.size() - 1;
+
+    QByteArray data(Internal::HASH_INDEX_HEADER_LENGTH, '\0');
+    uchar *header = reinterpret_cast<uchar *>(data.data());
+    memcpy(header, Internal::HASH_INDEX_MAGIC, Internal::HASH_INDEX_MAGIC_LENGTH);
+    qToLittleEndian<qint64>(d->m_tableSize, header + 8);
+    qToLittleEndian<qint64>(d->m_tableModified, header + 16);
+    qToLittleEndian<quint32>(d->m_recordsCount, header + 24);
+    qToLittleEndian<quint32>(d->m_offset, header + 28);
+    qToLittleEndian<quint32>(d->m_width, header + 32);
+    header[36] = static_cast<uchar>(Internal::typeCharacter(d->m_type));
+    const QByteArray name = d->m_fieldName.toLatin1().left(Internal::HASH_INDEX_FIELD_NAME_LENGTH);
+    memcpy(header + 40, name.constData(), name.size());
+    qToLittleEndian<quint32>(keysCount, header + 52);
+    qToLittleEndian<quint32>(d->m_slots.size(), header + 56);
+
+    data.reserve(data.size() + d->m_keys.size() +
+                 4 * (d->m_offsets.size() + d->m_records.size() + d->m_slots.size()));
+    data.append(d->m_keys);
+    Internal::writeArray(&data, d->m_offsets.constData(), d->m_offsets.size());
+    Internal::writeArray(&data, d->m_records.constData(), d->m_records.size());
+    Internal::writeArray(&data, reinterpret_cast<const quint32 *>(d->m_slots.constData()),
+                         d->m_slots.size());
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (file.write(data) != data.size()) {
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+void QDbfHashIndex::clear()
+{
+    d->clear();
+    d->m_error = QDbfTable::NoError;
+}
+
+bool QDbfHashIndex::isValid() const
+{
+    return d->m_valid;
+}
+
+QDbfTable::DbfTableError QDbfHashIndex::error() const
+{
+    return d->m_error;
+}
+
+QString QDbfHashIndex::fieldName() const
+{
+    return d->m_fieldName;
+}
+
+int QDbfHashIndex::size() const
+{
+    return d->m_recordsCount;
+}
+
+int QDbfHashIndex::keysCount() const
+{
+    return d->m_valid ? d->m_offsets.size() - 1 : 0;
+}
+
+int QDbfHashIndex::find(const QVariant &value) const
+{
+    if (!d->m_valid) {
+        return -1;
+    }
+
+    QVarLengthArray<char, 256> key(d->m_width);
+    if (!d->encodeValue(value, key.data())) {
+        return -1;
+    }
+
+    const int keyIndex = d->findKey(key.constData());
+    return keyIndex < 0 ? -1 : static_cast<int>(d->m_records.at(d->m_offsets.at(keyIndex)));
+}
+
+QVector<int> QDbfHashIndex::findAll(const QVariant &value) const
+{
+    QVector<int> indexes;
+    if (!d->m_valid) {
+        return indexes;
+    }
+
+    QVarLengthArray<char, 256> key(d->m_width);
+    if (!d->encodeValue(value, key.data())) {
+        return indexes;
+    }
+
+    const int keyIndex = d->findKey(key.constData());
+    if (keyIndex < 0) {
+        return indexes;
+    }
+
+    const int first = d->m_offsets.at(keyIndex);
+    const int last = d->m_offsets.at(keyIndex + 1);
+    indexes.reserve(last - first);
+    for (int i = first; i < last; ++i) {
+        indexes.append(d->m_records.at(i));
+    }
+
+    return indexes;
+}
+
+bool QDbfHashIndex::seek(const QDbfTable &table, const QVariant &value) const
+{
+    const int index = find(value);
+    if (index < 0 || index >= table.size()) {
+        return false;
+    }
+
+    return table.seek(index);
+}
+
+} // namespace QDbf
@@ -0,0 +1,53 @@
+#ifndef QDBFHASHINDEX_H
+#define QDBFHASHINDEX_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QString;
+class QVariant;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfHashIndexPrivate;
+} // namespace Internal
+
+// In-memory map from the values of one field to the indexes of the records
+// holding them, for point lookups on tables without index files. It is a
+// snapshot of the table at build time and covers deleted records too. The
+// sidecar file written by save() is only loaded back while the size and the
+// modification time of the table file are unchanged.
+class QDBF_EXPORT QDbfHashIndex
+{
+public:
+    QDbfHashIndex();
+    ~QDbfHashIndex();
+
+    bool build(const QDbfTable &table, const QString &fieldName, int threadCount = 0);
+    bool load(const QDbfTable &table, const QString &fieldName, const QString &fileName);
+    bool save(const QString &fileName) const;
+    void clear();
+
+    bool isValid() const;
+    QDbfTable::DbfTableError error() const;
+    QString fieldName() const;
+    int size() const;
+    int keysCount() const;
+
+    int find(const QVariant &value) const;
+    QVector<int> findAll(const QVariant &value) const;
+    bool seek(const QDbfTable &table, const QVariant &value) const;
+
+private:
+    Q_DISABLE_COPY(QDbfHashIndex)
+
+    Internal::QDbfHashIndexPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFHASHINDEX_H
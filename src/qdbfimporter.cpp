@@ -0,0 +1,720 @@
+#include "qdbfimporter.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbffield.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfrecord.h"
+#include "qdbftable_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QFile>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int IMPORT_CHUNK_SIZE = 1024 * 1024;
+const int IMPORT_CHUNKS_PER_THREAD = 2;
+const int DEFAULT_IMPORT_BATCH_SIZE = 16 * 1024;
+const int DATE_LENGTH = 8;
+const char END_OF_FILE_MARK = 26;
+const char UTF8_BOM[] = "\xEF\xBB\xBF";
+const int UTF8_BOM_LENGTH = 3;
+
+struct QDbfImportColumn
+{
+    QDbfField::QDbfType type;
+    int offset;
+    int length;
+    int precision;
+    QString name;
+};
+
+struct QDbfImportRowError
+{
+    int line;
+    QString fieldName;
+    QString message;
+};
+
+// Splits the row at *data off the CSV text and unquotes its cells, *lines
+// is set to the number of line breaks the row spans. Returns false for
+// stray or unterminated quotes; the row is consumed all the same.
+static bool parseCsvRow(const char **data, const char *end, char delimiter,
+                        QVector<QByteArray> *cells, int *lines)
+{
+    const char *p = *data;
+    bool wellFormed = true;
+
+    cells->clear();
+    *lines = 0;
+
+    for (;;) {
+        QByteArray cell;
+        if (p < end && *p == '"') {
+            ++p;
+            for (;;) {
+                if (p >= end) {
+                    wellFormed = false;
+                    break;
+                }
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        cell.append('"');
+                        p += 2;
+                        continue;
+                    }
+                    ++p;
+                    break;
+                }
+                if (*p == '\n') {
+                    ++*lines;
+                }
+                cell.append(*p++);
+            }
+            if (p < end && *p == '\r' && (p + 1 >= end || p[1] == '\n')) {
+                ++p;
+            }
+            while (p < end && *p != delimiter && *p != '\n') {
+                wellFormed = false;
+                ++p;
+            }
+        } else {
+            const char *begin = p;
+            while (p < end && *p != delimiter && *p != '\n') {
+                if (*p == '"') {
+                    wellFormed = false;
+                }
+                ++p;
+            }
+            const char *cellEnd = p;
+            if (cellEnd > begin && cellEnd[-1] == '\r' && (p >= end || *p == '\n')) {
+                --cellEnd;
+            }
+            cell = QByteArray(begin, static_cast<int>(cellEnd - begin));
+        }
+
+        cells->append(cell);
+
+        if (p < end && *p == delimiter) {
+            ++p;
+            continue;
+        }
+        if (p < end && *p == '\n') {
+            ++p;
+            ++*lines;
+        }
+        break;
+    }
+
+    *data = p;
+
+    return wellFormed;
+}
+
+// Cuts the input into chunks of whole rows of about IMPORT_CHUNK_SIZE bytes.
+// Only line breaks outside of quotes end a row. Like in parseCsvRow() a
+// quote only opens a quoted value at the start of a cell, so a stray quote
+// inside an unquoted cell does not swallow the rows after it.
+class QDbfCsvChunkReader
+{
+public:
+    QDbfCsvChunkReader(QIODevice *device, char delimiter) :
+        m_device(device),
+        m_delimiter(delimiter),
+        m_line(1),
+        m_bomChecked(false),
+        m_atEnd(false)
+    {
+    }
+
+    bool next(QByteArray *chunk, int *firstLine)
+    {
+        // a UTF-8 byte order mark is not part of the first cell
+        if (!m_bomChecked) {
+            m_bomChecked = true;
+            while (m_pending.size() < UTF8_BOM_LENGTH && !m_atEnd) {
+                readMore();
+            }
+            if (m_pending.startsWith(UTF8_BOM)) {
+                m_pending.remove(0, UTF8_BOM_LENGTH);
+            }
+        }
+
+        int boundary = 0;
+        int boundaryLines = 0;
+        int lines = 0;
+        int scanned = 0;
+        bool cellStart = true;
+        bool quoted = false;
+        bool closed = false;
+
+        for (;;) {
+            for (; scanned < m_pending.size(); ++scanned) {
+                const char c = m_pending.at(scanned);
+                if (quoted) {
+                    if (c == '"') {
+                        quoted = false;
+                        closed = true;
+                    } else if (c == '\n') {
+                        ++lines;
+                    }
+                    continue;
+                }
+
+                // a doubled quote continues the quoted value
+                if (closed && c == '"') {
+                    quoted = true;
+                    closed = false;
+                    continue;
+                }
+                closed = false;
+
+                if (cellStart && c == '"') {
+                    quoted = true;
+                    cellStart = false;
+                } else if (c == '\n') {
+                    ++lines;
+                    boundary = scanned + 1;
+                    boundaryLines = lines;
+                    cellStart = true;
+                } else {
+                    cellStart = c == m_delimiter;
+                }
+            }
+
+            if (m_atEnd || (boundary > 0 && m_pending.size() >= IMPORT_CHUNK_SIZE)) {
+                break;
+            }
+
+            readMore();
+        }
+
+        // the last row may lack its line break
+        if (m_atEnd) {
+            boundary = m_pending.size();
+            boundaryLines = lines;
+        }
+
+        if (boundary == 0) {
+            return false;
+        }
+
+        *chunk = m_pending.left(boundary);
+        *firstLine = m_line;
+        m_pending.remove(0, boundary);
+        m_line += boundaryLines;
+
+        return true;
+    }
+
+private:
+    void readMore()
+    {
+        const QByteArray data = m_device->read(IMPORT_CHUNK_SIZE);
+        if (data.isEmpty()) {
+            m_atEnd = true;
+        } else {
+            m_pending.append(data);
+        }
+    }
+
+    QIODevice *m_device;
+    char m_delimiter;
+    QByteArray m_pending;
+    int m_line;
+    bool m_bomChecked;
+    bool m_atEnd;
+};
+
+class QDbfImporterPrivate
+{
+public:
+    QDbfImporterPrivate();
+
+    bool setColumns(const QDbfTablePrivate *table, const QVector<QByteArray> &header);
+    bool convertRow(const QVector<QByteArray> &cells, char *record,
+                    QDbfImportRowError *error) const;
+    bool convertValue(const QDbfImportColumn &column, const QByteArray &cell, char *out,
+                      QString *message) const;
+    bool writeBatch(QDbfTablePrivate *table, QByteArray *batch, int *count);
+
+    QDbfTable::DbfTableError m_error;
+    QStringList m_fieldNames;
+    char m_delimiter;
+    bool m_headerEnabled;
+    int m_threadCount;
+    int m_batchSize;
+    int m_recordsCount;
+    int m_rejectedCount;
+    int m_recordLength;
+    const QDbfCodec *m_codec;
+    QVector<QDbfImportColumn> m_columns;
+};
+
+class QDbfImportTask : public QRunnable
+{
+public:
+    QDbfImportTask(const QDbfImporterPrivate *importer, const QByteArray &input, int firstLine) :
+        m_count(0),
+        m_importer(importer),
+        m_input(input),
+        m_firstLine(firstLine)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        const char *p = m_input.constData();
+        const char *end = p + m_input.size();
+        const int recordLength = m_importer->m_recordLength;
+        int line = m_firstLine;
+        QVector<QByteArray> cells;
+
+        while (p < end) {
+            // blank lines hold no row
+            if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+                p += *p == '\r' ? 2 : 1;
+                ++line;
+                continue;
+            }
+
+            const int rowLine = line;
+            int lines = 0;
+            const bool wellFormed = parseCsvRow(&p, end, m_importer->m_delimiter, &cells, &lines);
+            line += lines;
+
+            QDbfImportRowError error;
+            error.line = rowLine;
+            if (!wellFormed) {
+                error.message = QString::fromLatin1("malformed quoted value");
+                m_errors.append(error);
+                continue;
+            }
+
+            const int offset = m_records.size();
+            m_records.resize(offset + recordLength);
+            if (!m_importer->convertRow(cells, m_records.data() + offset, &error)) {
+                m_records.resize(offset);
+                m_errors.append(error);
+                continue;
+            }
+            ++m_count;
+        }
+    }
+
+    QByteArray m_records;
+    int m_count;
+    QVector<QDbfImportRowError> m_errors;
+
+private:
+    const QDbfImporterPrivate *m_importer;
+    QByteArray m_input;
+    int m_firstLine;
+};
+
+QDbfImporterPrivate::QDbfImporterPrivate() :
+    m_error(QDbfTable::NoError),
+    m_delimiter(','),
+    m_headerEnabled(true),
+    m_threadCount(0),
+    m_batchSize(DEFAULT_IMPORT_BATCH_SIZE),
+    m_recordsCount(0),
+    m_rejectedCount(0),
+    m_recordLength(0),
+    m_codec(0)
+{
+}
+
+bool QDbfImporterPrivate::setColumns(const QDbfTablePrivate *table,
+                                     const QVector<QByteArray> &header)
+{
+    // records are built whole, a projection does not hide any field
+    QStringList names = m_fieldNames;
+    if (names.isEmpty()) {
+        if (m_headerEnabled) {
+            for (int i = 0; i < header.size(); ++i) {
+                names.append(QString::fromUtf8(header.at(i).constData(),
+                                               header.at(i).size()).trimmed());
+            }
+        } else {
+            for (int i = 0; i < table->m_tableRecord.count(); ++i) {
+                names.append(table->m_tableRecord.fieldName(i));
+            }
+        }
+    }
+
+    m_columns.clear();
+    m_columns.reserve(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        const int index = table->m_tableRecord.indexOf(names.at(i));
+        if (index < 0) {
+            qWarning("QDbfImporter::importTable(): unknown field %s", qPrintable(names.at(i)));
+            return false;
+        }
+
+        const QDbfField field = table->m_tableRecord.field(index);
+        QDbfImportColumn column;
+        column.type = field.dbfType();
+        column.offset = field.offset();
+        column.length = field.length();
+        column.precision = field.precision();
+        column.name = field.name();
+        m_columns.append(column);
+    }
+
+    m_recordLength = table->m_recordLength;
+    m_codec = table->m_codec;
+
+    return true;
+}
+
+bool QDbfImporterPrivate::convertRow(const QVector<QByteArray> &cells, char *record,
+                                     QDbfImportRowError *error) const
+{
+    memset(record, ' ', m_recordLength);
+
+    if (cells.size() != m_columns.size()) {
+        error->message = QString::fromLatin1("expected %1 values, found %2")
+                .arg(m_columns.size()).arg(cells.size());
+        return false;
+    }
+
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const QDbfImportColumn &column = m_columns.at(i);
+        if (!convertValue(column, cells.at(i), record + column.offset, &error->message)) {
+            error->fieldName = column.name;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool QDbfImporterPrivate::convertValue(const QDbfImportColumn &column, const QByteArray &cell,
+                                       char *out, QString *message) const
+{
+    const QByteArray value = column.type == QDbfField::Character ? cell : cell.trimmed();
+
+    switch (column.type) {
+    case QDbfField::Character: {
+        // the field is blank padded, trailing blanks of the value are dropped
+        int size = value.size();
+        while (size > 0 && value.at(size - 1) == ' ') {
+            --size;
+        }
+        const QString text = QString::fromUtf8(value.constData(), size);
+        const bool fits = m_codec->isSingleByte() ? text.length() <= column.length :
+                                                    m_codec->fromUnicode(text).size() <= column.length;
+        if (!fits) {
+            *message = QString::fromLatin1("value is longer than %1 characters").arg(column.length);
+            return false;
+        }
+        m_codec->fromUnicode(text.constData(), text.length(), out, column.length);
+        return true; }
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint: {
+        if (value.isEmpty()) {
+            return true;
+        }
+        double number = 0.0;
+        if (parseNumber(value.constData(), value.size(), &number) != NumberValid) {
+            *message = QString::fromLatin1("value is not a number");
+            return false;
+        }
+        if (!formatNumber(number, column.precision, out, column.length)) {
+            *message = QString::fromLatin1("value does not fit into %1 digits").arg(column.length);
+            return false;
+        }
+        return true; }
+    case QDbfField::Date: {
+        if (value.isEmpty()) {
+            return true;
+        }
+        // YYYY-MM-DD as written by QDbfExporter, or YYYYMMDD
+        int year = -1;
+        int month = -1;
+        int day = -1;
+        const char *data = value.constData();
+        if (value.size() == 10 && data[4] == '-' && data[7] == '-') {
+            year = parseDigits(data, 4);
+            month = parseDigits(data + 5, 2);
+            day = parseDigits(data + 8, 2);
+        } else if (value.size() == DATE_LENGTH) {
+            year = parseDigits(data, 4);
+            month = parseDigits(data + 4, 2);
+            day = parseDigits(data + 6, 2);
+        }
+        if (year <= 0 || month <= 0 || day <= 0 || !QDate(year, month, day).isValid() ||
+            column.length < DATE_LENGTH) {
+            *message = QString::fromLatin1("value is not a date");
+            return false;
+        }
+        formatDigits(year, out, 4);
+        formatDigits(month, out + 4, 2);
+        formatDigits(day, out + 6, 2);
+        return true; }
+    case QDbfField::Logical: {
+        if (column.length < 1) {
+            return true;
+        }
+        // blanks and '?' are unknown values
+        const QByteArray word = value.toLower();
+        if (word.isEmpty() || word == "?") {
+            return true;
+        }
+        if (word == "t" || word == "y" || word == "true" || word == "yes" || word == "1") {
+            out[0] = 'T';
+            return true;
+        }
+        if (word == "f" || word == "n" || word == "false" || word == "no" || word == "0") {
+            out[0] = 'F';
+            return true;
+        }
+        *message = QString::fromLatin1("value is not a logical");
+        return false; }
+    default:
+        if (value.isEmpty()) {
+            return true;
+        }
+        *message = QString::fromLatin1("field type can not be loaded");
+        return false;
+    }
+}
+
+bool QDbfImporterPrivate::writeBatch(QDbfTablePrivate *table, QByteArray *batch, int *count)
+{
+    if (*count == 0) {
+        return true;
+    }
+
+    batch->append(END_OF_FILE_MARK);
+    const bool result = table->writeRecords(*batch, *count, false);
+    if (result) {
+        m_recordsCount += *count;
+    } else {
+        m_error = table->m_error;
+    }
+
+    batch->resize(0);
+    *count = 0;
+
+    return result;
+}
+
+} // namespace Internal
+
+QDbfImportErrorHandler::~QDbfImportErrorHandler()
+{
+}
+
+QDbfImporter::QDbfImporter() :
+    d(new Internal::QDbfImporterPrivate())
+{
+}
+
+QDbfImporter::~QDbfImporter()
+{
+    delete d;
+}
+
+void QDbfImporter::setFieldNames(const QStringList &fieldNames)
+{
+    d->m_fieldNames = fieldNames;
+}
+
+QStringList QDbfImporter::fieldNames() const
+{
+    return d->m_fieldNames;
+}
+
+void QDbfImporter::setDelimiter(char delimiter)
+{
+    d->m_delimiter = delimiter;
+}
+
+char QDbfImporter::delimiter() const
+{
+    return d->m_delimiter;
+}
+
+void QDbfImporter::setHeaderEnabled(bool enabled)
+{
+    d->m_headerEnabled = enabled;
+}
+
+bool QDbfImporter::isHeaderEnabled() const
+{
+    return d->m_headerEnabled;
+}
+
+void QDbfImporter::setThreadCount(int threadCount)
+{
+    d->m_threadCount = threadCount;
+}
+
+int QDbfImporter::threadCount() const
+{
+    return d->m_threadCount;
+}
+
+void QDbfImporter::setBatchSize(int size)
+{
+    d->m_batchSize = qMax(1, size);
+}
+
+int QDbfImporter::batchSize() const
+{
+    return d->m_batchSize;
+}
+
+bool QDbfImporter::importTable(QDbfTable &table, QIODevice *device,
+                               QDbfImportErrorHandler *handler)
+{
+    d->m_recordsCount = 0;
+    d->m_rejectedCount = 0;
+
+    Internal::QDbfTablePrivate *tableData = table.d;
+    if (!tableData->isOpen()) {
+        qWarning("QDbfImporter::importTable(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!tableData->m_file.isWritable()) {
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (!device || !device->isReadable()) {
+        qWarning("QDbfImporter::importTable(): input device is not readable");
+        d->m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    Internal::QDbfCsvChunkReader reader(device, d->m_delimiter);
+    QByteArray chunk;
+    int firstLine = 1;
+    bool atEnd = !reader.next(&chunk, &firstLine);
+
+    // the header row is taken off the first chunk
+    QVector<QByteArray> header;
+    if (d->m_headerEnabled && !atEnd) {
+        const char *data = chunk.constData();
+        int lines = 0;
+        Internal::parseCsvRow(&data, data + chunk.size(), d->m_delimiter, &header, &lines);
+        chunk.remove(0, static_cast<int>(data - chunk.constData()));
+        firstLine += lines;
+    }
+
+    if (!d->setColumns(tableData, header)) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    int threadCount = d->m_threadCount > 0 ? d->m_threadCount : QThread::idealThreadCount();
+    threadCount = qMax(1, threadCount);
+    const int roundSize = threadCount * Internal::IMPORT_CHUNKS_PER_THREAD;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QByteArray batch;
+    batch.reserve((d->m_batchSize + 1) * d->m_recordLength);
+    int batchCount = 0;
+    const int recordsCount = tableData->m_recordsCount;
+
+    // chunks are parsed a round at a time, the calling thread reads the next
+    // round and writes the previous one while the pool works
+    QVector<Internal::QDbfImportTask *> running;
+    for (;;) {
+        QVector<Internal::QDbfImportTask *> next;
+        while (!atEnd && next.size() < roundSize) {
+            next.append(new Internal::QDbfImportTask(d, chunk, firstLine));
+            atEnd = !reader.next(&chunk, &firstLine);
+        }
+
+        pool.waitForDone();
+        for (int i = 0; i < next.size(); ++i) {
+            pool.start(next.at(i));
+        }
+
+        for (int i = 0; i < running.size() && d->m_error == QDbfTable::NoError; ++i) {
+            const Internal::QDbfImportTask *task = running.at(i);
+            for (int j = 0; j < task->m_errors.size(); ++j) {
+                const Internal::QDbfImportRowError &error = task->m_errors.at(j);
+                if (handler) {
+                    handler->rowError(error.line, error.fieldName, error.message);
+                }
+            }
+            d->m_rejectedCount += task->m_errors.size();
+
+            batch.append(task->m_records);
+            batchCount += task->m_count;
+            if (batchCount >= d->m_batchSize) {
+                d->writeBatch(tableData, &batch, &batchCount);
+            }
+        }
+        qDeleteAll(running);
+        running = next;
+
+        if (running.isEmpty() || d->m_error != QDbfTable::NoError) {
+            break;
+        }
+    }
+
+    pool.waitForDone();
+    qDeleteAll(running);
+
+    if (d->m_error == QDbfTable::NoError) {
+        d->writeBatch(tableData, &batch, &batchCount);
+    }
+
+    // one header update covers every batch, even when a later one failed
+    if (tableData->m_recordsCount != recordsCount &&
+        !tableData->writeRecordsCount(tableData->m_recordsCount) &&
+        d->m_error == QDbfTable::NoError) {
+        d->m_error = tableData->m_error;
+    }
+
+    return d->m_error == QDbfTable::NoError;
+}
+
+bool QDbfImporter::importTable(QDbfTable &table, const QString &fileName,
+                               QDbfImportErrorHandler *handler)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("QDbfImporter::importTable(): unable to open file %s", qPrintable(fileName));
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    return importTable(table, &file, handler);
+}
+
+QDbfTable::DbfTableError QDbfImporter::error() const
+{
+    return d->m_error;
+}
+
+int QDbfImporter::recordsCount() const
+{
+    return d->m_recordsCount;
+}
+
+int QDbfImporter::rejectedCount() const
+{
+    return d->m_rejectedCount;
+}
+
+} // namespace QDbf
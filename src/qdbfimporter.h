@@ -0,0 +1,74 @@
+#ifndef QDBFIMPORTER_H
+#define QDBFIMPORTER_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QString;
+class QStringList;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfImporterPrivate;
+} // namespace Internal
+
+// Receives the rows QDbfImporter could not load, in input order. line is the
+// 1-based line the row starts on, fieldName is empty when the row as a whole
+// is malformed. The row is skipped and the load goes on.
+class QDBF_EXPORT QDbfImportErrorHandler
+{
+public:
+    virtual ~QDbfImportErrorHandler();
+    virtual void rowError(int line, const QString &fieldName, const QString &message) = 0;
+};
+
+// Appends the rows of a UTF-8 CSV (RFC 4180) file to a table. The input is
+// cut into chunks at row boundaries, worker threads parse the chunks and
+// convert every value straight into the field bytes of the table schema,
+// and the records are written in input order in large batches. The records
+// count in the header is written once, at the end of the load.
+class QDBF_EXPORT QDbfImporter
+{
+public:
+    QDbfImporter();
+    ~QDbfImporter();
+
+    // fields of the table record the CSV columns go to, in column order;
+    // when empty the header row names them, or without a header row the
+    // columns follow the table fields
+    void setFieldNames(const QStringList &fieldNames);
+    QStringList fieldNames() const;
+
+    void setDelimiter(char delimiter);
+    char delimiter() const;
+
+    void setHeaderEnabled(bool enabled);
+    bool isHeaderEnabled() const;
+
+    void setThreadCount(int threadCount);
+    int threadCount() const;
+
+    void setBatchSize(int size);
+    int batchSize() const;
+
+    bool importTable(QDbfTable &table, QIODevice *device,
+                     QDbfImportErrorHandler *handler = 0);
+    bool importTable(QDbfTable &table, const QString &fileName,
+                     QDbfImportErrorHandler *handler = 0);
+
+    QDbfTable::DbfTableError error() const;
+    int recordsCount() const;
+    int rejectedCount() const;
+
+private:
+    Q_DISABLE_COPY(QDbfImporter)
+
+    Internal::QDbfImporterPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFIMPORTER_H
@@ -0,0 +1,1076 @@
+#include "qdbfindex_p.h"
+
+#include "qdbfcdxindex_p.h"
+#include "qdbfcodec_p.h"
+#include "qdbfmdxindex_p.h"
+#include "qdbfndxindex_p.h"
+#include "qdbfrecord.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QFileInfo>
+#include <QVariant>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+// deeper trees only come from corrupted (cyclic) node pointers
+const int MAX_TREE_DEPTH = 64;
+
+class QDbfIndexFile::KeyLess
+{
+public:
+    explicit KeyLess(const QDbfIndexFile *index) : m_index(index) {}
+
+    bool operator()(const QDbfIndexKey &left, const QDbfIndexKey &right) const
+    {
+        const int result = m_index->order(left.key.constData(), right.key.constData(),
+                                          m_index->m_keyLength);
+        return result < 0 || (result == 0 && left.record < right.record);
+    }
+
+private:
+    const QDbfIndexFile *m_index;
+};
+
+QDbfIndexFile::QDbfIndexFile(const QDbfCodec *codec) :
+    m_codec(codec),
+    m_keyLength(0),
+    m_unique(false),
+    m_descending(false),
+    m_keyKind(UnknownKeys),
+    m_hasKeyExpression(false)
+{
+}
+
+QDbfIndexFile::~QDbfIndexFile()
+{
+}
+
+QDbfIndexFile *QDbfIndexFile::open(const QString &fileName, const QString &tagName,
+                                   const QDbfCodec *codec, const QDbfRecord &record,
+                                   bool writable)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+
+    QDbfIndexFile *index = 0;
+    if (suffix == QLatin1String("ndx")) {
+        index = new QDbfNdxIndex(codec);
+    } else if (suffix == QLatin1String("mdx")) {
+        index = new QDbfMdxIndex(codec);
+    } else if (suffix == QLatin1String("cdx")) {
+        index = new QDbfCdxIndex(codec);
+    } else {
+        qWarning("QDbfIndexFile::open(): unsupported index format %s", qPrintable(fileName));
+        return 0;
+    }
+
+    index->m_file.setFileName(fileName);
+    if (!index->m_file.open(writable ? QIODevice::ReadWrite : QIODevice::ReadOnly) ||
+        !index->load(tagName) ||
+        index->m_keyLength <= 0) {
+        delete index;
+        return 0;
+    }
+
+    if (index->m_keyKind == UnknownKeys) {
+        index->inferKeyKind(record);
+    }
+
+    return index;
+}
+
+void QDbfIndexFile::inferKeyKind(const QDbfRecord &record)
+{
+    QDbfIndexExpression::ResultType type;
+    if (QDbfIndexExpression::inferResultType(m_expression, record, &type)) {
+        switch (type) {
+        case QDbfIndexExpression::CharacterResult:
+            m_keyKind = CharacterKeys;
+            break;
+        case QDbfIndexExpression::NumericResult:
+            m_keyKind = NumericKeys;
+            break;
+        case QDbfIndexExpression::DateResult:
+            m_keyKind = DateKeys;
+            break;
+        }
+    }
+
+    // binary keys always have the length of their encoding
+    if ((m_keyKind == NumericKeys && encodeNumber(0.0).size() != m_keyLength) ||
+        (m_keyKind == DateKeys && encodeDate(QDate(2000, 1, 1)).size() != m_keyLength)) {
+        m_keyKind = UnknownKeys;
+    }
+
+    if (m_keyKind == UnknownKeys) {
+        qWarning("QDbfIndexFile::open(): key type of expression %s in %s is unknown, "
+                 "keys cannot be searched", qPrintable(m_expression), qPrintable(fileName()));
+    }
+}
+
+QString QDbfIndexFile::fileName() const
+{
+    return m_file.fileName();
+}
+
+QString QDbfIndexFile::tagName() const
+{
+    return m_tagName;
+}
+
+QString QDbfIndexFile::keyExpression() const
+{
+    return m_expression;
+}
+
+int QDbfIndexFile::keyLength() const
+{
+    return m_keyLength;
+}
+
+bool QDbfIndexFile::isUnique() const
+{
+    return m_unique;
+}
+
+bool QDbfIndexFile::isDescending() const
+{
+    return m_descending;
+}
+
+bool QDbfIndexFile::isWritable() const
+{
+    return m_file.isWritable();
+}
+
+QByteArray QDbfIndexFile::encodeKey(const QVariant &value) const
+{
+    if (m_keyKind == UnknownKeys) {
+        qWarning("QDbfIndexFile::encodeKey(): key type of %s is unknown", qPrintable(fileName()));
+        return QByteArray();
+    }
+
+    switch (value.type()) {
+    case QVariant::Date:
+        return encodeDate(value.toDate());
+    case QVariant::Double:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        return encodeNumber(value.toDouble());
+    case QVariant::ByteArray:
+        return value.toByteArray().left(m_keyLength);
+    default:
+        break;
+    }
+
+    // character keys match as prefixes, so the search key is not padded
+    return m_codec->fromUnicode(value.toString()).left(m_keyLength);
+}
+
+bool QDbfIndexFile::compileExpression(const QDbfRecord &record)
+{
+    // the expression has to produce the keys the index already holds
+    m_hasKeyExpression = m_keyExpression.compile(m_expression, record, m_codec);
+    if (!m_hasKeyExpression) {
+        return false;
+    }
+
+    switch (m_keyExpression.resultType()) {
+    case QDbfIndexExpression::NumericResult:
+        m_hasKeyExpression = encodeNumber(0.0).size() == m_keyLength;
+        break;
+    case QDbfIndexExpression::DateResult:
+        m_hasKeyExpression = encodeDate(QDate(2000, 1, 1)).size() == m_keyLength;
+        break;
+    case QDbfIndexExpression::CharacterResult:
+        m_hasKeyExpression = m_keyKind == CharacterKeys;
+        break;
+    }
+
+    return m_hasKeyExpression;
+}
+
+bool QDbfIndexFile::hasExpression() const
+{
+    return m_hasKeyExpression;
+}
+
+QByteArray QDbfIndexFile::recordKey(const char *record) const
+{
+    if (!m_hasKeyExpression) {
+        return QByteArray();
+    }
+
+    switch (m_keyExpression.resultType()) {
+    case QDbfIndexExpression::NumericResult:
+        return encodeNumber(m_keyExpression.evaluateNumber(record));
+    case QDbfIndexExpression::DateResult: {
+        const QDate date = m_keyExpression.evaluateDate(record);
+        return date.isValid() ? encodeDate(date) : QByteArray(m_keyLength, '\0');
+    }
+    case QDbfIndexExpression::CharacterResult:
+        break;
+    }
+
+    // longer expressions are cut, shorter ones padded to the key length
+    QByteArray key(qMax(m_keyLength, m_keyExpression.length()), ' ');
+    m_keyExpression.evaluate(record, key.data());
+    key.resize(m_keyLength);
+    return key;
+}
+
+bool QDbfIndexFile::insertKeys(QVector<QDbfIndexKey> keys)
+{
+    if (!isWritable()) {
+        return false;
+    }
+
+    // neighbouring keys land in the same leaves, so every node is written once
+    sortKeys(&keys);
+
+    for (int i = 0; i < keys.size(); ++i) {
+        if (!insertEntry(keys.at(i))) {
+            m_dirtyNodes.clear();
+            return false;
+        }
+    }
+
+    return flush();
+}
+
+bool QDbfIndexFile::removeKey(const QByteArray &key, quint32 record)
+{
+    if (!isWritable()) {
+        return false;
+    }
+
+    if (!removeEntry(key, record)) {
+        m_dirtyNodes.clear();
+        return false;
+    }
+
+    return flush();
+}
+
+bool QDbfIndexFile::rebuild(QVector<QDbfIndexKey> keys)
+{
+    if (!isWritable()) {
+        return false;
+    }
+
+    m_path.clear();
+    m_dirtyNodes.clear();
+
+    sortKeys(&keys);
+
+    if (!resetNodes()) {
+        return false;
+    }
+
+    // leaves are filled up in key order, then every level is built on the
+    // one below until a single root remains
+    QVector<QDbfIndexNode> level;
+    QVector<QDbfIndexKey> highest;
+    QDbfIndexNode node;
+    for (int i = 0; i < keys.size(); ++i) {
+        const QDbfIndexKey &entry = keys.at(i);
+        if (entry.key.size() != m_keyLength) {
+            return false;
+        }
+
+        if (m_unique && i > 0 &&
+            order(keys.at(i - 1).key.constData(), entry.key.constData(), m_keyLength) == 0) {
+            continue;
+        }
+
+        node.keys.append(entry.key);
+        node.pointers.append(entry.record);
+        ++node.count;
+
+        if (node.count > 1 && nodeLoad(node) > nodeSize()) {
+            --node.count;
+            node.keys.resize(node.count * m_keyLength);
+            node.pointers.removeLast();
+            level.append(node);
+            highest.append(QDbfIndexKey());
+            lastKey(node, &highest.last().key, &highest.last().record);
+
+            node = QDbfIndexNode();
+            node.keys = entry.key;
+            node.pointers.append(entry.record);
+            node.count = 1;
+        }
+    }
+    level.append(node);
+    highest.append(QDbfIndexKey());
+    lastKey(node, &highest.last().key, &highest.last().record);
+
+    for (;;) {
+        if (!storeLevel(&level)) {
+            return false;
+        }
+
+        if (level.size() == 1) {
+            break;
+        }
+
+        QVector<QDbfIndexNode> parents;
+        if (!buildLevel(level, &highest, &parents)) {
+            return false;
+        }
+        level = parents;
+    }
+
+    return writeHeader() && m_file.flush();
+}
+
+bool QDbfIndexFile::first()
+{
+    m_path.clear();
+    return descend(&m_path, rootNode(), 0) && settle(&m_path) && checkUpperBound();
+}
+
+bool QDbfIndexFile::seek(const QByteArray &key)
+{
+    m_path.clear();
+    return descend(&m_path, rootNode(), &key) && settle(&m_path) && checkUpperBound();
+}
+
+bool QDbfIndexFile::next()
+{
+    if (m_path.isEmpty()) {
+        return false;
+    }
+
+    ++m_path.last().index;
+
+    return settle(&m_path) && checkUpperBound();
+}
+
+void QDbfIndexFile::setUpperBound(const QByteArray &key)
+{
+    m_upperBound = key;
+}
+
+bool QDbfIndexFile::atEnd() const
+{
+    return m_path.isEmpty();
+}
+
+int QDbfIndexFile::recordIndex() const
+{
+    if (m_path.isEmpty()) {
+        return -1;
+    }
+
+    const Position &position = m_path.last();
+    return static_cast<int>(position.node.pointers.at(position.index)) - 1;
+}
+
+const char *QDbfIndexFile::key() const
+{
+    if (m_path.isEmpty()) {
+        return 0;
+    }
+
+    const Position &position = m_path.last();
+    return position.node.key(position.index, m_keyLength);
+}
+
+int QDbfIndexFile::compareKeys(const char *key, const char *searchKey, int searchLength) const
+{
+    return memcmp(key, searchKey, qMin(searchLength, m_keyLength));
+}
+
+bool QDbfIndexFile::hasRightmostPointer() const
+{
+    return true;
+}
+
+bool QDbfIndexFile::hasSiblingLinks() const
+{
+    return false;
+}
+
+bool QDbfIndexFile::resetNodes()
+{
+    return true;
+}
+
+bool QDbfIndexFile::readBlock(qint64 offset, char *data, int length)
+{
+    return m_file.seek(offset) && m_file.read(data, length) == length;
+}
+
+bool QDbfIndexFile::writeBlock(qint64 offset, const char *data, int length)
+{
+    return m_file.seek(offset) && m_file.write(data, length) == length;
+}
+
+QString QDbfIndexFile::headerString(const char *data, int maxLength)
+{
+    int length = 0;
+    while (length < maxLength && data[length] != '\0') {
+        ++length;
+    }
+
+    return QString::fromLatin1(data, length).trimmed();
+}
+
+QByteArray QDbfIndexFile::doubleKey(double value)
+{
+    QByteArray key(sizeof(double), '\0');
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, reinterpret_cast<uchar *>(key.data()));
+    return key;
+}
+
+double QDbfIndexFile::keyDouble(const char *key)
+{
+    const quint64 bits = qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(key));
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int QDbfIndexFile::order(const char *key, const char *searchKey, int searchLength) const
+{
+    const int result = compareKeys(key, searchKey, searchLength);
+    return m_descending ? -result : result;
+}
+
+int QDbfIndexFile::lowerBound(const QDbfIndexNode &node, const QByteArray &searchKey) const
+{
+    // the first key not ordered before the search key
+    int low = 0;
+    int high = node.count;
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (order(node.key(middle, m_keyLength), searchKey.constData(), searchKey.size()) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+bool QDbfIndexFile::descend(QVector<Position> *path, quint32 address, const QByteArray *searchKey)
+{
+    for (;;) {
+        if (path->size() >= MAX_TREE_DEPTH) {
+            qWarning("QDbfIndexFile: index tree of %s is corrupted", qPrintable(fileName()));
+            path->clear();
+            return false;
+        }
+
+        Position position;
+        if (!loadNode(address, &position.node)) {
+            path->clear();
+            return false;
+        }
+
+        const QDbfIndexNode &node = position.node;
+        const int index = searchKey ? lowerBound(node, *searchKey) : 0;
+
+        if (node.leaf) {
+            position.index = index;
+            path->append(position);
+            return true;
+        }
+
+        if (index >= node.pointers.size()) {
+            // every key below this node is ordered before the search key
+            position.index = node.pointers.size();
+            path->append(position);
+            return true;
+        }
+
+        position.index = index;
+        path->append(position);
+        address = node.pointers.at(index);
+    }
+}
+
+bool QDbfIndexFile::settle(QVector<Position> *path)
+{
+    // climb out of exhausted nodes and walk down the leftmost path of the
+    // next subtree until a leaf entry is found
+    while (!path->isEmpty()) {
+        Position &position = path->last();
+        if (position.node.leaf) {
+            if (position.index < position.node.count) {
+                break;
+            }
+            path->removeLast();
+            if (!path->isEmpty()) {
+                ++path->last().index;
+            }
+            continue;
+        }
+
+        if (position.index >= position.node.pointers.size()) {
+            path->removeLast();
+            if (!path->isEmpty()) {
+                ++path->last().index;
+            }
+            continue;
+        }
+
+        if (!descend(path, position.node.pointers.at(position.index), 0)) {
+            return false;
+        }
+    }
+
+    return !path->isEmpty();
+}
+
+bool QDbfIndexFile::checkUpperBound()
+{
+    if (!m_upperBound.isEmpty() && order(key(), m_upperBound.constData(), m_upperBound.size()) > 0) {
+        m_path.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void QDbfIndexFile::sortKeys(QVector<QDbfIndexKey> *keys) const
+{
+    std::stable_sort(keys->begin(), keys->end(), KeyLess(this));
+}
+
+bool QDbfIndexFile::loadNode(quint32 address, QDbfIndexNode *node)
+{
+    const QHash<quint32, QDbfIndexNode>::const_iterator it = m_dirtyNodes.constFind(address);
+    if (it != m_dirtyNodes.constEnd()) {
+        *node = it.value();
+        return true;
+    }
+
+    if (!readNode(address, node)) {
+        return false;
+    }
+
+    if (node->leaf) {
+        node->keyRecords.clear();
+    } else if (node->keyRecords.size() != node->count) {
+        node->keyRecords.fill(0, node->count);
+    }
+
+    return true;
+}
+
+void QDbfIndexFile::storeNode(const QDbfIndexNode &node)
+{
+    m_dirtyNodes.insert(node.address, node);
+}
+
+bool QDbfIndexFile::flush()
+{
+    QHash<quint32, QDbfIndexNode>::const_iterator it = m_dirtyNodes.constBegin();
+    for (; it != m_dirtyNodes.constEnd(); ++it) {
+        if (!writeNode(it.value())) {
+            m_dirtyNodes.clear();
+            return false;
+        }
+    }
+
+    m_dirtyNodes.clear();
+
+    return writeHeader() && m_file.flush();
+}
+
+bool QDbfIndexFile::locate(const QByteArray &key, QVector<Position> *path)
+{
+    // like descend(), but keys past the last separator go to the last child
+    path->clear();
+
+    quint32 address = rootNode();
+    for (;;) {
+        if (path->size() >= MAX_TREE_DEPTH) {
+            qWarning("QDbfIndexFile: index tree of %s is corrupted", qPrintable(fileName()));
+            return false;
+        }
+
+        Position position;
+        if (!loadNode(address, &position.node)) {
+            return false;
+        }
+
+        position.index = lowerBound(position.node, key);
+        if (position.node.leaf) {
+            path->append(position);
+            return true;
+        }
+
+        if (position.node.pointers.isEmpty()) {
+            return false;
+        }
+
+        position.index = qMin(position.index, position.node.pointers.size() - 1);
+        path->append(position);
+        address = position.node.pointers.at(position.index);
+    }
+}
+
+bool QDbfIndexFile::insertEntry(const QDbfIndexKey &entry)
+{
+    if (entry.key.size() != m_keyLength) {
+        return false;
+    }
+
+    m_path.clear();
+
+    QVector<Position> path;
+    if (!locate(entry.key, &path)) {
+        return false;
+    }
+
+    Position &position = path.last();
+    QDbfIndexNode &node = position.node;
+
+    // a unique index keeps the first record of every key
+    if (m_unique && position.index < node.count &&
+        order(node.key(position.index, m_keyLength), entry.key.constData(), m_keyLength) == 0) {
+        return true;
+    }
+
+    node.keys.insert(position.index * m_keyLength, entry.key);
+    node.pointers.insert(position.index, entry.record);
+    ++node.count;
+
+    return updatePath(&path);
+}
+
+bool QDbfIndexFile::removeEntry(const QByteArray &key, quint32 record)
+{
+    if (key.size() != m_keyLength) {
+        return false;
+    }
+
+    m_path.clear();
+
+    QVector<Position> path;
+    if (!locate(key, &path)) {
+        return false;
+    }
+
+    // equal keys may continue in the following leaves
+    for (;;) {
+        Position &position = path.last();
+        if (position.index >= position.node.count) {
+            ++position.index;
+            if (!settle(&path)) {
+                return true;
+            }
+            continue;
+        }
+
+        if (order(position.node.key(position.index, m_keyLength), key.constData(), m_keyLength) != 0) {
+            return true;
+        }
+
+        if (position.node.pointers.at(position.index) == record) {
+            break;
+        }
+
+        ++position.index;
+    }
+
+    Position &position = path.last();
+    QDbfIndexNode &node = position.node;
+    node.keys.remove(position.index * m_keyLength, m_keyLength);
+    node.pointers.remove(position.index);
+    --node.count;
+
+    return updatePath(&path);
+}
+
+bool QDbfIndexFile::updatePath(QVector<Position> *path)
+{
+    // fix the modified leaf, then every ancestor whose entries changed
+    for (int level = path->size() - 1; level > 0; --level) {
+        QDbfIndexNode &node = (*path)[level].node;
+        Position &parent = (*path)[level - 1];
+
+        if (node.pointers.isEmpty()) {
+            if (!unlinkNode(node)) {
+                return false;
+            }
+            removeChild(&parent.node, parent.index);
+            continue;
+        }
+
+        if (nodeLoad(node) > nodeSize()) {
+            if (!splitNode(&node, &parent.node, parent.index)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (nodeLoad(node) * 3 < nodeSize()) {
+            bool merged = false;
+            if (!mergeNode(&node, &parent.node, parent.index, &merged)) {
+                return false;
+            }
+            if (merged) {
+                continue;
+            }
+        }
+
+        storeNode(node);
+
+        if (!updateSeparator(node, &parent.node, parent.index)) {
+            return true;
+        }
+    }
+
+    return updateRoot(&path->first().node);
+}
+
+bool QDbfIndexFile::updateRoot(QDbfIndexNode *root)
+{
+    if (nodeLoad(*root) > nodeSize()) {
+        // the tree grows by one level
+        QDbfIndexNode top;
+        top.address = allocateNode();
+        top.leaf = false;
+        top.pointers.append(root->address);
+        if (top.address == 0) {
+            return false;
+        }
+
+        if (!hasRightmostPointer()) {
+            QByteArray key;
+            quint32 record;
+            lastKey(*root, &key, &record);
+            top.keys = key;
+            top.keyRecords.append(record);
+            top.count = 1;
+        }
+
+        if (!splitNode(root, &top, 0)) {
+            return false;
+        }
+
+        setRootNode(top.address);
+        storeNode(top);
+        return true;
+    }
+
+    if (!root->leaf && root->pointers.isEmpty()) {
+        root->leaf = true;
+        root->count = 0;
+        root->keys.clear();
+        root->keyRecords.clear();
+    }
+
+    if (root->leaf || root->pointers.size() > 1) {
+        storeNode(*root);
+        return true;
+    }
+
+    // a root with a single child is dropped
+    QDbfIndexNode child;
+    if (!loadNode(root->pointers.first(), &child)) {
+        return false;
+    }
+
+    setRootNode(child.address);
+    storeNode(child);
+
+    return true;
+}
+
+bool QDbfIndexFile::updateSeparator(const QDbfIndexNode &node, QDbfIndexNode *parent,
+                                    int childIndex) const
+{
+    // the key of a child is its highest key, only the rightmost child of
+    // formats with a separate rightmost pointer has none
+    if (childIndex >= parent->count || node.count == 0 ||
+        (!node.leaf && hasRightmostPointer())) {
+        return false;
+    }
+
+    QByteArray key;
+    quint32 record;
+    lastKey(node, &key, &record);
+
+    char *separator = parent->keys.data() + childIndex * m_keyLength;
+    if (memcmp(separator, key.constData(), m_keyLength) == 0 &&
+        parent->keyRecords.at(childIndex) == record) {
+        return false;
+    }
+
+    memcpy(separator, key.constData(), m_keyLength);
+    parent->keyRecords[childIndex] = record;
+
+    return true;
+}
+
+bool QDbfIndexFile::splitNode(QDbfIndexNode *node, QDbfIndexNode *parent, int childIndex)
+{
+    QDbfIndexNode right;
+    right.address = allocateNode();
+    right.leaf = node->leaf;
+    if (right.address == 0) {
+        return false;
+    }
+
+    const int count = node->count;
+    const int half = count / 2;
+    QByteArray separator;
+    quint32 separatorRecord = 0;
+
+    if (node->leaf || !hasRightmostPointer()) {
+        right.count = count - half;
+        right.keys = node->keys.mid(half * m_keyLength);
+        right.pointers = node->pointers.mid(half);
+        if (!node->leaf) {
+            right.keyRecords = node->keyRecords.mid(half);
+            node->keyRecords.resize(half);
+        }
+        node->count = half;
+        node->keys.resize(half * m_keyLength);
+        node->pointers.resize(half);
+        lastKey(*node, &separator, &separatorRecord);
+    } else {
+        // the middle key moves up, its child stays the rightmost one on the left
+        separator = node->keys.mid(half * m_keyLength, m_keyLength);
+        separatorRecord = node->keyRecords.at(half);
+        right.count = count - half - 1;
+        right.keys = node->keys.mid((half + 1) * m_keyLength);
+        right.keyRecords = node->keyRecords.mid(half + 1);
+        right.pointers = node->pointers.mid(half + 1);
+        node->count = half;
+        node->keys.resize(half * m_keyLength);
+        node->keyRecords.resize(half);
+        node->pointers.resize(half + 1);
+    }
+
+    if (hasSiblingLinks()) {
+        right.leftSibling = node->address;
+        right.rightSibling = node->rightSibling;
+        if (node->rightSibling != NO_INDEX_NODE) {
+            QDbfIndexNode next;
+            if (!loadNode(node->rightSibling, &next)) {
+                return false;
+            }
+            next.leftSibling = right.address;
+            storeNode(next);
+        }
+        node->rightSibling = right.address;
+    }
+
+    storeNode(*node);
+    storeNode(right);
+
+    parent->keys.insert(childIndex * m_keyLength, separator);
+    parent->keyRecords.insert(childIndex, separatorRecord);
+    parent->pointers.insert(childIndex, node->address);
+    parent->pointers[childIndex + 1] = right.address;
+    ++parent->count;
+
+    // the right half may end with a key the parent does not know yet
+    updateSeparator(right, parent, childIndex + 1);
+
+    return true;
+}
+
+bool QDbfIndexFile::mergeNode(QDbfIndexNode *node, QDbfIndexNode *parent, int childIndex,
+                              bool *merged)
+{
+    *merged = false;
+
+    if (parent->pointers.size() < 2) {
+        return true;
+    }
+
+    // join with the right neighbour, the last child with the left one
+    const int leftIndex = childIndex + 1 < parent->pointers.size() ? childIndex : childIndex - 1;
+    QDbfIndexNode sibling;
+    if (!loadNode(parent->pointers.at(leftIndex == childIndex ? childIndex + 1 : childIndex - 1),
+                  &sibling)) {
+        return false;
+    }
+
+    const QDbfIndexNode &left = leftIndex == childIndex ? *node : sibling;
+    const QDbfIndexNode &right = leftIndex == childIndex ? sibling : *node;
+    if (left.leaf != right.leaf) {
+        return true;
+    }
+
+    QDbfIndexNode joined = left;
+    if (!joined.leaf && hasRightmostPointer()) {
+        // the separator of the parent moves down between both halves
+        joined.keys.append(parent->key(leftIndex, m_keyLength), m_keyLength);
+        joined.keyRecords.append(parent->keyRecords.at(leftIndex));
+        ++joined.count;
+    }
+    joined.keys.append(right.keys);
+    joined.keyRecords += right.keyRecords;
+    joined.pointers += right.pointers;
+    joined.count += right.count;
+
+    if (nodeLoad(joined) > nodeSize()) {
+        return true;
+    }
+
+    if (hasSiblingLinks()) {
+        joined.rightSibling = right.rightSibling;
+        if (right.rightSibling != NO_INDEX_NODE) {
+            QDbfIndexNode next;
+            if (!loadNode(right.rightSibling, &next)) {
+                return false;
+            }
+            next.leftSibling = joined.address;
+            storeNode(next);
+        }
+    }
+
+    storeNode(joined);
+
+    parent->keys.remove(leftIndex * m_keyLength, m_keyLength);
+    parent->keyRecords.remove(leftIndex);
+    parent->pointers.remove(leftIndex + 1);
+    --parent->count;
+
+    *merged = true;
+
+    return true;
+}
+
+void QDbfIndexFile::removeChild(QDbfIndexNode *parent, int childIndex) const
+{
+    // without its own key the rightmost child passes the slot to its neighbour
+    const int keyIndex = childIndex < parent->count ? childIndex : parent->count - 1;
+
+    parent->pointers.remove(childIndex);
+    if (keyIndex >= 0) {
+        parent->keys.remove(keyIndex * m_keyLength, m_keyLength);
+        parent->keyRecords.remove(keyIndex);
+        --parent->count;
+    }
+}
+
+bool QDbfIndexFile::unlinkNode(const QDbfIndexNode &node)
+{
+    if (!hasSiblingLinks()) {
+        return true;
+    }
+
+    QDbfIndexNode sibling;
+    if (node.leftSibling != NO_INDEX_NODE) {
+        if (!loadNode(node.leftSibling, &sibling)) {
+            return false;
+        }
+        sibling.rightSibling = node.rightSibling;
+        storeNode(sibling);
+    }
+
+    if (node.rightSibling != NO_INDEX_NODE) {
+        if (!loadNode(node.rightSibling, &sibling)) {
+            return false;
+        }
+        sibling.leftSibling = node.leftSibling;
+        storeNode(sibling);
+    }
+
+    return true;
+}
+
+void QDbfIndexFile::lastKey(const QDbfIndexNode &node, QByteArray *key, quint32 *record) const
+{
+    const int last = node.count - 1;
+    if (last < 0) {
+        *key = QByteArray(m_keyLength, '\0');
+        *record = 0;
+        return;
+    }
+
+    *key = QByteArray(node.key(last, m_keyLength), m_keyLength);
+    *record = node.leaf ? node.pointers.at(last) : node.keyRecords.at(last);
+}
+
+bool QDbfIndexFile::buildLevel(const QVector<QDbfIndexNode> &children,
+                               QVector<QDbfIndexKey> *highest, QVector<QDbfIndexNode> *level)
+{
+    // highest holds the highest key below every child and is replaced by
+    // the highest keys below the new nodes
+    const bool rightmostPointer = hasRightmostPointer();
+    QVector<QDbfIndexKey> levelHighest;
+
+    QDbfIndexNode node;
+    node.leaf = false;
+
+    for (int i = 0; i < children.size(); ++i) {
+        const bool keyed = !rightmostPointer || !node.pointers.isEmpty();
+        if (keyed) {
+            const QDbfIndexKey &key = highest->at(rightmostPointer ? i - 1 : i);
+            node.keys.append(key.key);
+            node.keyRecords.append(key.record);
+            ++node.count;
+        }
+        node.pointers.append(children.at(i).address);
+
+        if (node.pointers.size() > 1 && nodeLoad(node) > nodeSize()) {
+            node.pointers.removeLast();
+            node.keyRecords.removeLast();
+            --node.count;
+            node.keys.resize(node.count * m_keyLength);
+            level->append(node);
+            levelHighest.append(highest->at(i - 1));
+
+            node = QDbfIndexNode();
+            node.leaf = false;
+            --i;
+        }
+    }
+    level->append(node);
+    levelHighest.append(highest->last());
+
+    *highest = levelHighest;
+
+    return true;
+}
+
+bool QDbfIndexFile::storeLevel(QVector<QDbfIndexNode> *level)
+{
+    for (int i = 0; i < level->size(); ++i) {
+        (*level)[i].address = allocateNode();
+        if ((*level)[i].address == 0) {
+            return false;
+        }
+    }
+
+    if (level->size() == 1) {
+        setRootNode(level->first().address);
+    }
+
+    for (int i = 0; i < level->size(); ++i) {
+        QDbfIndexNode &node = (*level)[i];
+        if (hasSiblingLinks()) {
+            node.leftSibling = i > 0 ? level->at(i - 1).address : NO_INDEX_NODE;
+            node.rightSibling = i + 1 < level->size() ? level->at(i + 1).address : NO_INDEX_NODE;
+        }
+        if (!writeNode(node)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace Internal
+} // namespace QDbf
@@ -0,0 +1,202 @@
+#ifndef QDBFINDEX_P_H
+#define QDBFINDEX_P_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <QHash>
+
+#include "qdbfindexexpression_p.h"
+
+QT_BEGIN_NAMESPACE
+class QDate;
+class QVariant;
+QT_END_NAMESPACE
+
+namespace QDbf {
+
+class QDbfRecord;
+
+namespace Internal {
+
+class QDbfCodec;
+
+// sibling link of the first and the last node of a level
+const quint32 NO_INDEX_NODE = 0xFFFFFFFF;
+
+// One B-tree node decoded into a format independent shape. Keys are stored
+// back to back with a stride of the key length. In leaves pointers are the
+// (1-based) record numbers, in interior nodes they address the child nodes
+// and key i is the highest key below child i. Formats that keep a rightmost
+// child without a key have one pointer more than keys. keyRecords holds the
+// record numbers of interior keys for formats that store them.
+struct QDbfIndexNode
+{
+    QDbfIndexNode() :
+        address(0),
+        leftSibling(NO_INDEX_NODE),
+        rightSibling(NO_INDEX_NODE),
+        leaf(true),
+        count(0)
+    {}
+
+    inline const char *key(int i, int keyLength) const { return keys.constData() + i * keyLength; }
+
+    quint32 address;
+    quint32 leftSibling;
+    quint32 rightSibling;
+    bool leaf;
+    int count;
+    QByteArray keys;
+    QVector<quint32> pointers;
+    QVector<quint32> keyRecords;
+};
+
+struct QDbfIndexKey
+{
+    QDbfIndexKey() : record(0) {}
+    QDbfIndexKey(const QByteArray &key, quint32 record) : key(key), record(record) {}
+
+    QByteArray key;
+    quint32 record;
+};
+
+// Access to one ordered tag of an index file. Subclasses decode and encode
+// the headers and nodes of a concrete format, the traversal and the B-tree
+// maintenance are shared. Modified nodes are kept until flush() so that a
+// sorted batch of keys writes every touched node once.
+class QDbfIndexFile
+{
+public:
+    virtual ~QDbfIndexFile();
+
+    static QDbfIndexFile *open(const QString &fileName, const QString &tagName,
+                               const QDbfCodec *codec, const QDbfRecord &record,
+                               bool writable = false);
+
+    QString fileName() const;
+    QString tagName() const;
+    QString keyExpression() const;
+    int keyLength() const;
+    bool isUnique() const;
+    bool isDescending() const;
+    bool isWritable() const;
+
+    QByteArray encodeKey(const QVariant &value) const;
+
+    // keys of records are computed from the key expression, which has to be
+    // compiled against the table structure first
+    bool compileExpression(const QDbfRecord &record);
+    bool hasExpression() const;
+    QByteArray recordKey(const char *record) const;
+
+    // record numbers are 1-based like in the index nodes
+    bool insertKeys(QVector<QDbfIndexKey> keys);
+    bool removeKey(const QByteArray &key, quint32 record);
+    bool rebuild(QVector<QDbfIndexKey> keys);
+
+    bool first();
+    bool seek(const QByteArray &key);
+    bool next();
+    void setUpperBound(const QByteArray &key);
+
+    bool atEnd() const;
+    int recordIndex() const;
+    const char *key() const;
+
+protected:
+    // formats that do not store the key type leave it unknown and it is
+    // inferred from the key expression when the tag is opened
+    enum KeyKind {
+        UnknownKeys,
+        CharacterKeys,
+        NumericKeys,
+        DateKeys
+    };
+
+    explicit QDbfIndexFile(const QDbfCodec *codec);
+
+    virtual bool load(const QString &tagName) = 0;
+    virtual quint32 rootNode() const = 0;
+    virtual bool readNode(quint32 address, QDbfIndexNode *node) = 0;
+    virtual QByteArray encodeNumber(double value) const = 0;
+    virtual QByteArray encodeDate(const QDate &date) const = 0;
+    virtual int compareKeys(const char *key, const char *searchKey, int searchLength) const;
+
+    virtual int nodeSize() const = 0;
+    virtual int nodeLoad(const QDbfIndexNode &node) const = 0;
+    virtual bool hasRightmostPointer() const;
+    virtual bool hasSiblingLinks() const;
+    virtual bool writeNode(const QDbfIndexNode &node) = 0;
+    virtual quint32 allocateNode() = 0;
+    virtual void setRootNode(quint32 address) = 0;
+    virtual bool writeHeader() = 0;
+    virtual bool resetNodes();
+
+    bool readBlock(qint64 offset, char *data, int length);
+    bool writeBlock(qint64 offset, const char *data, int length);
+    static QString headerString(const char *data, int maxLength);
+    static QByteArray doubleKey(double value);
+    static double keyDouble(const char *key);
+
+    QFile m_file;
+    const QDbfCodec *m_codec;
+    QString m_tagName;
+    QString m_expression;
+    int m_keyLength;
+    bool m_unique;
+    bool m_descending;
+    KeyKind m_keyKind;
+
+private:
+    Q_DISABLE_COPY(QDbfIndexFile)
+
+    struct Position
+    {
+        QDbfIndexNode node;
+        int index;
+    };
+
+    class KeyLess;
+
+    void inferKeyKind(const QDbfRecord &record);
+
+    int order(const char *key, const char *searchKey, int searchLength) const;
+    int lowerBound(const QDbfIndexNode &node, const QByteArray &searchKey) const;
+    bool descend(QVector<Position> *path, quint32 address, const QByteArray *searchKey);
+    bool settle(QVector<Position> *path);
+    bool checkUpperBound();
+    void sortKeys(QVector<QDbfIndexKey> *keys) const;
+
+    bool loadNode(quint32 address, QDbfIndexNode *node);
+    void storeNode(const QDbfIndexNode &node);
+    bool flush();
+
+    bool locate(const QByteArray &key, QVector<Position> *path);
+    bool insertEntry(const QDbfIndexKey &entry);
+    bool removeEntry(const QByteArray &key, quint32 record);
+    bool updatePath(QVector<Position> *path);
+    bool updateRoot(QDbfIndexNode *root);
+    bool updateSeparator(const QDbfIndexNode &node, QDbfIndexNode *parent, int childIndex) const;
+    bool splitNode(QDbfIndexNode *node, QDbfIndexNode *parent, int childIndex);
+    bool mergeNode(QDbfIndexNode *node, QDbfIndexNode *parent, int childIndex, bool *merged);
+    void removeChild(QDbfIndexNode *parent, int childIndex) const;
+    bool unlinkNode(const QDbfIndexNode &node);
+    void lastKey(const QDbfIndexNode &node, QByteArray *key, quint32 *record) const;
+    bool buildLevel(const QVector<QDbfIndexNode> &children, QVector<QDbfIndexKey> *highest,
+                    QVector<QDbfIndexNode> *level);
+    bool storeLevel(QVector<QDbfIndexNode> *level);
+
+    QVector<Position> m_path;
+    QByteArray m_upperBound;
+    QHash<quint32, QDbfIndexNode> m_dirtyNodes;
+    QDbfIndexExpression m_keyExpression;
+    bool m_hasKeyExpression;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFINDEX_P_H
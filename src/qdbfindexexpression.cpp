@@ -0,0 +1,320 @@
+#include "qdbfindexexpression_p.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfrecord.h"
+
+#include <QDate>
+#include <QStringList>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DATE_LENGTH = 8;
+const int DEFAULT_STR_LENGTH = 10;
+
+QDbfIndexExpression::QDbfIndexExpression() :
+    m_codec(0),
+    m_resultType(CharacterResult),
+    m_length(0)
+{
+}
+
+bool QDbfIndexExpression::compile(const QString &expression, const QDbfRecord &record,
+                                  const QDbfCodec *codec)
+{
+    m_terms.clear();
+    m_codec = codec;
+    m_resultType = CharacterResult;
+    m_length = 0;
+
+    QString normalized = expression.toUpper();
+    normalized.remove(QLatin1Char(' '));
+
+    const QStringList terms = normalized.split(QLatin1Char('+'));
+    for (int i = 0; i < terms.size(); ++i) {
+        if (!compileTerm(terms.at(i), record)) {
+            m_terms.clear();
+            return false;
+        }
+    }
+
+    // a bare numeric or date field gives a binary key, and only on its own
+    if (m_resultType != CharacterResult && m_terms.size() != 1) {
+        m_terms.clear();
+        return false;
+    }
+
+    return !m_terms.isEmpty();
+}
+
+bool QDbfIndexExpression::compileTerm(const QString &term, const QDbfRecord &record)
+{
+    QString function;
+    QStringList arguments;
+
+    const int open = term.indexOf(QLatin1Char('('));
+    if (open >= 0) {
+        if (!term.endsWith(QLatin1Char(')'))) {
+            return false;
+        }
+        function = term.left(open);
+        arguments = term.mid(open + 1, term.length() - open - 2).split(QLatin1Char(','));
+    } else {
+        arguments.append(term);
+    }
+
+    const int fieldIndex = record.indexOf(arguments.first());
+    if (fieldIndex < 0) {
+        return false;
+    }
+
+    const QDbfField field = record.field(fieldIndex);
+
+    Term compiled;
+    compiled.offset = field.offset();
+    compiled.fieldLength = field.length();
+    compiled.length = field.length();
+    compiled.decimals = 0;
+
+    if (function.isEmpty()) {
+        compiled.kind = FieldTerm;
+        switch (field.dbfType()) {
+        case QDbfField::Number:
+        case QDbfField::FloatingPoint:
+            m_resultType = NumericResult;
+            break;
+        case QDbfField::Date:
+            m_resultType = DateResult;
+            break;
+        default:
+            break;
+        }
+    } else if (function == QLatin1String("UPPER") && arguments.size() == 1 &&
+               field.dbfType() == QDbfField::Character) {
+        compiled.kind = UpperTerm;
+    } else if (function == QLatin1String("DTOS") && arguments.size() == 1 &&
+               field.dbfType() == QDbfField::Date) {
+        compiled.kind = FieldTerm;
+    } else if (function == QLatin1String("STR") && arguments.size() <= 3 &&
+               (field.dbfType() == QDbfField::Number ||
+                field.dbfType() == QDbfField::FloatingPoint)) {
+        compiled.kind = StrTerm;
+        compiled.length = arguments.size() > 1 ? arguments.at(1).toInt() : DEFAULT_STR_LENGTH;
+        compiled.decimals = arguments.size() > 2 ? arguments.at(2).toInt() : 0;
+        if (compiled.length <= 0) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    m_terms.append(compiled);
+    m_length += compiled.length;
+
+    return true;
+}
+
+static bool functionResultType(const QString &function, QDbfIndexExpression::ResultType *type)
+{
+    static const char *const characterFunctions[] = {
+        "ALLTRIM", "CHR", "DTOC", "DTOS", "LEFT", "LOWER", "LTRIM", "PADC", "PADL", "PADR",
+        "REPLICATE", "RIGHT", "RTRIM", "SPACE", "STR", "SUBSTR", "TRANSFORM", "TRIM", "UPPER", 0
+    };
+    static const char *const numericFunctions[] = {
+        "ABS", "ASC", "AT", "DAY", "INT", "LEN", "MOD", "MONTH", "RECNO", "ROUND", "VAL", "YEAR", 0
+    };
+    static const char *const dateFunctions[] = {
+        "CTOD", "DATE", 0
+    };
+
+    for (int i = 0; characterFunctions[i]; ++i) {
+        if (function == QLatin1String(characterFunctions[i])) {
+            *type = QDbfIndexExpression::CharacterResult;
+            return true;
+        }
+    }
+    for (int i = 0; numericFunctions[i]; ++i) {
+        if (function == QLatin1String(numericFunctions[i])) {
+            *type = QDbfIndexExpression::NumericResult;
+            return true;
+        }
+    }
+    for (int i = 0; dateFunctions[i]; ++i) {
+        if (function == QLatin1String(dateFunctions[i])) {
+            *type = QDbfIndexExpression::DateResult;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool QDbfIndexExpression::inferResultType(const QString &expression, const QDbfRecord &record,
+                                          ResultType *type)
+{
+    // the first operand decides: strings concatenate, dates plus days stay dates
+    const QString term = splitTopLevel(expression.toUpper(), QLatin1String("+-")).first().trimmed();
+    if (term.isEmpty()) {
+        return false;
+    }
+
+    const QChar first = term.at(0);
+    if (first == QLatin1Char('\'') || first == QLatin1Char('"') || first == QLatin1Char('[')) {
+        *type = CharacterResult;
+        return true;
+    }
+    if (first.isDigit() || first == QLatin1Char('.')) {
+        *type = NumericResult;
+        return true;
+    }
+
+    const int open = term.indexOf(QLatin1Char('('));
+    if (open < 0) {
+        const int alias = term.lastIndexOf(QLatin1String("->"));
+        const int fieldIndex = record.indexOf(alias >= 0 ? term.mid(alias + 2) : term);
+        if (fieldIndex < 0) {
+            return false;
+        }
+
+        switch (record.field(fieldIndex).dbfType()) {
+        case QDbfField::Character:
+            *type = CharacterResult;
+            return true;
+        case QDbfField::Number:
+        case QDbfField::FloatingPoint:
+            *type = NumericResult;
+            return true;
+        case QDbfField::Date:
+            *type = DateResult;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    if (!term.endsWith(QLatin1Char(')'))) {
+        return false;
+    }
+
+    const QString function = term.left(open).trimmed();
+    const QString inner = term.mid(open + 1, term.length() - open - 2);
+    if (function.isEmpty()) {
+        return inferResultType(inner, record, type);
+    }
+
+    const QStringList arguments = splitTopLevel(inner, QLatin1String(","));
+    if (function == QLatin1String("IIF")) {
+        return arguments.size() == 3 && inferResultType(arguments.at(1), record, type);
+    }
+    if (function == QLatin1String("MAX") || function == QLatin1String("MIN")) {
+        return inferResultType(arguments.first(), record, type);
+    }
+
+    return functionResultType(function, type);
+}
+
+QStringList QDbfIndexExpression::splitTopLevel(const QString &expression, const QString &separators)
+{
+    QStringList parts;
+    QChar quote;
+    int depth = 0;
+    int start = 0;
+
+    for (int i = 0; i < expression.length(); ++i) {
+        const QChar c = expression.at(i);
+        if (!quote.isNull()) {
+            if (c == quote) {
+                quote = QChar();
+            }
+        } else if (c == QLatin1Char('\'') || c == QLatin1Char('"')) {
+            quote = c;
+        } else if (c == QLatin1Char('(')) {
+            ++depth;
+        } else if (c == QLatin1Char(')')) {
+            --depth;
+        } else if (depth == 0 && separators.contains(c) &&
+                   !(c == QLatin1Char('-') && expression.mid(i + 1, 1) == QLatin1String(">"))) {
+            parts.append(expression.mid(start, i - start));
+            start = i + 1;
+        }
+    }
+
+    parts.append(expression.mid(start));
+    return parts;
+}
+
+QDbfIndexExpression::ResultType QDbfIndexExpression::resultType() const
+{
+    return m_resultType;
+}
+
+int QDbfIndexExpression::length() const
+{
+    return m_length;
+}
+
+void QDbfIndexExpression::evaluate(const char *record, char *out) const
+{
+    for (int i = 0; i < m_terms.size(); ++i) {
+        const Term &term = m_terms.at(i);
+        const char *field = record + term.offset;
+
+        switch (term.kind) {
+        case FieldTerm:
+            memcpy(out, field, term.length);
+            break;
+        case UpperTerm: {
+            bool ascii = true;
+            for (int j = 0; j < term.length; ++j) {
+                const char c = field[j];
+                out[j] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+                ascii = ascii && static_cast<uchar>(c) < 0x80;
+            }
+            if (!ascii) {
+                const QString upper = m_codec->toUnicode(field, term.length).toUpper();
+                const int length = m_codec->fromUnicode(upper.constData(), upper.length(),
+                                                        out, term.length);
+                memset(out + length, ' ', term.length - length);
+            }
+            break;
+        }
+        case StrTerm: {
+            double value = 0.0;
+            parseNumber(field, term.fieldLength, &value);
+            formatNumber(value, term.decimals, out, term.length);
+            break;
+        }
+        }
+
+        out += term.length;
+    }
+}
+
+double QDbfIndexExpression::evaluateNumber(const char *record) const
+{
+    const Term &term = m_terms.first();
+    double value = 0.0;
+    parseNumber(record + term.offset, term.fieldLength, &value);
+    return value;
+}
+
+QDate QDbfIndexExpression::evaluateDate(const char *record) const
+{
+    const Term &term = m_terms.first();
+    if (term.fieldLength < DATE_LENGTH) {
+        return QDate();
+    }
+
+    const char *field = record + term.offset;
+    const int year = parseDigits(field, 4);
+    const int month = parseDigits(field + 4, 2);
+    const int day = parseDigits(field + 6, 2);
+
+    return year > 0 && month > 0 && day > 0 ? QDate(year, month, day) : QDate();
+}
+
+} // namespace Internal
+} // namespace QDbf
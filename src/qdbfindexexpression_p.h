@@ -0,0 +1,77 @@
+#ifndef QDBFINDEXEXPRESSION_P_H
+#define QDBFINDEXEXPRESSION_P_H
+
+#include "qdbffield.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QDate;
+QT_END_NAMESPACE
+
+namespace QDbf {
+
+class QDbfRecord;
+
+namespace Internal {
+
+class QDbfCodec;
+
+// The subset of xBase key expressions found in practice: a field name, or
+// UPPER(field), DTOS(field) and STR(field[, length[, decimals]]) terms
+// concatenated with '+'. Evaluated on the stored bytes of a record.
+class QDbfIndexExpression
+{
+public:
+    enum ResultType {
+        CharacterResult,
+        NumericResult,
+        DateResult
+    };
+
+    QDbfIndexExpression();
+
+    bool compile(const QString &expression, const QDbfRecord &record, const QDbfCodec *codec);
+
+    // the type of any expression built from common xBase functions, fields
+    // and literals, including the ones compile() does not support
+    static bool inferResultType(const QString &expression, const QDbfRecord &record,
+                                ResultType *type);
+
+    ResultType resultType() const;
+    int length() const;
+
+    void evaluate(const char *record, char *out) const;
+    double evaluateNumber(const char *record) const;
+    QDate evaluateDate(const char *record) const;
+
+private:
+    enum TermKind {
+        FieldTerm,
+        UpperTerm,
+        StrTerm
+    };
+
+    struct Term {
+        TermKind kind;
+        int offset;
+        int fieldLength;
+        int length;
+        int decimals;
+    };
+
+    bool compileTerm(const QString &term, const QDbfRecord &record);
+    static QStringList splitTopLevel(const QString &expression, const QString &separators);
+
+    QVector<Term> m_terms;
+    const QDbfCodec *m_codec;
+    ResultType m_resultType;
+    int m_length;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFINDEXEXPRESSION_P_H
@@ -0,0 +1,307 @@
+#include "qdbfmdxindex_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QVarLengthArray>
+#include <QtEndian>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int MDX_PAGE_SIZE = 512;
+const int MDX_BLOCK_SIZE_OFFSET = 22;
+const int MDX_TAGS_COUNT_OFFSET = 28;
+const int MDX_PAGES_COUNT_OFFSET = 32;
+const int MDX_TAG_TABLE_OFFSET = 544;
+const int MDX_TAG_ENTRY_LENGTH = 32;
+const int MDX_TAG_NAME_OFFSET = 4;
+const int MDX_TAG_NAME_LENGTH = 11;
+const int MDX_MAX_TAGS = 48;
+const int MDX_ROOT_OFFSET = 0;
+const int MDX_KEY_FORMAT_OFFSET = 8;
+const int MDX_KEY_TYPE_OFFSET = 9;
+const int MDX_KEY_LENGTH_OFFSET = 12;
+const int MDX_ITEM_LENGTH_OFFSET = 18;
+const int MDX_UNIQUE_OFFSET = 23;
+const int MDX_EXPRESSION_OFFSET = 24;
+const int MDX_EXPRESSION_LENGTH = 220;
+const int MDX_ENTRIES_OFFSET = 8;
+const char MDX_DESCENDING = 0x08;
+const int BCD_KEY_LENGTH = 12;
+const int BCD_MAX_DIGITS = 20;
+const int BCD_EXPONENT_BIAS = 0x34;
+const int DOUBLE_KEY_LENGTH = 8;
+
+QDbfMdxIndex::QDbfMdxIndex(const QDbfCodec *codec) :
+    QDbfIndexFile(codec),
+    m_rootPage(0),
+    m_tagPage(0),
+    m_nextPage(0),
+    m_blockSize(0),
+    m_itemLength(0),
+    m_keyType('C')
+{
+}
+
+bool QDbfMdxIndex::load(const QString &tagName)
+{
+    QVarLengthArray<char, MDX_TAG_TABLE_OFFSET + MDX_MAX_TAGS * MDX_TAG_ENTRY_LENGTH> header(
+                MDX_TAG_TABLE_OFFSET + MDX_MAX_TAGS * MDX_TAG_ENTRY_LENGTH);
+    if (!readBlock(0, header.data(), MDX_TAG_TABLE_OFFSET)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(header.constData());
+    m_blockSize = qFromLittleEndian<quint16>(data + MDX_BLOCK_SIZE_OFFSET);
+    m_nextPage = qFromLittleEndian<quint32>(data + MDX_PAGES_COUNT_OFFSET);
+    const int tagsCount = qMin(static_cast<int>(qFromLittleEndian<quint16>(data + MDX_TAGS_COUNT_OFFSET)),
+                               MDX_MAX_TAGS);
+
+    if (m_blockSize < MDX_PAGE_SIZE || tagsCount <= 0 ||
+        !readBlock(MDX_TAG_TABLE_OFFSET, header.data() + MDX_TAG_TABLE_OFFSET,
+                   tagsCount * MDX_TAG_ENTRY_LENGTH)) {
+        qWarning("QDbfMdxIndex::load(): invalid header in %s", qPrintable(fileName()));
+        return false;
+    }
+
+    // without a tag name the first tag is used
+    quint32 tagPage = 0;
+    for (int i = 0; i < tagsCount && tagPage == 0; ++i) {
+        const uchar *entry = data + MDX_TAG_TABLE_OFFSET + i * MDX_TAG_ENTRY_LENGTH;
+        const QString name = headerString(reinterpret_cast<const char *>(entry) + MDX_TAG_NAME_OFFSET,
+                                          MDX_TAG_NAME_LENGTH);
+        if (tagName.isEmpty() || name.compare(tagName, Qt::CaseInsensitive) == 0) {
+            tagPage = qFromLittleEndian<quint32>(entry);
+            m_tagName = name;
+        }
+    }
+
+    if (tagPage == 0) {
+        qWarning("QDbfMdxIndex::load(): no tag %s in %s", qPrintable(tagName), qPrintable(fileName()));
+        return false;
+    }
+
+    char tagHeader[MDX_PAGE_SIZE];
+    if (!readBlock(static_cast<qint64>(tagPage) * MDX_PAGE_SIZE, tagHeader, MDX_PAGE_SIZE)) {
+        return false;
+    }
+
+    m_tagPage = tagPage;
+
+    data = reinterpret_cast<const uchar *>(tagHeader);
+    m_rootPage = qFromLittleEndian<quint32>(data + MDX_ROOT_OFFSET);
+    m_descending = (tagHeader[MDX_KEY_FORMAT_OFFSET] & MDX_DESCENDING) != 0;
+    m_keyType = tagHeader[MDX_KEY_TYPE_OFFSET];
+    m_keyKind = m_keyType == 'N' ? NumericKeys : m_keyType == 'D' ? DateKeys : CharacterKeys;
+    m_keyLength = qFromLittleEndian<quint16>(data + MDX_KEY_LENGTH_OFFSET);
+    m_itemLength = qFromLittleEndian<quint16>(data + MDX_ITEM_LENGTH_OFFSET);
+    m_unique = tagHeader[MDX_UNIQUE_OFFSET] != 0;
+    m_expression = headerString(tagHeader + MDX_EXPRESSION_OFFSET, MDX_EXPRESSION_LENGTH);
+
+    if (m_keyLength <= 0 || m_itemLength < m_keyLength + 4 ||
+        MDX_ENTRIES_OFFSET + 2 * m_itemLength > m_blockSize ||
+        (m_keyType == 'N' && m_keyLength != BCD_KEY_LENGTH) ||
+        (m_keyType == 'D' && m_keyLength != DOUBLE_KEY_LENGTH)) {
+        qWarning("QDbfMdxIndex::load(): invalid tag header in %s", qPrintable(fileName()));
+        return false;
+    }
+
+    const quint32 filePages = static_cast<quint32>((m_file.size() + MDX_PAGE_SIZE - 1) / MDX_PAGE_SIZE);
+    m_nextPage = qMax(m_nextPage, filePages);
+
+    return true;
+}
+
+quint32 QDbfMdxIndex::rootNode() const
+{
+    return m_rootPage;
+}
+
+bool QDbfMdxIndex::readNode(quint32 address, QDbfIndexNode *node)
+{
+    QVarLengthArray<char, 2 * MDX_PAGE_SIZE> block(m_blockSize);
+    if (address == 0 || !readBlock(static_cast<qint64>(address) * MDX_PAGE_SIZE, block.data(), m_blockSize)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+    const int count = qFromLittleEndian<quint32>(data);
+    const int capacity = (m_blockSize - MDX_ENTRIES_OFFSET) / m_itemLength;
+    if (count < 0 || count > capacity) {
+        return false;
+    }
+
+    // interior blocks keep a child pointer after the last key, leaves do not
+    const quint32 trailingPointer = count < capacity ?
+                qFromLittleEndian<quint32>(data + MDX_ENTRIES_OFFSET + count * m_itemLength) : 0;
+    node->leaf = trailingPointer == 0;
+
+    node->address = address;
+    node->count = count;
+    node->keys.resize(count * m_keyLength);
+    node->pointers.resize(node->leaf ? count : count + 1);
+
+    for (int i = 0; i < node->pointers.size(); ++i) {
+        const uchar *entry = data + MDX_ENTRIES_OFFSET + i * m_itemLength;
+        node->pointers[i] = qFromLittleEndian<quint32>(entry);
+        if (i < count) {
+            memcpy(node->keys.data() + i * m_keyLength, entry + 4, m_keyLength);
+        }
+    }
+
+    return true;
+}
+
+QByteArray QDbfMdxIndex::encodeNumber(double value) const
+{
+    if (m_keyType != 'N') {
+        return QByteArray();
+    }
+
+    // byte 0: decimal exponent + bias, byte 1: digits count << 2 and the
+    // sign bit, then up to twenty packed BCD digits
+    QByteArray key(BCD_KEY_LENGTH, '\0');
+    uchar *data = reinterpret_cast<uchar *>(key.data());
+
+    if (value == 0.0 || value != value) {
+        data[0] = BCD_EXPONENT_BIAS;
+        data[1] = 1 << 2;
+        return key;
+    }
+
+    char digits[32];
+    qsnprintf(digits, sizeof(digits), "%.14e", qAbs(value));
+
+    // digits[0] '.' digits[2..15] 'e' exponent
+    char mantissa[BCD_MAX_DIGITS];
+    int count = 0;
+    mantissa[count++] = digits[0];
+    for (int i = 2; digits[i] >= '0' && digits[i] <= '9'; ++i) {
+        mantissa[count++] = digits[i];
+    }
+    while (count > 1 && mantissa[count - 1] == '0') {
+        --count;
+    }
+
+    const char *exponent = strchr(digits, 'e');
+    const int decimalExponent = exponent ? atoi(exponent + 1) + 1 : 1;
+
+    data[0] = static_cast<uchar>(BCD_EXPONENT_BIAS + decimalExponent);
+    data[1] = static_cast<uchar>((count << 2) | (value < 0 ? 0x80 : 0));
+    for (int i = 0; i < count; ++i) {
+        const uchar digit = mantissa[i] - '0';
+        data[2 + i / 2] |= (i % 2 == 0) ? digit << 4 : digit;
+    }
+
+    return key;
+}
+
+QByteArray QDbfMdxIndex::encodeDate(const QDate &date) const
+{
+    if (m_keyType != 'D') {
+        return QByteArray();
+    }
+
+    return doubleKey(static_cast<double>(date.toJulianDay()));
+}
+
+double QDbfMdxIndex::decodeNumber(const char *key)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(key);
+    const int count = qMin((data[1] >> 2) & 0x1F, BCD_MAX_DIGITS);
+
+    double mantissa = 0.0;
+    for (int i = 0; i < count; ++i) {
+        const int digit = (i % 2 == 0) ? data[2 + i / 2] >> 4 : data[2 + i / 2] & 0x0F;
+        mantissa = mantissa * 10.0 + digit;
+    }
+
+    const double value = mantissa * pow(10.0, static_cast<int>(data[0]) - BCD_EXPONENT_BIAS - count);
+    return (data[1] & 0x80) ? -value : value;
+}
+
+int QDbfMdxIndex::compareKeys(const char *key, const char *searchKey, int searchLength) const
+{
+    if (m_keyType == 'N') {
+        if (searchLength != BCD_KEY_LENGTH) {
+            return 1;
+        }
+        const double left = decodeNumber(key);
+        const double right = decodeNumber(searchKey);
+        return left < right ? -1 : (left > right ? 1 : 0);
+    }
+
+    if (m_keyType == 'D') {
+        if (searchLength != DOUBLE_KEY_LENGTH) {
+            return 1;
+        }
+        const double left = keyDouble(key);
+        const double right = keyDouble(searchKey);
+        return left < right ? -1 : (left > right ? 1 : 0);
+    }
+
+    return QDbfIndexFile::compareKeys(key, searchKey, searchLength);
+}
+
+int QDbfMdxIndex::nodeSize() const
+{
+    return m_blockSize;
+}
+
+int QDbfMdxIndex::nodeLoad(const QDbfIndexNode &node) const
+{
+    return MDX_ENTRIES_OFFSET + (node.leaf ? node.count : node.count + 1) * m_itemLength;
+}
+
+bool QDbfMdxIndex::writeNode(const QDbfIndexNode &node)
+{
+    QVarLengthArray<char, 2 * MDX_PAGE_SIZE> block(m_blockSize);
+    memset(block.data(), 0, m_blockSize);
+
+    // a zero pointer after the last key marks a leaf
+    uchar *data = reinterpret_cast<uchar *>(block.data());
+    qToLittleEndian<quint32>(node.count, data);
+
+    for (int i = 0; i < node.pointers.size(); ++i) {
+        uchar *entry = data + MDX_ENTRIES_OFFSET + i * m_itemLength;
+        qToLittleEndian<quint32>(node.pointers.at(i), entry);
+        if (i < node.count) {
+            memcpy(entry + 4, node.key(i, m_keyLength), m_keyLength);
+        }
+    }
+
+    return writeBlock(static_cast<qint64>(node.address) * MDX_PAGE_SIZE, block.constData(), m_blockSize);
+}
+
+quint32 QDbfMdxIndex::allocateNode()
+{
+    const quint32 page = m_nextPage;
+    m_nextPage += (m_blockSize + MDX_PAGE_SIZE - 1) / MDX_PAGE_SIZE;
+    return page;
+}
+
+void QDbfMdxIndex::setRootNode(quint32 address)
+{
+    m_rootPage = address;
+}
+
+bool QDbfMdxIndex::writeHeader()
+{
+    uchar value[4];
+
+    qToLittleEndian<quint32>(m_rootPage, value);
+    if (!writeBlock(static_cast<qint64>(m_tagPage) * MDX_PAGE_SIZE + MDX_ROOT_OFFSET,
+                    reinterpret_cast<const char *>(value), sizeof(value))) {
+        return false;
+    }
+
+    qToLittleEndian<quint32>(m_nextPage, value);
+    return writeBlock(MDX_PAGES_COUNT_OFFSET, reinterpret_cast<const char *>(value), sizeof(value));
+}
+
+} // namespace Internal
+} // namespace QDbf
@@ -0,0 +1,46 @@
+#ifndef QDBFMDXINDEX_P_H
+#define QDBFMDXINDEX_P_H
+
+#include "qdbfindex_p.h"
+
+namespace QDbf {
+namespace Internal {
+
+// dBASE IV multiple index: a tag table in the file header, every tag with a
+// header page of its own. Nodes span blockSize bytes, numeric keys use the
+// 12 byte BCD format and date keys little-endian Julian day doubles.
+class QDbfMdxIndex : public QDbfIndexFile
+{
+public:
+    explicit QDbfMdxIndex(const QDbfCodec *codec);
+
+    static double decodeNumber(const char *key);
+
+protected:
+    bool load(const QString &tagName);
+    quint32 rootNode() const;
+    bool readNode(quint32 address, QDbfIndexNode *node);
+    QByteArray encodeNumber(double value) const;
+    QByteArray encodeDate(const QDate &date) const;
+    int compareKeys(const char *key, const char *searchKey, int searchLength) const;
+
+    int nodeSize() const;
+    int nodeLoad(const QDbfIndexNode &node) const;
+    bool writeNode(const QDbfIndexNode &node);
+    quint32 allocateNode();
+    void setRootNode(quint32 address);
+    bool writeHeader();
+
+private:
+    quint32 m_rootPage;
+    quint32 m_tagPage;
+    quint32 m_nextPage;
+    int m_blockSize;
+    int m_itemLength;
+    char m_keyType;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFMDXINDEX_P_H
@@ -0,0 +1,226 @@
+#include "qdbfmemofile_p.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int DBASE3_BLOCK_SIZE = 512;
+const int DBASE4_BLOCK_SIZE_OFFSET = 20;
+const int FOXPRO_BLOCK_SIZE_OFFSET = 6;
+const int MEMO_HEADER_LENGTH = 512;
+const int BLOCK_HEADER_LENGTH = 8;
+const char MEMO_END_MARK = 26;
+const uchar DBASE4_SIGNATURE[] = { 0xFF, 0xFF, 0x08, 0x00 };
+
+QDbfMemoFile::QDbfMemoFile() :
+    ref(1),
+    m_format(DBase3),
+    m_blockSize(DBASE3_BLOCK_SIZE)
+{
+}
+
+QDbfMemoFile::~QDbfMemoFile()
+{
+    close();
+}
+
+bool QDbfMemoFile::open(const QString &fileName, Format format)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_cache.clear();
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray header = m_file.read(MEMO_HEADER_LENGTH);
+    if (header.size() < BLOCK_HEADER_LENGTH) {
+        m_file.close();
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(header.constData());
+
+    m_format = format;
+    switch (format) {
+    case DBase4:
+        m_blockSize = header.size() >= DBASE4_BLOCK_SIZE_OFFSET + 2 ?
+                    qFromLittleEndian<quint16>(data + DBASE4_BLOCK_SIZE_OFFSET) : 0;
+        break;
+    case FoxPro:
+        m_blockSize = qFromBigEndian<quint16>(data + FOXPRO_BLOCK_SIZE_OFFSET);
+        break;
+    default:
+        m_blockSize = DBASE3_BLOCK_SIZE;
+        break;
+    }
+
+    if (m_blockSize <= 0) {
+        m_blockSize = DBASE3_BLOCK_SIZE;
+    }
+
+    return true;
+}
+
+void QDbfMemoFile::close()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_cache.clear();
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool QDbfMemoFile::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file.isOpen();
+}
+
+void QDbfMemoFile::setCacheSize(int size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(qMax(0, size));
+}
+
+int QDbfMemoFile::cacheSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost();
+}
+
+quint32 QDbfMemoFile::blockNumber(const char *data, int length)
+{
+    // Visual FoxPro stores a binary block number, the others ten digits
+    if (length == 4) {
+        if (memcmp(data, "    ", 4) == 0) {
+            return 0;
+        }
+        return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data));
+    }
+
+    quint32 block = 0;
+    for (int i = 0; i < length; ++i) {
+        if (data[i] >= '0' && data[i] <= '9') {
+            block = block * 10 + (data[i] - '0');
+        } else if (data[i] != ' ' || block > 0) {
+            break;
+        }
+    }
+
+    return block;
+}
+
+QByteArray QDbfMemoFile::read(quint32 block)
+{
+    // block 0 holds the file header, it marks an empty memo
+    if (block == 0) {
+        return QByteArray();
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_file.isOpen()) {
+        return QByteArray();
+    }
+
+    const QByteArray *cached = m_cache.object(block);
+    if (cached) {
+        return *cached;
+    }
+
+    const QByteArray body = readBody(block);
+
+    // bodies larger than the whole cache are not kept
+    if (body.size() <= m_cache.maxCost()) {
+        m_cache.insert(block, new QByteArray(body), qMax(1, body.size()));
+    }
+
+    return body;
+}
+
+bool QDbfMemoFile::readBlocks(quint32 block, int count, QByteArray *data)
+{
+    const qint64 position = static_cast<qint64>(block) * m_blockSize;
+    const qint64 length = qMin(static_cast<qint64>(count) * m_blockSize, m_file.size() - position);
+    if (length <= 0 || !m_file.seek(position)) {
+        return false;
+    }
+
+    *data = m_file.read(length);
+
+    return data->size() == length;
+}
+
+QByteArray QDbfMemoFile::readBody(quint32 block)
+{
+    QByteArray data;
+    if (!readBlocks(block, 1, &data)) {
+        return QByteArray();
+    }
+
+    const uchar *header = reinterpret_cast<const uchar *>(data.constData());
+    const qint64 available = m_file.size() - static_cast<qint64>(block) * m_blockSize;
+
+    // FoxPro and dBASE IV blocks start with the length of the body, so the
+    // remaining blocks are read at once
+    qint64 offset = -1;
+    qint64 length = 0;
+    if (m_format == FoxPro && data.size() >= BLOCK_HEADER_LENGTH) {
+        offset = BLOCK_HEADER_LENGTH;
+        length = qFromBigEndian<quint32>(header + 4);
+    } else if (m_format == DBase4 && data.size() >= BLOCK_HEADER_LENGTH &&
+               memcmp(header, DBASE4_SIGNATURE, sizeof(DBASE4_SIGNATURE)) == 0) {
+        offset = BLOCK_HEADER_LENGTH;
+        length = static_cast<qint64>(qFromLittleEndian<quint32>(header + 4)) - BLOCK_HEADER_LENGTH;
+    }
+
+    if (offset >= 0) {
+        if (length <= 0 || offset + length > available) {
+            return QByteArray();
+        }
+
+        const int count = static_cast<int>((offset + length + m_blockSize - 1) / m_blockSize);
+        if (count > 1 && !readBlocks(block, count, &data)) {
+            return QByteArray();
+        }
+
+        return data.mid(offset, length);
+    }
+
+    // dBASE III bodies end with a mark, the number of blocks read is doubled
+    // until it shows up
+    int blocks = 1;
+    int searched = 0;
+    for (;;) {
+        const int end = data.indexOf(MEMO_END_MARK, searched);
+        if (end >= 0) {
+            return data.left(end);
+        }
+
+        if (data.size() >= available) {
+            return data;
+        }
+
+        QByteArray next;
+        if (!readBlocks(block + blocks, blocks, &next)) {
+            return data;
+        }
+
+        searched = data.size();
+        data.append(next);
+        blocks *= 2;
+    }
+}
+
+} // namespace Internal
+} // namespace QDbf
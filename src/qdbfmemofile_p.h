@@ -0,0 +1,57 @@
+#ifndef QDBFMEMOFILE_P_H
+#define QDBFMEMOFILE_P_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+
+namespace QDbf {
+namespace Internal {
+
+// Memo bodies of a table, read from its .dbt or .fpt file block by block
+// when a memo value is first asked for. Recently read bodies are kept in a
+// cache bounded by their total size. Shared by the table and the records
+// taken from it, so access is serialized.
+class QDbfMemoFile
+{
+public:
+    enum Format
+    {
+        DBase3,
+        DBase4,
+        FoxPro
+    };
+
+    QDbfMemoFile();
+    ~QDbfMemoFile();
+
+    bool open(const QString &fileName, Format format);
+    void close();
+    bool isOpen() const;
+
+    void setCacheSize(int size);
+    int cacheSize() const;
+
+    static quint32 blockNumber(const char *data, int length);
+    QByteArray read(quint32 block);
+
+    QAtomicInt ref;
+
+private:
+    Q_DISABLE_COPY(QDbfMemoFile)
+
+    bool readBlocks(quint32 block, int count, QByteArray *data);
+    QByteArray readBody(quint32 block);
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    Format m_format;
+    int m_blockSize;
+    QCache<quint32, QByteArray> m_cache;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFMEMOFILE_P_H
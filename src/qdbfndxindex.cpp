@@ -0,0 +1,192 @@
+#include "qdbfndxindex_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QtEndian>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int NDX_PAGE_SIZE = 512;
+const int NDX_ROOT_OFFSET = 0;
+const int NDX_NEXT_PAGE_OFFSET = 4;
+const int NDX_KEY_LENGTH_OFFSET = 12;
+const int NDX_KEY_TYPE_OFFSET = 16;
+const int NDX_GROUP_LENGTH_OFFSET = 18;
+const int NDX_UNIQUE_OFFSET = 23;
+const int NDX_EXPRESSION_OFFSET = 24;
+const int NDX_ENTRIES_OFFSET = 4;
+const int NDX_NUMERIC_KEY_LENGTH = 8;
+
+QDbfNdxIndex::QDbfNdxIndex(const QDbfCodec *codec) :
+    QDbfIndexFile(codec),
+    m_rootPage(0),
+    m_nextPage(0),
+    m_groupLength(0),
+    m_numeric(false)
+{
+}
+
+bool QDbfNdxIndex::load(const QString &tagName)
+{
+    Q_UNUSED(tagName)
+
+    char header[NDX_PAGE_SIZE];
+    if (!readBlock(0, header, NDX_PAGE_SIZE)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(header);
+    m_rootPage = qFromLittleEndian<quint32>(data + NDX_ROOT_OFFSET);
+    m_nextPage = qFromLittleEndian<quint32>(data + NDX_NEXT_PAGE_OFFSET);
+    m_keyLength = qFromLittleEndian<quint16>(data + NDX_KEY_LENGTH_OFFSET);
+    m_numeric = qFromLittleEndian<quint16>(data + NDX_KEY_TYPE_OFFSET) != 0;
+    m_keyKind = m_numeric ? NumericKeys : CharacterKeys;
+    m_groupLength = qFromLittleEndian<quint16>(data + NDX_GROUP_LENGTH_OFFSET);
+    m_unique = header[NDX_UNIQUE_OFFSET] != 0;
+    m_expression = headerString(header + NDX_EXPRESSION_OFFSET, NDX_PAGE_SIZE - NDX_EXPRESSION_OFFSET);
+
+    if (m_keyLength <= 0 || m_groupLength < m_keyLength + 8 ||
+        NDX_ENTRIES_OFFSET + 2 * m_groupLength > NDX_PAGE_SIZE ||
+        (m_numeric && m_keyLength != NDX_NUMERIC_KEY_LENGTH)) {
+        qWarning("QDbfNdxIndex::load(): invalid header in %s", qPrintable(fileName()));
+        return false;
+    }
+
+    // pages are only ever appended, never hand out one that is in use
+    const quint32 filePages = static_cast<quint32>((m_file.size() + NDX_PAGE_SIZE - 1) / NDX_PAGE_SIZE);
+    m_nextPage = qMax(m_nextPage, filePages);
+
+    return true;
+}
+
+quint32 QDbfNdxIndex::rootNode() const
+{
+    return m_rootPage;
+}
+
+bool QDbfNdxIndex::readNode(quint32 address, QDbfIndexNode *node)
+{
+    char page[NDX_PAGE_SIZE];
+    if (address == 0 || !readBlock(static_cast<qint64>(address) * NDX_PAGE_SIZE, page, NDX_PAGE_SIZE)) {
+        return false;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(page);
+    const int count = qFromLittleEndian<quint32>(data);
+    const int capacity = (NDX_PAGE_SIZE - NDX_ENTRIES_OFFSET) / m_groupLength;
+
+    // interior pages carry one more child pointer than keys
+    node->leaf = qFromLittleEndian<quint32>(data + NDX_ENTRIES_OFFSET) == 0;
+
+    if (count < 0 || count > capacity || (!node->leaf && count + 1 > capacity)) {
+        return false;
+    }
+
+    node->address = address;
+    node->count = count;
+    node->keys.resize(count * m_keyLength);
+    node->pointers.resize(node->leaf ? count : count + 1);
+
+    for (int i = 0; i < node->pointers.size(); ++i) {
+        const uchar *entry = data + NDX_ENTRIES_OFFSET + i * m_groupLength;
+        node->pointers[i] = qFromLittleEndian<quint32>(entry + (node->leaf ? 4 : 0));
+        if (i < count) {
+            memcpy(node->keys.data() + i * m_keyLength, entry + 8, m_keyLength);
+        }
+    }
+
+    return true;
+}
+
+QByteArray QDbfNdxIndex::encodeNumber(double value) const
+{
+    return doubleKey(value);
+}
+
+QByteArray QDbfNdxIndex::encodeDate(const QDate &date) const
+{
+    return encodeNumber(static_cast<double>(date.toJulianDay()));
+}
+
+int QDbfNdxIndex::compareKeys(const char *key, const char *searchKey, int searchLength) const
+{
+    if (!m_numeric) {
+        return QDbfIndexFile::compareKeys(key, searchKey, searchLength);
+    }
+
+    if (searchLength != NDX_NUMERIC_KEY_LENGTH) {
+        return 1;
+    }
+
+    const double left = keyDouble(key);
+    const double right = keyDouble(searchKey);
+
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+int QDbfNdxIndex::nodeSize() const
+{
+    return NDX_PAGE_SIZE;
+}
+
+int QDbfNdxIndex::nodeLoad(const QDbfIndexNode &node) const
+{
+    return NDX_ENTRIES_OFFSET + (node.leaf ? node.count : node.count + 1) * m_groupLength;
+}
+
+bool QDbfNdxIndex::writeNode(const QDbfIndexNode &node)
+{
+    char page[NDX_PAGE_SIZE];
+    memset(page, 0, NDX_PAGE_SIZE);
+
+    uchar *data = reinterpret_cast<uchar *>(page);
+    qToLittleEndian<quint32>(node.count, data);
+
+    // leaves keep a zero child pointer, interior pages no record number
+    for (int i = 0; i < node.pointers.size(); ++i) {
+        uchar *entry = data + NDX_ENTRIES_OFFSET + i * m_groupLength;
+        qToLittleEndian<quint32>(node.pointers.at(i), entry + (node.leaf ? 4 : 0));
+        if (i < node.count) {
+            memcpy(entry + 8, node.key(i, m_keyLength), m_keyLength);
+        }
+    }
+
+    return writeBlock(static_cast<qint64>(node.address) * NDX_PAGE_SIZE, page, NDX_PAGE_SIZE);
+}
+
+quint32 QDbfNdxIndex::allocateNode()
+{
+    return m_nextPage++;
+}
+
+void QDbfNdxIndex::setRootNode(quint32 address)
+{
+    m_rootPage = address;
+}
+
+bool QDbfNdxIndex::writeHeader()
+{
+    uchar header[8];
+    qToLittleEndian<quint32>(m_rootPage, header + NDX_ROOT_OFFSET);
+    qToLittleEndian<quint32>(m_nextPage, header + NDX_NEXT_PAGE_OFFSET);
+
+    return writeBlock(0, reinterpret_cast<const char *>(header), sizeof(header));
+}
+
+bool QDbfNdxIndex::resetNodes()
+{
+    // the file holds a single key, all of its pages are rebuilt
+    if (!m_file.resize(NDX_PAGE_SIZE)) {
+        return false;
+    }
+
+    m_nextPage = 1;
+
+    return true;
+}
+
+} // namespace Internal
+} // namespace QDbf
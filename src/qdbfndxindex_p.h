@@ -0,0 +1,42 @@
+#ifndef QDBFNDXINDEX_P_H
+#define QDBFNDXINDEX_P_H
+
+#include "qdbfindex_p.h"
+
+namespace QDbf {
+namespace Internal {
+
+// dBASE III single key index: 512 byte pages, numeric and date keys are
+// little-endian doubles (dates as Julian day numbers)
+class QDbfNdxIndex : public QDbfIndexFile
+{
+public:
+    explicit QDbfNdxIndex(const QDbfCodec *codec);
+
+protected:
+    bool load(const QString &tagName);
+    quint32 rootNode() const;
+    bool readNode(quint32 address, QDbfIndexNode *node);
+    QByteArray encodeNumber(double value) const;
+    QByteArray encodeDate(const QDate &date) const;
+    int compareKeys(const char *key, const char *searchKey, int searchLength) const;
+
+    int nodeSize() const;
+    int nodeLoad(const QDbfIndexNode &node) const;
+    bool writeNode(const QDbfIndexNode &node);
+    quint32 allocateNode();
+    void setRootNode(quint32 address);
+    bool writeHeader();
+    bool resetNodes();
+
+private:
+    quint32 m_rootPage;
+    quint32 m_nextPage;
+    int m_groupLength;
+    bool m_numeric;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFNDXINDEX_P_H
@@ -0,0 +1,327 @@
+#include "qdbfnumeric_p.h"
+
+#include <QByteArray>
+
+#include <qnumeric.h>
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const int MAX_MANTISSA_DIGITS = 19;
+const int MAX_EXACT_POWER_OF_TEN = 22;
+const quint64 MAX_EXACT_MANTISSA = Q_UINT64_C(1) << 53;
+const quint64 MAX_SCALED_VALUE = Q_UINT64_C(0x7FFFFFFFFFFFFFFF);
+const int MAX_FORMATTED_LENGTH = 64;
+
+static const quint64 POWERS_OF_TEN[] = {
+    Q_UINT64_C(1),
+    Q_UINT64_C(10),
+    Q_UINT64_C(100),
+    Q_UINT64_C(1000),
+    Q_UINT64_C(10000),
+    Q_UINT64_C(100000),
+    Q_UINT64_C(1000000),
+    Q_UINT64_C(10000000),
+    Q_UINT64_C(100000000),
+    Q_UINT64_C(1000000000),
+    Q_UINT64_C(10000000000),
+    Q_UINT64_C(100000000000),
+    Q_UINT64_C(1000000000000),
+    Q_UINT64_C(10000000000000),
+    Q_UINT64_C(100000000000000),
+    Q_UINT64_C(1000000000000000),
+    Q_UINT64_C(10000000000000000),
+    Q_UINT64_C(100000000000000000),
+    Q_UINT64_C(1000000000000000000),
+    Q_UINT64_C(10000000000000000000)
+};
+
+static const double DOUBLE_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+enum ScanResult {
+    ScanValid = 0,
+    ScanBlank,
+    ScanOverflow,
+    ScanInvalid,
+    // valid text the fast path can not represent exactly (exponent, too many digits)
+    ScanFallback
+};
+
+struct ScannedNumber
+{
+    quint64 mantissa;
+    int fractionDigits;
+    bool negative;
+};
+
+static inline bool isPadding(char c)
+{
+    return c == ' ' || c == '\0';
+}
+
+static ScanResult scanNumber(const char *data, int length, ScannedNumber *number)
+{
+    int i = 0;
+    while (i < length && isPadding(data[i])) {
+        ++i;
+    }
+
+    if (i == length) {
+        return ScanBlank;
+    }
+
+    number->mantissa = 0;
+    number->fractionDigits = 0;
+    number->negative = false;
+
+    if (data[i] == '-') {
+        number->negative = true;
+        ++i;
+    } else if (data[i] == '+') {
+        ++i;
+    }
+
+    int significantDigits = 0;
+    bool hasDigits = false;
+    bool hasPoint = false;
+
+    for (; i < length; ++i) {
+        const char c = data[i];
+        if (c >= '0' && c <= '9') {
+            hasDigits = true;
+            if (hasPoint) {
+                ++number->fractionDigits;
+            }
+            if (significantDigits == 0 && c == '0') {
+                continue;
+            }
+            if (++significantDigits > MAX_MANTISSA_DIGITS) {
+                return ScanFallback;
+            }
+            number->mantissa = number->mantissa * 10 + static_cast<quint64>(c - '0');
+        } else if (c == '.' && !hasPoint) {
+            hasPoint = true;
+        } else {
+            break;
+        }
+    }
+
+    for (; i < length; ++i) {
+        const char c = data[i];
+        if (isPadding(c)) {
+            continue;
+        }
+        if (c == '*') {
+            return ScanOverflow;
+        }
+        if (hasDigits && (c == 'e' || c == 'E')) {
+            return ScanFallback;
+        }
+        return ScanInvalid;
+    }
+
+    return hasDigits ? ScanValid : ScanInvalid;
+}
+
+static NumberStatus parseFallback(const char *data, int length, double *value)
+{
+    bool ok = false;
+    *value = QByteArray::fromRawData(data, length).toDouble(&ok);
+    if (!ok) {
+        *value = 0.0;
+        return NumberInvalid;
+    }
+
+    return NumberValid;
+}
+
+NumberStatus parseNumber(const char *data, int length, double *value)
+{
+    ScannedNumber number;
+
+    switch (scanNumber(data, length, &number)) {
+    case ScanValid:
+        break;
+    case ScanBlank:
+        *value = 0.0;
+        return NumberBlank;
+    case ScanOverflow:
+        *value = 0.0;
+        return NumberOverflow;
+    case ScanInvalid:
+        *value = 0.0;
+        return NumberInvalid;
+    case ScanFallback:
+        return parseFallback(data, length, value);
+    }
+
+    if (number.mantissa > MAX_EXACT_MANTISSA ||
+        number.fractionDigits > MAX_EXACT_POWER_OF_TEN) {
+        return parseFallback(data, length, value);
+    }
+
+    // both operands are exact, so the single division is correctly rounded
+    double result = static_cast<double>(number.mantissa);
+    if (number.fractionDigits > 0) {
+        result /= DOUBLE_POWERS_OF_TEN[number.fractionDigits];
+    }
+
+    *value = number.negative ? -result : result;
+
+    return NumberValid;
+}
+
+NumberStatus parseScaledNumber(const char *data, int length, int scale, qint64 *value)
+{
+    *value = 0;
+
+    if (scale < 0 || scale > MAX_MANTISSA_DIGITS - 1) {
+        return NumberInvalid;
+    }
+
+    ScannedNumber number;
+
+    switch (scanNumber(data, length, &number)) {
+    case ScanValid:
+        break;
+    case ScanBlank:
+        return NumberBlank;
+    case ScanOverflow:
+        return NumberOverflow;
+    case ScanInvalid:
+        return NumberInvalid;
+    case ScanFallback: {
+        double result = 0.0;
+        if (parseFallback(data, length, &result) != NumberValid) {
+            return NumberInvalid;
+        }
+        const double scaled = result * DOUBLE_POWERS_OF_TEN[scale];
+        if (scaled >= 9.2e18 || scaled <= -9.2e18) {
+            return NumberOverflow;
+        }
+        *value = qRound64(scaled);
+        return NumberValid; }
+    }
+
+    quint64 scaled = number.mantissa;
+
+    if (number.fractionDigits <= scale) {
+        const quint64 factor = POWERS_OF_TEN[scale - number.fractionDigits];
+        if (scaled > MAX_SCALED_VALUE / factor) {
+            return NumberOverflow;
+        }
+        scaled *= factor;
+    } else {
+        // more decimals than the field precision, round half away from zero
+        const int droppedDigits = number.fractionDigits - scale;
+        if (droppedDigits > MAX_MANTISSA_DIGITS) {
+            scaled = 0;
+        } else {
+            const quint64 divisor = POWERS_OF_TEN[droppedDigits];
+            const quint64 remainder = scaled % divisor;
+            scaled /= divisor;
+            if (remainder >= divisor - remainder) {
+                ++scaled;
+            }
+        }
+    }
+
+    if (scaled > MAX_SCALED_VALUE) {
+        return NumberOverflow;
+    }
+
+    *value = number.negative ? -static_cast<qint64>(scaled) : static_cast<qint64>(scaled);
+
+    return NumberValid;
+}
+
+int parseDigits(const char *data, int length)
+{
+    int value = 0;
+    for (int i = 0; i < length; ++i) {
+        const char c = data[i];
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+
+    return value;
+}
+
+bool formatNumber(double value, int precision, char *out, int length)
+{
+    if (length <= 0) {
+        return true;
+    }
+
+    if (!qIsFinite(value)) {
+        memset(out, '*', length);
+        return false;
+    }
+
+    precision = qMax(0, precision);
+
+    char buffer[MAX_FORMATTED_LENGTH];
+    char *end = buffer + MAX_FORMATTED_LENGTH;
+    const char *begin = 0;
+    int size = 0;
+
+    const double magnitude = precision <= MAX_EXACT_POWER_OF_TEN ?
+                qAbs(value) * DOUBLE_POWERS_OF_TEN[precision] : 0.0;
+
+    if (precision <= MAX_EXACT_POWER_OF_TEN && magnitude < static_cast<double>(MAX_SCALED_VALUE)) {
+        quint64 scaled = static_cast<quint64>(magnitude + 0.5);
+        const bool negative = value < 0 && scaled != 0;
+
+        char *p = end;
+        for (int i = 0; i < precision; ++i) {
+            *--p = static_cast<char>('0' + scaled % 10);
+            scaled /= 10;
+        }
+        if (precision > 0) {
+            *--p = '.';
+        }
+        do {
+            *--p = static_cast<char>('0' + scaled % 10);
+            scaled /= 10;
+        } while (scaled != 0);
+        if (negative) {
+            *--p = '-';
+        }
+
+        begin = p;
+        size = static_cast<int>(end - p);
+    } else {
+        size = qsnprintf(buffer, MAX_FORMATTED_LENGTH, "%.*f", precision, value);
+        if (size < 0 || size >= MAX_FORMATTED_LENGTH) {
+            size = length + 1;
+        }
+        begin = buffer;
+    }
+
+    if (size > length) {
+        memset(out, '*', length);
+        return false;
+    }
+
+    memset(out, ' ', length - size);
+    memcpy(out + length - size, begin, size);
+
+    return true;
+}
+
+void formatDigits(int value, char *out, int length)
+{
+    for (int i = length - 1; i >= 0; --i) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+}
+
+} // namespace Internal
+} // namespace QDbf
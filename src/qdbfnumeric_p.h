@@ -0,0 +1,32 @@
+#ifndef QDBFNUMERIC_P_H
+#define QDBFNUMERIC_P_H
+
+#include <QtGlobal>
+
+namespace QDbf {
+namespace Internal {
+
+enum NumberStatus {
+    NumberValid = 0,
+    NumberBlank,
+    NumberOverflow,
+    NumberInvalid
+};
+
+// Parsers for the right-justified ASCII numbers stored in N and F fields.
+// They work in place on the record bytes; '*' filled fields are reported
+// as NumberOverflow and space filled ones as NumberBlank.
+NumberStatus parseNumber(const char *data, int length, double *value);
+NumberStatus parseScaledNumber(const char *data, int length, int scale, qint64 *value);
+
+int parseDigits(const char *data, int length);
+
+// Formatters writing exactly length bytes. Numbers are right-justified in
+// fixed-point notation and fill the field with '*' when they do not fit.
+bool formatNumber(double value, int precision, char *out, int length);
+void formatDigits(int value, char *out, int length);
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFNUMERIC_P_H
@@ -0,0 +1,212 @@
+#include "qdbfreader_p.h"
+
+#include "qdbfmemofile_p.h"
+#include "qdbfschema_p.h"
+#include "qdbftable_p.h"
+
+namespace QDbf {
+namespace Internal {
+
+QDbfReader::QDbfReader() :
+    m_error(QDbfTable::NoError),
+    m_mappedData(0),
+    m_mappedSize(0),
+    m_schema(0),
+    m_tableSchema(0),
+    m_memo(0),
+    m_codec(0),
+    m_headerLength(0),
+    m_recordLength(0),
+    m_recordsCount(0),
+    m_bufferSize(0),
+    m_bufferFirstIndex(0),
+    m_bufferCount(0)
+{
+}
+
+QDbfReader::~QDbfReader()
+{
+    close();
+}
+
+bool QDbfReader::open(const QDbfTablePrivate *table)
+{
+    close();
+
+    if (!table->isOpen() || table->m_recordLength <= 0) {
+        m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    m_file.setFileName(table->m_file.fileName());
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    m_headerLength = table->m_headerLength;
+    m_recordLength = table->m_recordLength;
+    m_recordsCount = table->m_recordsCount;
+    m_bufferSize = table->m_readBufferSize;
+    m_codec = table->m_codec;
+    m_record = table->m_record;
+    m_schema = table->m_schema;
+    if (m_schema) {
+        m_schema->ref.ref();
+    }
+    m_tableSchema = table->m_tableSchema;
+    if (m_tableSchema) {
+        m_tableSchema->ref.ref();
+    }
+    m_memo = table->m_memo;
+    if (m_memo) {
+        m_memo->ref.ref();
+    }
+
+    if (table->m_openOptions & QDbfTable::MemoryMapped) {
+        const qint64 fileSize = m_file.size();
+        // on failure records are read through the file handle
+        m_mappedData = fileSize > 0 ? m_file.map(0, fileSize) : 0;
+        m_mappedSize = m_mappedData ? fileSize : 0;
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+void QDbfReader::close()
+{
+    if (m_mappedData) {
+        m_file.unmap(m_mappedData);
+    }
+    m_mappedData = 0;
+    m_mappedSize = 0;
+
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    if (m_schema && !m_schema->ref.deref()) {
+        delete m_schema;
+    }
+    m_schema = 0;
+
+    if (m_tableSchema && !m_tableSchema->ref.deref()) {
+        delete m_tableSchema;
+    }
+    m_tableSchema = 0;
+
+    if (m_memo && !m_memo->ref.deref()) {
+        delete m_memo;
+    }
+    m_memo = 0;
+
+    m_record = QDbfRecord();
+    m_buffer.clear();
+    m_bufferFirstIndex = 0;
+    m_bufferCount = 0;
+    m_recordsCount = 0;
+}
+
+bool QDbfReader::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QDbfTable::DbfTableError QDbfReader::error() const
+{
+    return m_error;
+}
+
+int QDbfReader::size() const
+{
+    return m_recordsCount;
+}
+
+int QDbfReader::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+const char *QDbfReader::recordPointer(int index)
+{
+    if (index < 0 || index >= m_recordsCount) {
+        m_error = QDbfTable::UnspecifiedError;
+        return 0;
+    }
+
+    const qint64 position = m_headerLength + static_cast<qint64>(m_recordLength) * index;
+
+    if (m_mappedData && position + m_recordLength <= m_mappedSize) {
+        return reinterpret_cast<const char *>(m_mappedData + position);
+    }
+
+    if (index >= m_bufferFirstIndex && index < m_bufferFirstIndex + m_bufferCount) {
+        return m_buffer.constData() + (index - m_bufferFirstIndex) * m_recordLength;
+    }
+
+    // refill the window starting at index, or ending at it when walking backwards
+    const int windowCount = qMax(1, m_bufferSize / m_recordLength);
+    int firstIndex = index;
+    if (m_bufferCount > 0 && index == m_bufferFirstIndex - 1) {
+        firstIndex = qMax(0, index - windowCount + 1);
+    }
+    const int count = qMax(1, qMin(windowCount, m_recordsCount - firstIndex));
+
+    m_bufferCount = 0;
+
+    if (!m_file.seek(m_headerLength + static_cast<qint64>(m_recordLength) * firstIndex)) {
+        m_error = QDbfTable::ReadError;
+        return 0;
+    }
+
+    m_buffer.resize(count * m_recordLength);
+    const qint64 bytesRead = m_file.read(m_buffer.data(), m_buffer.size());
+    const int recordsRead = bytesRead > 0 ? static_cast<int>(bytesRead / m_recordLength) : 0;
+
+    if (index - firstIndex >= recordsRead) {
+        m_error = QDbfTable::ReadError;
+        return 0;
+    }
+
+    m_bufferFirstIndex = firstIndex;
+    m_bufferCount = recordsRead;
+
+    return m_buffer.constData() + (index - firstIndex) * m_recordLength;
+}
+
+QDbfRecordView QDbfReader::recordView(int index)
+{
+    const char *data = recordPointer(index);
+    if (!data) {
+        return QDbfRecordView();
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return QDbfRecordView(m_schema, m_codec, data, index);
+}
+
+QDbfRecord QDbfReader::record(int index)
+{
+    QDbfRecord record(m_record);
+
+    const char *data = recordPointer(index);
+    if (!data) {
+        return record;
+    }
+
+    record.setRecordIndex(index);
+    record.setDeleted(data[0] == '*');
+
+    // fields are decoded by QDbfRecord on first access
+    record.setRawData(QByteArray(data, m_recordLength), m_codec, m_memo);
+
+    m_error = QDbfTable::NoError;
+
+    return record;
+}
+
+} // namespace Internal
+} // namespace QDbf
@@ -0,0 +1,71 @@
+#ifndef QDBFREADER_P_H
+#define QDBFREADER_P_H
+
+#include "qdbfrecord.h"
+#include "qdbfrecordview.h"
+#include "qdbftable.h"
+
+#include <QByteArray>
+#include <QFile>
+
+namespace QDbf {
+namespace Internal {
+
+class QDbfCodec;
+class QDbfMemoFile;
+class QDbfSchema;
+class QDbfTablePrivate;
+
+// Read-only access to the records of an open table through a file handle
+// (or mapping) of its own, so that several readers never share a file
+// position. A reader sees the records that existed when it was opened.
+class QDbfReader
+{
+public:
+    QDbfReader();
+    ~QDbfReader();
+
+    bool open(const QDbfTablePrivate *table);
+    void close();
+    bool isOpen() const;
+
+    QDbfTable::DbfTableError error() const;
+
+    int size() const;
+    int bufferSize() const;
+
+    inline const QDbfSchema *schema() const { return m_schema; }
+    inline const QDbfSchema *tableSchema() const { return m_tableSchema; }
+    inline const QDbfCodec *codec() const { return m_codec; }
+    inline QDbfMemoFile *memoFile() const { return m_memo; }
+
+    const char *recordPointer(int index);
+    QDbfRecordView recordView(int index);
+    QDbfRecord record(int index);
+    inline const QDbfRecord &emptyRecord() const { return m_record; }
+
+private:
+    Q_DISABLE_COPY(QDbfReader)
+
+    QFile m_file;
+    QDbfTable::DbfTableError m_error;
+    uchar *m_mappedData;
+    qint64 m_mappedSize;
+    QDbfSchema *m_schema;
+    QDbfSchema *m_tableSchema;
+    QDbfMemoFile *m_memo;
+    const QDbfCodec *m_codec;
+    QDbfRecord m_record;
+    qint16 m_headerLength;
+    qint16 m_recordLength;
+    int m_recordsCount;
+    int m_bufferSize;
+    QByteArray m_buffer;
+    int m_bufferFirstIndex;
+    int m_bufferCount;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFREADER_P_H
@@ -1,8 +1,15 @@
 #include "qdbffield.h"
 
+#include "qdbfcodec_p.h"
+#include "qdbfmemofile_p.h"
+#include "qdbfnumeric_p.h"
 #include "qdbfrecord.h"
+#include "qdbfschema_p.h"
 
+#include <QBitArray>
+#include <QDate>
 #include <QDebug>
+#include <QMutex>
 #include <QVariant>
 #include <QVector>
 
@@ -14,19 +21,37 @@ class QDbfRecordPrivate
 public:
     QDbfRecordPrivate();
     QDbfRecordPrivate(const QDbfRecordPrivate &other);
+    ~QDbfRecordPrivate();
 
-    inline bool contains(int index) { return index >= 0 && index < m_fields.count(); }
+    inline bool contains(int index) const { return index >= 0 && index < m_fields.count(); }
+
+    QDbfField decodedField(int index) const;
+    void decode(int index) const;
+    void decodeAll();
+    void setSchema(QDbfSchema *schema);
+    void setMemoFile(QDbfMemoFile *memo);
 
     QAtomicInt ref;
     int m_index;
     bool m_isDeleted;
-    QVector<QDbfField> m_fields;
+    // values are decoded on first access from const methods, the mutex keeps
+    // copies sharing this object consistent across threads
+    mutable QMutex m_mutex;
+    mutable QVector<QDbfField> m_fields;
+    QByteArray m_data;
+    const QDbfCodec *m_codec;
+    mutable QBitArray m_decoded;
+    QDbfSchema *m_schema;
+    QDbfMemoFile *m_memo;
 };
 
 QDbfRecordPrivate::QDbfRecordPrivate() :
     ref(1),
     m_index(-1),
-    m_isDeleted(false)
+    m_isDeleted(false),
+    m_codec(0),
+    m_schema(0),
+    m_memo(0)
 {
 }
 
@@ -34,8 +59,136 @@ QDbfRecordPrivate::QDbfRecordPrivate(const QDbfRecordPrivate &other) :
     ref(1),
     m_index(other.m_index),
     m_isDeleted(other.m_isDeleted),
-    m_fields(other.m_fields)
+    m_codec(other.m_codec),
+    m_schema(other.m_schema),
+    m_memo(other.m_memo)
+{
+    QMutexLocker locker(&other.m_mutex);
+    m_fields = other.m_fields;
+    m_data = other.m_data;
+    m_decoded = other.m_decoded;
+
+    if (m_schema) {
+        m_schema->ref.ref();
+    }
+    if (m_memo) {
+        m_memo->ref.ref();
+    }
+}
+
+QDbfRecordPrivate::~QDbfRecordPrivate()
+{
+    setSchema(0);
+    setMemoFile(0);
+}
+
+void QDbfRecordPrivate::setSchema(QDbfSchema *schema)
+{
+    if (schema) {
+        schema->ref.ref();
+    }
+
+    if (m_schema && !m_schema->ref.deref()) {
+        delete m_schema;
+    }
+
+    m_schema = schema;
+}
+
+void QDbfRecordPrivate::setMemoFile(QDbfMemoFile *memo)
+{
+    if (memo) {
+        memo->ref.ref();
+    }
+
+    if (m_memo && !m_memo->ref.deref()) {
+        delete m_memo;
+    }
+
+    m_memo = memo;
+}
+
+QDbfField QDbfRecordPrivate::decodedField(int index) const
+{
+    QMutexLocker locker(&m_mutex);
+    decode(index);
+    return m_fields.value(index);
+}
+
+// callers hold m_mutex or own the only reference to this object
+void QDbfRecordPrivate::decode(int index) const
+{
+    if (m_data.isEmpty() || !contains(index) || m_decoded.testBit(index)) {
+        return;
+    }
+
+    m_decoded.setBit(index);
+
+    QDbfField &field = m_fields[index];
+
+    if (field.offset() < 0 || field.length() < 0 ||
+        field.offset() + field.length() > m_data.size()) {
+        field.setValue(QVariant::Invalid);
+        return;
+    }
+
+    const QByteArray byteArray = QByteArray::fromRawData(m_data.constData() + field.offset(),
+                                                         field.length());
+    QVariant value;
+
+    // memo bodies are read from the memo file only now
+    if (field.dbfType() == QDbfField::Memo) {
+        if (m_memo) {
+            const QByteArray body = m_memo->read(QDbfMemoFile::blockNumber(byteArray.constData(),
+                                                                           byteArray.size()));
+            value = m_codec->toUnicode(body.constData(), body.size());
+        }
+        field.setValue(value);
+        return;
+    }
+
+    switch (field.type()) {
+    case QVariant::String:
+        value = m_codec->toUnicode(byteArray.constData(), byteArray.size());
+        break;
+    case QVariant::Date:
+        value = QVariant(QDate(byteArray.mid(0, 4).toInt(),
+                               byteArray.mid(4, 2).toInt(),
+                               byteArray.mid(6, 2).toInt()));
+        break;
+    case QVariant::Double: {
+        double number = 0.0;
+        parseNumber(byteArray.constData(), byteArray.size(), &number);
+        value = number;
+        break; }
+    case QVariant::Bool: {
+        QString val = QString::fromLatin1(byteArray.toUpper());
+        if (val == QLatin1String("T") ||
+            val == QLatin1String("Y")) {
+            value = true;
+        } else {
+            value = false;
+        }
+        break; }
+    default:
+        value = QVariant::Invalid;
+    }
+
+    field.setValue(value);
+}
+
+void QDbfRecordPrivate::decodeAll()
 {
+    if (m_data.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0; i < m_fields.count(); ++i) {
+        decode(i);
+    }
+
+    m_data.clear();
+    m_decoded.clear();
 }
 
 } // namespace Internal
@@ -60,9 +213,18 @@ QDbfRecord &QDbfRecord::operator=(const QDbfRecord &other)
 
 bool QDbfRecord::operator==(const QDbfRecord &other) const
 {
-    return (recordIndex() == other.recordIndex() &&
-            isDeleted() == other.isDeleted() &&
-            d->m_fields == other.d->m_fields);
+    if (recordIndex() != other.recordIndex() || isDeleted() != other.isDeleted() ||
+        count() != other.count()) {
+        return false;
+    }
+
+    for (int i = 0; i < count(); ++i) {
+        if (d->decodedField(i) != other.d->decodedField(i)) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 QDbfRecord::~QDbfRecord()
@@ -74,6 +236,7 @@ QDbfRecord::~QDbfRecord()
 
 void QDbfRecord::setRecordIndex(int index)
 {
+    detach();
     d->m_index = index;
 }
 
@@ -89,12 +252,15 @@ void QDbfRecord::setValue(int index, const QVariant &val)
     }
 
     detach();
+    if (!d->m_data.isEmpty()) {
+        d->m_decoded.setBit(index);
+    }
     d->m_fields[index].setValue(val);
 }
 
 QVariant QDbfRecord::value(int index) const
 {
-    return d->m_fields.value(index).value();
+    return d->decodedField(index).value();
 }
 
 void QDbfRecord::setValue(const QString &name, const QVariant &val)
@@ -114,12 +280,15 @@ void QDbfRecord::setNull(int index)
     }
 
     detach();
+    if (!d->m_data.isEmpty()) {
+        d->m_decoded.setBit(index);
+    }
     d->m_fields[index].clear();
 }
 
 bool QDbfRecord::isNull(int index) const
 {
-    return d->m_fields.value(index).isNull();
+    return d->decodedField(index).isNull();
 }
 
 void QDbfRecord::setNull(const QString &name)
@@ -134,6 +303,10 @@ bool QDbfRecord::isNull(const QString &name) const
 
 int QDbfRecord::indexOf(const QString &name) const
 {
+    if (d->m_schema) {
+        return d->m_schema->indexOf(name);
+    }
+
     QString nm = name.toUpper();
 
     for (int i = 0; i < count(); ++i) {
@@ -150,7 +323,7 @@ QString QDbfRecord::fieldName(int index) const
 
 QDbfField QDbfRecord::field(int index) const
 {
-    return d->m_fields.value(index);
+    return d->decodedField(index);
 }
 
 QDbfField QDbfRecord::field(const QString &name) const
@@ -161,6 +334,8 @@ QDbfField QDbfRecord::field(const QString &name) const
 void QDbfRecord::append(const QDbfField &field)
 {
     detach();
+    d->decodeAll();
+    d->setSchema(0);
     d->m_fields.append(field);
 }
 
@@ -171,12 +346,16 @@ void QDbfRecord::replace(int pos, const QDbfField &field)
     }
 
     detach();
+    d->decodeAll();
+    d->setSchema(0);
     d->m_fields[pos] = field;
 }
 
 void QDbfRecord::insert(int pos, const QDbfField &field)
 {
     detach();
+    d->decodeAll();
+    d->setSchema(0);
     d->m_fields.insert(pos, field);
 }
 
@@ -187,6 +366,8 @@ void QDbfRecord::remove(int pos)
     }
 
     detach();
+    d->decodeAll();
+    d->setSchema(0);
     d->m_fields.remove(pos);
 }
 
@@ -214,12 +395,17 @@ bool QDbfRecord::contains(const QString &name) const
 void QDbfRecord::clear()
 {
     detach();
+    d->setSchema(0);
     d->m_fields.clear();
+    d->m_data.clear();
+    d->m_decoded.clear();
 }
 
 void QDbfRecord::clearValues()
 {
     detach();
+    d->m_data.clear();
+    d->m_decoded.clear();
     int count = d->m_fields.count();
     for (int i = 0; i < count; ++i) {
         d->m_fields[i].clear();
@@ -236,6 +422,22 @@ void QDbfRecord::detach()
     qAtomicDetach(d);
 }
 
+void QDbfRecord::setRawData(const QByteArray &data, const Internal::QDbfCodec *codec,
+                            Internal::QDbfMemoFile *memo)
+{
+    detach();
+    d->m_data = data;
+    d->m_codec = codec;
+    d->setMemoFile(memo);
+    d->m_decoded.fill(false, d->m_fields.count());
+}
+
+void QDbfRecord::setSchema(Internal::QDbfSchema *schema)
+{
+    detach();
+    d->setSchema(schema);
+}
+
 } // namespace QDbf
 
 QDebug operator<<(QDebug debug, const QDbf::QDbfRecord &record)
@@ -4,13 +4,19 @@
 #include "qdbf_global.h"
 
 QT_BEGIN_NAMESPACE
+class QByteArray;
 class QString;
 class QVariant;
 QT_END_NAMESPACE
 
 namespace QDbf {
 namespace Internal {
+class QDbfCodec;
+class QDbfMemoFile;
+class QDbfReader;
 class QDbfRecordPrivate;
+class QDbfSchema;
+class QDbfTablePrivate;
 }
 
 class QDbfField;
@@ -64,6 +70,12 @@ public:
 private:
     Internal::QDbfRecordPrivate *d;
     void detach();
+    void setRawData(const QByteArray &data, const Internal::QDbfCodec *codec,
+                    Internal::QDbfMemoFile *memo = 0);
+    void setSchema(Internal::QDbfSchema *schema);
+
+    friend class Internal::QDbfReader;
+    friend class Internal::QDbfTablePrivate;
 };
 
 } // namespace QDbf
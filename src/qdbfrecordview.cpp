@@ -0,0 +1,187 @@
+#include "qdbfrecordview.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfschema_p.h"
+
+#include <QByteArray>
+#include <QDate>
+#include <QString>
+
+namespace QDbf {
+
+QDbfRecordView::QDbfRecordView() :
+    m_schema(0),
+    m_codec(0),
+    m_data(0),
+    m_index(-1)
+{
+}
+
+QDbfRecordView::QDbfRecordView(const Internal::QDbfSchema *schema, const Internal::QDbfCodec *codec,
+                               const char *data, int index) :
+    m_schema(schema),
+    m_codec(codec),
+    m_data(data),
+    m_index(index)
+{
+}
+
+bool QDbfRecordView::isValid() const
+{
+    return m_data != 0;
+}
+
+int QDbfRecordView::recordIndex() const
+{
+    return m_index;
+}
+
+bool QDbfRecordView::isDeleted() const
+{
+    return m_data && m_data[0] == '*';
+}
+
+int QDbfRecordView::count() const
+{
+    return m_schema ? m_schema->count() : 0;
+}
+
+int QDbfRecordView::indexOf(const QString &name) const
+{
+    return m_schema ? m_schema->indexOf(name) : -1;
+}
+
+QDbfField::QDbfType QDbfRecordView::fieldType(int i) const
+{
+    if (i < 0 || i >= count()) {
+        return QDbfField::UnknownDataType;
+    }
+
+    return m_schema->m_types.at(i);
+}
+
+const char *QDbfRecordView::data() const
+{
+    return m_data;
+}
+
+int QDbfRecordView::length() const
+{
+    return m_data ? m_schema->m_recordLength : 0;
+}
+
+const char *QDbfRecordView::fieldData(int i) const
+{
+    if (!m_data || i < 0 || i >= count()) {
+        return 0;
+    }
+
+    return m_data + m_schema->m_offsets.at(i);
+}
+
+int QDbfRecordView::fieldLength(int i) const
+{
+    if (!m_data || i < 0 || i >= count()) {
+        return 0;
+    }
+
+    return m_schema->m_lengths.at(i);
+}
+
+QByteArray QDbfRecordView::rawValue(int i) const
+{
+    const char *data = fieldData(i);
+    if (!data) {
+        return QByteArray();
+    }
+
+    return QByteArray::fromRawData(data, fieldLength(i));
+}
+
+QString QDbfRecordView::toString(int i) const
+{
+    const char *data = fieldData(i);
+    if (!data) {
+        return QString();
+    }
+
+    return m_codec->toUnicode(data, fieldLength(i));
+}
+
+bool QDbfRecordView::toUnicode(QString *buffer) const
+{
+    // with a single-byte codepage field offsets carry over to the converted text
+    if (!m_data || !m_codec->isSingleByte()) {
+        return false;
+    }
+
+    const int recordLength = length();
+    buffer->resize(recordLength);
+    m_codec->convert(m_data, recordLength, reinterpret_cast<ushort *>(buffer->data()));
+
+    return true;
+}
+
+double QDbfRecordView::toDouble(int i, bool *ok) const
+{
+    double value = 0.0;
+    const Internal::NumberStatus status = Internal::parseNumber(fieldData(i), fieldLength(i), &value);
+
+    if (ok) {
+        *ok = (status == Internal::NumberValid);
+    }
+
+    return value;
+}
+
+qint64 QDbfRecordView::toScaledInteger(int i, bool *ok) const
+{
+    qint64 value = 0;
+    const int scale = (i >= 0 && i < count()) ? qMax(0, m_schema->m_precisions.at(i)) : 0;
+    const Internal::NumberStatus status = Internal::parseScaledNumber(fieldData(i), fieldLength(i),
+                                                                      scale, &value);
+
+    if (ok) {
+        *ok = (status == Internal::NumberValid);
+    }
+
+    return value;
+}
+
+QDate QDbfRecordView::toDate(int i) const
+{
+    const char *data = fieldData(i);
+    if (!data || fieldLength(i) < 8) {
+        return QDate();
+    }
+
+    const int year = Internal::parseDigits(data, 4);
+    const int month = Internal::parseDigits(data + 4, 2);
+    const int day = Internal::parseDigits(data + 6, 2);
+    if (year < 0 || month < 0 || day < 0) {
+        return QDate();
+    }
+
+    return QDate(year, month, day);
+}
+
+bool QDbfRecordView::toBool(int i) const
+{
+    const char *data = fieldData(i);
+    if (!data || fieldLength(i) < 1) {
+        return false;
+    }
+
+    switch (data[0]) {
+    case 'T':
+    case 't':
+    case 'Y':
+    case 'y':
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace QDbf
@@ -0,0 +1,65 @@
+#ifndef QDBFRECORDVIEW_H
+#define QDBFRECORDVIEW_H
+
+#include "qdbf_global.h"
+#include "qdbffield.h"
+
+QT_BEGIN_NAMESPACE
+class QByteArray;
+class QDate;
+class QString;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfCodec;
+class QDbfReader;
+class QDbfSchema;
+class QDbfTablePrivate;
+} // namespace Internal
+
+// Non-owning view of the raw bytes of one record. It stays valid until the
+// table it was taken from moves to another read window, is written or closed.
+class QDBF_EXPORT QDbfRecordView
+{
+public:
+    QDbfRecordView();
+
+    bool isValid() const;
+    int recordIndex() const;
+    bool isDeleted() const;
+
+    int count() const;
+    int indexOf(const QString &name) const;
+    QDbfField::QDbfType fieldType(int i) const;
+
+    const char *data() const;
+    int length() const;
+
+    const char *fieldData(int i) const;
+    int fieldLength(int i) const;
+    QByteArray rawValue(int i) const;
+
+    QString toString(int i) const;
+    bool toUnicode(QString *buffer) const;
+    double toDouble(int i, bool *ok = 0) const;
+    qint64 toScaledInteger(int i, bool *ok = 0) const;
+    QDate toDate(int i) const;
+    bool toBool(int i) const;
+
+private:
+    QDbfRecordView(const Internal::QDbfSchema *schema, const Internal::QDbfCodec *codec,
+                   const char *data, int index);
+
+    const Internal::QDbfSchema *m_schema;
+    const Internal::QDbfCodec *m_codec;
+    const char *m_data;
+    int m_index;
+
+    friend class Internal::QDbfReader;
+    friend class Internal::QDbfTablePrivate;
+};
+
+} // namespace QDbf
+
+#endif // QDBFRECORDVIEW_H
@@ -0,0 +1,126 @@
+#include "qdbfschema_p.h"
+
+#include "qdbfrecord.h"
+
+namespace QDbf {
+namespace Internal {
+
+QDbfSchema::QDbfSchema(const QDbfRecord &record, int recordLength) :
+    ref(1),
+    m_recordLength(recordLength),
+    m_mask(0)
+{
+    const int count = record.count();
+
+    m_names.reserve(count);
+    m_offsets.reserve(count);
+    m_lengths.reserve(count);
+    m_precisions.reserve(count);
+    m_types.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        const QDbfField field = record.field(i);
+        m_names.append(field.name());
+        m_offsets.append(field.offset());
+        m_lengths.append(field.length());
+        m_precisions.append(field.precision());
+        m_types.append(field.dbfType());
+    }
+
+    // open addressing table with a load factor of at most one half,
+    // buckets hold the field index plus one so that zero means empty
+    int bucketsCount = 8;
+    while (bucketsCount < count * 2) {
+        bucketsCount *= 2;
+    }
+
+    m_buckets.fill(0, bucketsCount);
+    m_mask = static_cast<uint>(bucketsCount - 1);
+
+    for (int i = 0; i < count; ++i) {
+        if (indexOf(m_names.at(i)) >= 0) {
+            // duplicated names resolve to the first field like QDbfRecord::indexOf()
+            continue;
+        }
+
+        uint bucket = hash(m_names.at(i)) & m_mask;
+        while (m_buckets.at(bucket) != 0) {
+            bucket = (bucket + 1) & m_mask;
+        }
+        m_buckets[bucket] = i + 1;
+    }
+}
+
+int QDbfSchema::indexOf(const QString &name) const
+{
+    uint bucket = hash(name) & m_mask;
+
+    for (;;) {
+        const int index = m_buckets.at(bucket) - 1;
+        if (index < 0) {
+            return -1;
+        }
+
+        if (QString::compare(m_names.at(index), name, Qt::CaseInsensitive) == 0) {
+            return index;
+        }
+
+        bucket = (bucket + 1) & m_mask;
+    }
+}
+
+uint QDbfSchema::hash(const QString &name)
+{
+    const QChar *data = name.constData();
+    const int length = name.length();
+
+    uint h = 0;
+    for (int i = 0; i < length; ++i) {
+        h = 31 * h + data[i].toUpper().unicode();
+    }
+
+    return h;
+}
+
+char typeCharacter(QDbfField::QDbfType type)
+{
+    switch (type) {
+    case QDbfField::Character:
+        return 'C';
+    case QDbfField::Date:
+        return 'D';
+    case QDbfField::FloatingPoint:
+        return 'F';
+    case QDbfField::Logical:
+        return 'L';
+    case QDbfField::Number:
+        return 'N';
+    case QDbfField::Memo:
+        return 'M';
+    default:
+        return ' ';
+    }
+}
+
+QDbfField::QDbfType typeFromCharacter(char character)
+{
+    switch (character) {
+    case 'C':
+        return QDbfField::Character;
+    case 'D':
+        return QDbfField::Date;
+    case 'F':
+        return QDbfField::FloatingPoint;
+    case 'L':
+        return QDbfField::Logical;
+    case 'N':
+        return QDbfField::Number;
+    case 'M':
+        return QDbfField::Memo;
+    default:
+        return QDbfField::UnknownDataType;
+    }
+}
+
+} // namespace Internal
+} // namespace QDbf
@@ -0,0 +1,44 @@
+#ifndef QDBFSCHEMA_P_H
+#define QDBFSCHEMA_P_H
+
+#include "qdbffield.h"
+
+#include <QString>
+#include <QVector>
+
+namespace QDbf {
+
+class QDbfRecord;
+
+namespace Internal {
+
+class QDbfSchema
+{
+public:
+    QDbfSchema(const QDbfRecord &record, int recordLength);
+
+    inline int count() const { return m_offsets.count(); }
+    int indexOf(const QString &name) const;
+
+    static uint hash(const QString &name);
+
+    QAtomicInt ref;
+    int m_recordLength;
+    QVector<QString> m_names;
+    QVector<int> m_offsets;
+    QVector<int> m_lengths;
+    QVector<int> m_precisions;
+    QVector<QDbfField::QDbfType> m_types;
+    QVector<int> m_buckets;
+    uint m_mask;
+};
+
+// dBASE type letters of the field types ('C', 'D', 'F', 'L', 'N' and 'M'),
+// what the sidecar index files store instead of the enum values
+char typeCharacter(QDbfField::QDbfType type);
+QDbfField::QDbfType typeFromCharacter(char character);
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFSCHEMA_P_H
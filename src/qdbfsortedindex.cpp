@@ -0,0 +1,875 @@
+#include "qdbfsortedindex.h"
+
+#include "qdbfcodec_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfrecordview.h"
+#include "qdbfschema_p.h"
+#include "qdbftable_p.h"
+
+#include <QDate>
+#include <QDebug>
+#include <QFile>
+#include <QVariant>
+#include <QVector>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace QDbf {
+namespace Internal {
+
+const char SORTED_INDEX_MAGIC[] = "QDBFSIX1";
+const int SORTED_INDEX_MAGIC_LENGTH = 8;
+const int SORTED_INDEX_VERSION = 2;
+const int SORTED_INDEX_FIELDS_OFFSET = 32;
+const int SORTED_INDEX_FIELD_LENGTH = 20;
+const int SORTED_INDEX_FIELD_NAME_LENGTH = 11;
+const int SORTED_INDEX_MAX_FIELDS = 8;
+const int SORTED_INDEX_RUNS_OFFSET = 192;
+const int SORTED_INDEX_MAX_RUNS = 32;
+const int SORTED_INDEX_DATA_OFFSET = 512;
+const int RECORD_INDEX_LENGTH = 4;
+const int NUMBER_KEY_LENGTH = 8;
+const int DATE_LENGTH = 8;
+
+class QDbfSortedIndexPrivate
+{
+public:
+    struct Field
+    {
+        QString name;
+        QDbfField::QDbfType type;
+        int offset;
+        int length;
+        int precision;
+        int keyOffset;
+        int keyLength;
+    };
+
+    // entries [first, first + count) of the data area, sorted on their own
+    struct Run
+    {
+        int first;
+        int count;
+    };
+
+    QDbfSortedIndexPrivate();
+
+    void reset();
+    bool addField(const QDbfRecord &record, const QString &name);
+    bool checkFields(const QDbfRecord &record) const;
+    void encodeRecord(const char *record, char *key) const;
+    int encodeValue(const QVariant &value, char *key) const;
+
+    bool map();
+    void unmap();
+    bool readHeader();
+    bool writeHeader();
+    bool appendRecords(const QDbfTable &table, int first, int count, int threadCount);
+    bool mergeRuns();
+
+    inline const char *entry(int index) const
+    { return reinterpret_cast<const char *>(m_data) + SORTED_INDEX_DATA_OFFSET + static_cast<qint64>(index) * m_entryLength; }
+    inline quint32 entryRecord(const char *entry) const
+    { return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(entry + m_keyLength)); }
+    int compareEntries(const char *left, const char *right) const;
+
+    QDbfTable::DbfTableError m_error;
+    QFile m_file;
+    uchar *m_mappedData;
+    QByteArray m_buffer;
+    const uchar *m_data;
+    const QDbfCodec *m_codec;
+    QVector<Field> m_fields;
+    QVector<Run> m_runs;
+    int m_keyLength;
+    int m_entryLength;
+    int m_recordLength;
+    int m_recordsCount;
+};
+
+class QDbfSortedIndexCursorPrivate
+{
+public:
+    QDbfSortedIndexCursorPrivate();
+
+    const QDbfSortedIndexPrivate *m_index;
+    Qt::SortOrder m_order;
+    QVector<int> m_begins;
+    QVector<int> m_ends;
+    int m_recordIndex;
+};
+
+// writes the key and the record index of every record into its entry
+class QDbfSortedKeyCollector : public QDbfScanHandler
+{
+public:
+    QDbfSortedKeyCollector(const QDbfSortedIndexPrivate *index, char *entries, int first) :
+        m_index(index),
+        m_entries(entries),
+        m_first(first)
+    {
+    }
+
+    bool processRecord(const QDbfRecordView &record, int threadIndex)
+    {
+        Q_UNUSED(threadIndex)
+        char *entry = m_entries + static_cast<qint64>(record.recordIndex() - m_first) * m_index->m_entryLength;
+        m_index->encodeRecord(record.data(), entry);
+        qToLittleEndian<quint32>(record.recordIndex(), reinterpret_cast<uchar *>(entry + m_index->m_keyLength));
+        return true;
+    }
+
+private:
+    const QDbfSortedIndexPrivate *m_index;
+    char *m_entries;
+    int m_first;
+};
+
+class QDbfEntryLess
+{
+public:
+    QDbfEntryLess(const QDbfSortedIndexPrivate *index, const char *entries) :
+        m_index(index),
+        m_entries(entries)
+    {
+    }
+
+    bool operator()(int left, int right) const
+    {
+        const qint64 length = m_index->m_entryLength;
+        return m_index->compareEntries(m_entries + left * length, m_entries + right * length) < 0;
+    }
+
+private:
+    const QDbfSortedIndexPrivate *m_index;
+    const char *m_entries;
+};
+
+// doubles as bytewise comparable keys: big-endian with the sign bit flipped,
+// all bits of negative numbers inverted
+static void encodeNumber(double value, char *key)
+{
+    if (value == 0.0) {
+        value = 0.0;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & Q_UINT64_C(0x8000000000000000)) ? ~bits : bits ^ Q_UINT64_C(0x8000000000000000);
+    qToBigEndian<quint64>(bits, reinterpret_cast<uchar *>(key));
+}
+
+QDbfSortedIndexPrivate::QDbfSortedIndexPrivate() :
+    m_error(QDbfTable::NoError),
+    m_mappedData(0),
+    m_data(0),
+    m_codec(0),
+    m_keyLength(0),
+    m_entryLength(0),
+    m_recordLength(0),
+    m_recordsCount(0)
+{
+}
+
+void QDbfSortedIndexPrivate::reset()
+{
+    unmap();
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_fields.clear();
+    m_runs.clear();
+    m_keyLength = 0;
+    m_entryLength = 0;
+    m_recordLength = 0;
+    m_recordsCount = 0;
+}
+
+bool QDbfSortedIndexPrivate::addField(const QDbfRecord &record, const QString &name)
+{
+    const int fieldIndex = record.indexOf(name);
+    if (fieldIndex < 0) {
+        qWarning("QDbfSortedIndex: no field %s", qPrintable(name));
+        return false;
+    }
+
+    const QDbfField field = record.field(fieldIndex);
+
+    Field key;
+    key.name = field.name();
+    key.type = field.dbfType();
+    key.offset = field.offset();
+    key.length = field.length();
+    key.precision = field.precision();
+    key.keyOffset = m_keyLength;
+
+    switch (key.type) {
+    case QDbfField::Character:
+        key.keyLength = key.length;
+        break;
+    case QDbfField::Number:
+    case QDbfField::FloatingPoint:
+        key.keyLength = NUMBER_KEY_LENGTH;
+        break;
+    case QDbfField::Date:
+        key.keyLength = DATE_LENGTH;
+        break;
+    case QDbfField::Logical:
+        key.keyLength = 1;
+        break;
+    default:
+        qWarning("QDbfSortedIndex: field %s can not be indexed", qPrintable(name));
+        return false;
+    }
+
+    if (key.length <= 0) {
+        return false;
+    }
+
+    m_fields.append(key);
+    m_keyLength += key.keyLength;
+    m_entryLength = m_keyLength + RECORD_INDEX_LENGTH;
+
+    return true;
+}
+
+bool QDbfSortedIndexPrivate::checkFields(const QDbfRecord &record) const
+{
+    for (int i = 0; i < m_fields.size(); ++i) {
+        const Field &key = m_fields.at(i);
+        const int fieldIndex = record.indexOf(key.name);
+        if (fieldIndex < 0) {
+            return false;
+        }
+
+        const QDbfField field = record.field(fieldIndex);
+        if (field.dbfType() != key.type || field.offset() != key.offset ||
+            field.length() != key.length || field.precision() != key.precision) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void QDbfSortedIndexPrivate::encodeRecord(const char *record, char *key) const
+{
+    for (int i = 0; i < m_fields.size(); ++i) {
+        const Field &field = m_fields.at(i);
+        const char *data = record + field.offset;
+        char *out = key + field.keyOffset;
+
+        switch (field.type) {
+        case QDbfField::Number:
+        case QDbfField::FloatingPoint: {
+            // blank and unreadable numbers sort before all others
+            double value = 0.0;
+            if (parseNumber(data, field.length, &value) == NumberValid) {
+                encodeNumber(value, out);
+            } else {
+                memset(out, 0, NUMBER_KEY_LENGTH);
+            }
+            break;
+        }
+        case QDbfField::Date:
+            memset(out, ' ', DATE_LENGTH);
+            memcpy(out, data, qMin(field.length, DATE_LENGTH));
+            break;
+        case QDbfField::Logical:
+            switch (data[0]) {
+            case 'T': case 't': case 'Y': case 'y':
+                *out = 'T';
+                break;
+            case 'F': case 'f': case 'N': case 'n':
+                *out = 'F';
+                break;
+            default:
+                *out = ' ';
+                break;
+            }
+            break;
+        default:
+            memcpy(out, data, field.length);
+            break;
+        }
+    }
+}
+
+int QDbfSortedIndexPrivate::encodeValue(const QVariant &value, char *key) const
+{
+    const QVariantList values = value.type() == QVariant::List ? value.toList() : QVariantList() << value;
+    if (values.size() > m_fields.size()) {
+        return -1;
+    }
+
+    // the result is the length of the encoded key prefix
+    int length = 0;
+    for (int i = 0; i < values.size(); ++i) {
+        const Field &field = m_fields.at(i);
+        const QVariant &fieldValue = values.at(i);
+        char *out = key + field.keyOffset;
+
+        switch (field.type) {
+        case QDbfField::Character: {
+            const QString string = fieldValue.toString();
+            memset(out, ' ', field.keyLength);
+            m_codec->fromUnicode(string.constData(), string.length(), out, field.keyLength);
+            break;
+        }
+        case QDbfField::Number:
+        case QDbfField::FloatingPoint: {
+            bool ok = false;
+            const double number = fieldValue.toDouble(&ok);
+            if (!ok) {
+                return -1;
+            }
+            encodeNumber(number, out);
+            break;
+        }
+        case QDbfField::Date: {
+            const QDate date = fieldValue.toDate();
+            memset(out, ' ', DATE_LENGTH);
+            if (date.isValid()) {
+                formatDigits(date.year(), out, 4);
+                formatDigits(date.month(), out + 4, 2);
+                formatDigits(date.day(), out + 6, 2);
+            }
+            break;
+        }
+        case QDbfField::Logical:
+            *out = fieldValue.toBool() ? 'T' : 'F';
+            break;
+        default:
+            return -1;
+        }
+
+        length += field.keyLength;
+    }
+
+    return length;
+}
+
+bool QDbfSortedIndexPrivate::map()
+{
+    unmap();
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < SORTED_INDEX_DATA_OFFSET) {
+        return false;
+    }
+
+    // without a mapping the file is read into memory as a whole
+    m_mappedData = m_file.map(0, fileSize);
+    if (m_mappedData) {
+        m_data = m_mappedData;
+        return true;
+    }
+
+    if (!m_file.seek(0)) {
+        return false;
+    }
+
+    m_buffer = m_file.readAll();
+    m_data = reinterpret_cast<const uchar *>(m_buffer.constData());
+
+    return m_buffer.size() == fileSize;
+}
+
+void QDbfSortedIndexPrivate::unmap()
+{
+    if (m_mappedData) {
+        m_file.unmap(m_mappedData);
+        m_mappedData = 0;
+    }
+
+    m_buffer.clear();
+    m_data = 0;
+}
+
+bool QDbfSortedIndexPrivate::readHeader()
+{
+    const uchar *header = m_data;
+    if (memcmp(header, SORTED_INDEX_MAGIC, SORTED_INDEX_MAGIC_LENGTH) != 0 ||
+        qFromLittleEndian<quint32>(header + 8) != static_cast<quint32>(SORTED_INDEX_VERSION)) {
+        return false;
+    }
+
+    m_recordsCount = qFromLittleEndian<quint32>(header + 16);
+    const int fieldsCount = qFromLittleEndian<quint32>(header + 20);
+    const int runsCount = qFromLittleEndian<quint32>(header + 24);
+    m_recordLength = qFromLittleEndian<quint32>(header + 28);
+
+    if (fieldsCount <= 0 || fieldsCount > SORTED_INDEX_MAX_FIELDS ||
+        runsCount < 0 || runsCount > SORTED_INDEX_MAX_RUNS) {
+        return false;
+    }
+
+    m_fields.clear();
+    m_keyLength = 0;
+    for (int i = 0; i < fieldsCount; ++i) {
+        const uchar *data = header + SORTED_INDEX_FIELDS_OFFSET + i * SORTED_INDEX_FIELD_LENGTH;
+        const QByteArray name(reinterpret_cast<const char *>(data), SORTED_INDEX_FIELD_NAME_LENGTH);
+
+        Field field;
+        field.name = QString::fromLatin1(name.constData());
+        field.type = typeFromCharacter(static_cast<char>(data[11]));
+        if (field.type == QDbfField::UnknownDataType) {
+            return false;
+        }
+        field.offset = qFromLittleEndian<quint32>(data + 12);
+        field.length = qFromLittleEndian<quint16>(data + 16);
+        field.precision = qFromLittleEndian<quint16>(data + 18);
+        field.keyOffset = m_keyLength;
+        field.keyLength = field.type == QDbfField::Character ? field.length :
+                          field.type == QDbfField::Logical ? 1 :
+                          field.type == QDbfField::Date ? DATE_LENGTH : NUMBER_KEY_LENGTH;
+        m_fields.append(field);
+        m_keyLength += field.keyLength;
+    }
+    m_entryLength = m_keyLength + RECORD_INDEX_LENGTH;
+
+    const qint64 entriesCount = (m_file.size() - SORTED_INDEX_DATA_OFFSET) / m_entryLength;
+    qint64 indexed = 0;
+    m_runs.clear();
+    for (int i = 0; i < runsCount; ++i) {
+        const uchar *data = header + SORTED_INDEX_RUNS_OFFSET + i * 8;
+        Run run;
+        run.first = qFromLittleEndian<quint32>(data);
+        run.count = qFromLittleEndian<quint32>(data + 4);
+        if (run.first != indexed || run.count < 0) {
+            return false;
+        }
+        indexed += run.count;
+        m_runs.append(run);
+    }
+
+    return indexed == m_recordsCount && indexed <= entriesCount;
+}
+
+bool QDbfSortedIndexPrivate::writeHeader()
+{
+    uchar header[SORTED_INDEX_DATA_OFFSET];
+    memset(header, 0, SORTED_INDEX_DATA_OFFSET);
+
+    memcpy(header, SORTED_INDEX_MAGIC, SORTED_INDEX_MAGIC_LENGTH);
+    qToLittleEndian<quint32>(SORTED_INDEX_VERSION, header + 8);
+    qToLittleEndian<quint32>(m_keyLength, header + 12);
+    qToLittleEndian<quint32>(m_recordsCount, header + 16);
+    qToLittleEndian<quint32>(m_fields.size(), header + 20);
+    qToLittleEndian<quint32>(m_runs.size(), header + 24);
+    qToLittleEndian<quint32>(m_recordLength, header + 28);
+
+    for (int i = 0; i < m_fields.size(); ++i) {
+        const Field &field = m_fields.at(i);
+        uchar *data = header + SORTED_INDEX_FIELDS_OFFSET + i * SORTED_INDEX_FIELD_LENGTH;
+        const QByteArray name = field.name.toLatin1().left(SORTED_INDEX_FIELD_NAME_LENGTH);
+        memcpy(data, name.constData(), name.size());
+        data[11] = static_cast<uchar>(typeCharacter(field.type));
+        qToLittleEndian<quint32>(field.offset, data + 12);
+        qToLittleEndian<quint16>(field.length, data + 16);
+        qToLittleEndian<quint16>(field.precision, data + 18);
+    }
+
+    for (int i = 0; i < m_runs.size(); ++i) {
+        uchar *data = header + SORTED_INDEX_RUNS_OFFSET + i * 8;
+        qToLittleEndian<quint32>(m_runs.at(i).first, data);
+        qToLittleEndian<quint32>(m_runs.at(i).count, data + 4);
+    }
+
+    return m_file.seek(0) &&
+            m_file.write(reinterpret_cast<const char *>(header), SORTED_INDEX_DATA_OFFSET) ==
+            SORTED_INDEX_DATA_OFFSET;
+}
+
+bool QDbfSortedIndexPrivate::appendRecords(const QDbfTable &table, int first, int count,
+                                           int threadCount)
+{
+    QByteArray entries(count * m_entryLength, '\0');
+    QDbfSortedKeyCollector collector(this, entries.data(), first);
+    if (count > 0 && !table.scanParallel(&collector, first, count, threadCount)) {
+        m_error = table.error();
+        return false;
+    }
+
+    QVector<int> order(count);
+    for (int i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), QDbfEntryLess(this, entries.constData()));
+
+    QByteArray run(count * m_entryLength, '\0');
+    for (int i = 0; i < count; ++i) {
+        memcpy(run.data() + i * m_entryLength,
+               entries.constData() + static_cast<qint64>(order.at(i)) * m_entryLength, m_entryLength);
+    }
+    entries.clear();
+
+    unmap();
+
+    Run appended;
+    appended.first = m_recordsCount;
+    appended.count = count;
+
+    const qint64 position = SORTED_INDEX_DATA_OFFSET + static_cast<qint64>(appended.first) * m_entryLength;
+    if (!m_file.seek(position) || m_file.write(run) != run.size()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (count > 0) {
+        m_runs.append(appended);
+    }
+    m_recordsCount += count;
+
+    if (!mergeRuns() || !writeHeader() || !m_file.flush() || !map()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    return true;
+}
+
+bool QDbfSortedIndexPrivate::mergeRuns()
+{
+    // like a binary counter: the last run is merged into its predecessor
+    // while it is at least half as long, which keeps the number of runs
+    // logarithmic and every entry merged a logarithmic number of times
+    while (m_runs.size() >= 2 &&
+           (m_runs.last().count * 2 >= m_runs.at(m_runs.size() - 2).count ||
+            m_runs.size() > SORTED_INDEX_MAX_RUNS)) {
+        const Run right = m_runs.last();
+        m_runs.remove(m_runs.size() - 1);
+        Run &left = m_runs.last();
+
+        // both runs are adjacent, the merged one takes exactly their place
+        const qint64 position = SORTED_INDEX_DATA_OFFSET + static_cast<qint64>(left.first) * m_entryLength;
+        const int length = (left.count + right.count) * m_entryLength;
+        if (!m_file.seek(position)) {
+            return false;
+        }
+
+        const QByteArray entries = m_file.read(length);
+        if (entries.size() != length) {
+            return false;
+        }
+
+        QByteArray merged(length, '\0');
+        const char *leftEntry = entries.constData();
+        const char *leftEnd = leftEntry + left.count * m_entryLength;
+        const char *rightEntry = leftEnd;
+        const char *rightEnd = entries.constData() + length;
+        char *out = merged.data();
+
+        while (leftEntry < leftEnd || rightEntry < rightEnd) {
+            const bool takeLeft = rightEntry >= rightEnd ||
+                    (leftEntry < leftEnd && compareEntries(leftEntry, rightEntry) <= 0);
+            const char *entry = takeLeft ? leftEntry : rightEntry;
+            memcpy(out, entry, m_entryLength);
+            out += m_entryLength;
+            if (takeLeft) {
+                leftEntry += m_entryLength;
+            } else {
+                rightEntry += m_entryLength;
+            }
+        }
+
+        if (!m_file.seek(position) || m_file.write(merged) != length) {
+            return false;
+        }
+
+        left.count += right.count;
+    }
+
+    return true;
+}
+
+int QDbfSortedIndexPrivate::compareEntries(const char *left, const char *right) const
+{
+    const int result = memcmp(left, right, m_keyLength);
+    if (result != 0) {
+        return result;
+    }
+
+    const quint32 leftRecord = entryRecord(left);
+    const quint32 rightRecord = entryRecord(right);
+
+    return leftRecord < rightRecord ? -1 : (leftRecord > rightRecord ? 1 : 0);
+}
+
+QDbfSortedIndexCursorPrivate::QDbfSortedIndexCursorPrivate() :
+    m_index(0),
+    m_order(Qt::AscendingOrder),
+    m_recordIndex(-1)
+{
+}
+
+} // namespace Internal
+
+QDbfSortedIndex::QDbfSortedIndex() :
+    d(new Internal::QDbfSortedIndexPrivate())
+{
+}
+
+QDbfSortedIndex::~QDbfSortedIndex()
+{
+    close();
+    delete d;
+}
+
+bool QDbfSortedIndex::create(const QDbfTable &table, const QStringList &fieldNames,
+                             const QString &fileName, int threadCount)
+{
+    close();
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfSortedIndex::create(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (fieldNames.isEmpty() || fieldNames.size() > Internal::SORTED_INDEX_MAX_FIELDS) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    for (int i = 0; i < fieldNames.size(); ++i) {
+        if (!d->addField(table.d->m_tableRecord, fieldNames.at(i))) {
+            d->reset();
+            d->m_error = QDbfTable::UnspecifiedError;
+            return false;
+        }
+    }
+
+    d->m_codec = table.d->m_codec;
+    d->m_recordLength = table.d->m_recordLength;
+
+    d->m_file.setFileName(fileName);
+    if (!d->m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        d->reset();
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!d->writeHeader() || !d->appendRecords(table, 0, table.size(), threadCount)) {
+        d->reset();
+        if (d->m_error == QDbfTable::NoError) {
+            d->m_error = QDbfTable::WriteError;
+        }
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfSortedIndex::open(const QDbfTable &table, const QString &fileName)
+{
+    close();
+
+    if (!table.d->isOpen()) {
+        qWarning("QDbfSortedIndex::open(): IODevice is not open");
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    d->m_file.setFileName(fileName);
+    if (!d->m_file.open(QIODevice::ReadWrite) && !d->m_file.open(QIODevice::ReadOnly)) {
+        d->m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    // a table with fewer records than indexed has been packed or replaced
+    if (!d->map() || !d->readHeader() || !d->checkFields(table.d->m_tableRecord) ||
+        d->m_recordLength != table.d->m_recordLength || d->m_recordsCount > table.size()) {
+        qWarning("QDbfSortedIndex::open(): %s does not match the table", qPrintable(fileName));
+        d->reset();
+        d->m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    d->m_codec = table.d->m_codec;
+    d->m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfSortedIndex::update(const QDbfTable &table, int threadCount)
+{
+    if (!isOpen()) {
+        qWarning("QDbfSortedIndex::update(): index is not open");
+        return false;
+    }
+
+    if (!table.d->isOpen() || d->m_recordsCount > table.size()) {
+        d->m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    if (d->m_recordsCount == table.size()) {
+        d->m_error = QDbfTable::NoError;
+        return true;
+    }
+
+    if (!d->m_file.isWritable()) {
+        d->m_error = QDbfTable::PermissionsError;
+        return false;
+    }
+
+    d->m_error = QDbfTable::NoError;
+
+    return d->appendRecords(table, d->m_recordsCount, table.size() - d->m_recordsCount, threadCount);
+}
+
+void QDbfSortedIndex::close()
+{
+    d->reset();
+}
+
+bool QDbfSortedIndex::isOpen() const
+{
+    return d->m_data != 0;
+}
+
+QDbfTable::DbfTableError QDbfSortedIndex::error() const
+{
+    return d->m_error;
+}
+
+QStringList QDbfSortedIndex::fieldNames() const
+{
+    QStringList names;
+    for (int i = 0; i < d->m_fields.size(); ++i) {
+        names.append(d->m_fields.at(i).name);
+    }
+
+    return names;
+}
+
+int QDbfSortedIndex::size() const
+{
+    return d->m_recordsCount;
+}
+
+QDbfSortedIndexCursor::QDbfSortedIndexCursor(const QDbfSortedIndex &index) :
+    d(new Internal::QDbfSortedIndexCursorPrivate())
+{
+    d->m_index = index.d;
+}
+
+QDbfSortedIndexCursor::~QDbfSortedIndexCursor()
+{
+    delete d;
+}
+
+bool QDbfSortedIndexCursor::setRange(const QVariant &from, const QVariant &to, Qt::SortOrder order)
+{
+    const Internal::QDbfSortedIndexPrivate *index = d->m_index;
+
+    d->m_order = order;
+    d->m_begins.clear();
+    d->m_ends.clear();
+    d->m_recordIndex = -1;
+
+    if (!index->m_data) {
+        return false;
+    }
+
+    QByteArray fromKey(index->m_keyLength, '\0');
+    QByteArray toKey(index->m_keyLength, '\0');
+    const int fromLength = from.isValid() ? index->encodeValue(from, fromKey.data()) : 0;
+    const int toLength = to.isValid() ? index->encodeValue(to, toKey.data()) : 0;
+    if (fromLength < 0 || toLength < 0) {
+        return false;
+    }
+
+    // every run is narrowed to the range by two binary searches
+    for (int i = 0; i < index->m_runs.size(); ++i) {
+        const Internal::QDbfSortedIndexPrivate::Run &run = index->m_runs.at(i);
+
+        int low = run.first;
+        int high = run.first + run.count;
+        while (fromLength > 0 && low < high) {
+            const int middle = low + (high - low) / 2;
+            if (memcmp(index->entry(middle), fromKey.constData(), fromLength) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        const int begin = low;
+
+        high = run.first + run.count;
+        while (toLength > 0 && low < high) {
+            const int middle = low + (high - low) / 2;
+            if (memcmp(index->entry(middle), toKey.constData(), toLength) <= 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        const int end = toLength > 0 ? low : run.first + run.count;
+
+        if (begin < end) {
+            d->m_begins.append(begin);
+            d->m_ends.append(end);
+        }
+    }
+
+    return true;
+}
+
+bool QDbfSortedIndexCursor::next()
+{
+    const Internal::QDbfSortedIndexPrivate *index = d->m_index;
+    const bool ascending = d->m_order == Qt::AscendingOrder;
+
+    // merge the runs: take the lowest (highest) pending entry of all
+    int best = -1;
+    const char *bestEntry = 0;
+    for (int i = 0; i < d->m_begins.size(); ++i) {
+        if (d->m_begins.at(i) >= d->m_ends.at(i)) {
+            continue;
+        }
+        const char *entry = index->entry(ascending ? d->m_begins.at(i) : d->m_ends.at(i) - 1);
+        if (!bestEntry || (ascending ? index->compareEntries(entry, bestEntry) < 0 :
+                           index->compareEntries(entry, bestEntry) > 0)) {
+            best = i;
+            bestEntry = entry;
+        }
+    }
+
+    if (best < 0) {
+        d->m_recordIndex = -1;
+        return false;
+    }
+
+    if (ascending) {
+        ++d->m_begins[best];
+    } else {
+        --d->m_ends[best];
+    }
+    d->m_recordIndex = index->entryRecord(bestEntry);
+
+    return true;
+}
+
+int QDbfSortedIndexCursor::recordIndex() const
+{
+    return d->m_recordIndex;
+}
+
+bool QDbfSortedIndexCursor::seek(const QDbfTable &table) const
+{
+    if (d->m_recordIndex < 0 || d->m_recordIndex >= table.size()) {
+        return false;
+    }
+
+    return table.seek(d->m_recordIndex);
+}
+
+} // namespace QDbf
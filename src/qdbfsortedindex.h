@@ -0,0 +1,74 @@
+#ifndef QDBFSORTEDINDEX_H
+#define QDBFSORTEDINDEX_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QString;
+class QVariant;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfSortedIndexCursorPrivate;
+class QDbfSortedIndexPrivate;
+} // namespace Internal
+
+// Sidecar file with the keys of one or more fields in sorted order, read
+// through a memory mapping. Records appended to the table since the last
+// update() are sorted into a run of their own and runs of similar size are
+// merged, so bringing the file up to date never sorts the whole table
+// again. Changes to records that were already indexed are not detected.
+class QDBF_EXPORT QDbfSortedIndex
+{
+public:
+    QDbfSortedIndex();
+    ~QDbfSortedIndex();
+
+    bool create(const QDbfTable &table, const QStringList &fieldNames, const QString &fileName,
+                int threadCount = 0);
+    bool open(const QDbfTable &table, const QString &fileName);
+    bool update(const QDbfTable &table, int threadCount = 0);
+    void close();
+
+    bool isOpen() const;
+    QDbfTable::DbfTableError error() const;
+    QStringList fieldNames() const;
+    int size() const;
+
+private:
+    Q_DISABLE_COPY(QDbfSortedIndex)
+
+    Internal::QDbfSortedIndexPrivate *d;
+
+    friend class QDbfSortedIndexCursor;
+};
+
+// Walks the records of a key range in key order. Bounds are inclusive, a
+// QVariantList bounds the leading fields of a composite key and an invalid
+// QVariant leaves that side open. The cursor must not outlive its index and
+// has to be set up again after the index is updated.
+class QDBF_EXPORT QDbfSortedIndexCursor
+{
+public:
+    explicit QDbfSortedIndexCursor(const QDbfSortedIndex &index);
+    ~QDbfSortedIndexCursor();
+
+    bool setRange(const QVariant &from, const QVariant &to,
+                  Qt::SortOrder order = Qt::AscendingOrder);
+    bool next();
+    int recordIndex() const;
+    bool seek(const QDbfTable &table) const;
+
+private:
+    Q_DISABLE_COPY(QDbfSortedIndexCursor)
+
+    Internal::QDbfSortedIndexCursorPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFSORTEDINDEX_H
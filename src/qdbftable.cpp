@@ -1,17 +1,32 @@
 #include "qdbffield.h"
 
+#include "qdbfaggregate_p.h"
+#include "qdbfcodec_p.h"
+#include "qdbffilter_p.h"
+#include "qdbfindex_p.h"
+#include "qdbfmemofile_p.h"
+#include "qdbfnumeric_p.h"
+#include "qdbfreader_p.h"
 #include "qdbfrecord.h"
+#include "qdbfrecordview.h"
 #include "qdbftable.h"
+#include "qdbftable_p.h"
 
 #include <QDate>
 #include <QDebug>
 #include <QFile>
-#include <QTextCodec>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 #include <QVarLengthArray>
 
+#include <qnumeric.h>
+
 namespace QDbf {
 namespace Internal {
 
+const qint16 DATE_LENGTH = 8;
 const qint16 DBC_LENGTH = 263;
 const qint16 FIELD_DESCRIPTOR_LENGTH = 32;
 const qint16 FIELD_NAME_LENGTH = 11;
@@ -19,6 +34,7 @@ const qint16 FIELD_LENGTH_OFFSET = 16;
 const qint16 FIELD_PRECISION_OFFSET = 17;
 const qint16 HEADER_LENGTH_OFFSET_1 = 8;
 const qint16 HEADER_LENGTH_OFFSET_2 = 9;
+const qint16 LAST_UPDATE_OFFSET = 1;
 const qint16 LANGUAGE_DRIVER_OFFSET = 29;
 const qint16 RECORD_LENGTH_OFFSET_1 = 10;
 const qint16 RECORD_LENGTH_OFFSET_2 = 11;
@@ -29,76 +45,109 @@ const qint16 RECORDS_COUNT_OFFSET_4 = 7;
 const qint16 TABLE_DESCRIPTOR_LENGTH = 32;
 const qint16 TERMINATOR_LENGTH = 1;
 const qint16 VERSION_NUMBER_OFFSET = 0;
+const char END_OF_FILE_MARK = 26;
+const int DEFAULT_READ_BUFFER_SIZE = 256 * 1024;
+const int DEFAULT_MEMO_CACHE_SIZE = 1024 * 1024;
+const int PACK_BUFFER_SIZE = 4 * 1024 * 1024;
+
+static inline void setBit(QByteArray *bits, int index)
+{
+    (*bits)[index / 8] = static_cast<char>((*bits)[index / 8] | (1 << (index % 8)));
+}
+
+static void formatDate(const QDate &date, char *out, int length)
+{
+    char buffer[DATE_LENGTH];
+    const int size = qMin(length, static_cast<int>(DATE_LENGTH));
+    if (date.isValid() && date.year() > 0 && date.year() <= 9999) {
+        formatDigits(date.year(), buffer, 4);
+        formatDigits(date.month(), buffer + 4, 2);
+        formatDigits(date.day(), buffer + 6, 2);
+        memcpy(out, buffer, size);
+    } else {
+        memset(out, ' ', size);
+    }
+    memset(out + size, ' ', length - size);
+}
 
-class QDbfTablePrivate
+class QDbfScanTask : public QRunnable
 {
 public:
-    QDbfTablePrivate();
-    QDbfTablePrivate(const QString &dbfFileName);
-    QDbfTablePrivate(const QDbfTablePrivate &other);
-    ~QDbfTablePrivate();
+    QDbfScanTask(QDbfScanHandler *handler, const QDbfFilterMatcher *matcher, int threadIndex,
+                 QAtomicInt *nextChunk, int chunksCount, int chunkSize, int first, int end) :
+        m_error(QDbfTable::NoError),
+        m_handler(handler),
+        m_matcher(matcher),
+        m_threadIndex(threadIndex),
+        m_nextChunk(nextChunk),
+        m_chunksCount(chunksCount),
+        m_chunkSize(chunkSize),
+        m_first(first),
+        m_end(end)
+    {
+        setAutoDelete(false);
+    }
 
-    enum QDbfTableType
+    void run()
     {
-        SimpleTable,
-        TableWithDbc
-    };
+        // chunks are handed out one at a time, so fast threads take over the
+        // remaining work of slow ones
+        for (;;) {
+            const int chunk = m_nextChunk->fetchAndAddOrdered(1);
+            if (chunk >= m_chunksCount) {
+                return;
+            }
+
+            const int begin = m_first + chunk * m_chunkSize;
+            const int end = qMin(begin + m_chunkSize, m_end);
+            for (int i = begin; i < end; ++i) {
+                const QDbfRecordView view = m_reader.recordView(i);
+                if (!view.isValid()) {
+                    m_error = m_reader.error();
+                    stop();
+                    return;
+                }
+                if (m_matcher && !m_matcher->matches(view.data())) {
+                    continue;
+                }
+                if (!m_handler->processRecord(view, m_threadIndex)) {
+                    stop();
+                    return;
+                }
+            }
+        }
+    }
 
-    enum Location
+    void stop()
     {
-        BeforeFirstRow = -1,
-        FirstRow = 0
-    };
-
-    bool open(const QString &fileName, QDbfTable::OpenMode openMode = QDbfTable::ReadOnly);
-    bool open(QDbfTable::OpenMode openMode = QDbfTable::ReadOnly);
-    void close();
-
-    bool setCodepage(QDbfTable::Codepage m_codepage);
-    QDbfTable::Codepage codepage() const;
-
-    bool isOpen() const;
-    int size() const;
-    int at() const;
-    bool previous() const;
-    bool next() const;
-    bool first() const;
-    bool last() const;
-    bool seek(int index) const;
-
-    QDbfRecord record() const;
-    QVariant value(int index) const;
-    bool addRecord();
-    bool addRecord(const QDbfRecord &record);
-    bool updateRecordInTable(const QDbfRecord &record);
-    bool removeRecord(int index);
-
-    void setTextCodec();
-    QByteArray recordData(const QDbfRecord &record, bool addEndOfFileMark = false) const;
-
-    QAtomicInt ref;
-    QString m_fileName;
-    mutable QDbfTable::DbfTableError m_error;
-    mutable QFile m_file;
-    QDbfTable::OpenMode m_openMode;
-    QTextCodec *m_textCodec;
-    QDbfTableType m_type;
-    QDbfTable::Codepage m_codepage;
-    qint16 m_headerLength;
-    qint16 m_recordLength;
-    qint16 m_fieldsCount;
-    int m_recordsCount;
-    mutable int m_currentIndex;
-    mutable bool m_bufered;
-    mutable QDbfRecord m_currentRecord;
-    QDbfRecord m_record;
+        m_nextChunk->fetchAndStoreOrdered(m_chunksCount);
+    }
+
+    QDbfReader m_reader;
+    QDbfTable::DbfTableError m_error;
+
+private:
+    QDbfScanHandler *m_handler;
+    const QDbfFilterMatcher *m_matcher;
+    int m_threadIndex;
+    QAtomicInt *m_nextChunk;
+    int m_chunksCount;
+    int m_chunkSize;
+    int m_first;
+    int m_end;
 };
 
 QDbfTablePrivate::QDbfTablePrivate() :
     ref(1),
     m_error(QDbfTable::NoError),
     m_openMode(QDbfTable::ReadOnly),
-    m_textCodec(QTextCodec::codecForLocale()),
+    m_openOptions(QDbfTable::NoOptions),
+    m_mappedData(0),
+    m_mappedSize(0),
+    m_readBufferSize(DEFAULT_READ_BUFFER_SIZE),
+    m_readBufferFirstIndex(0),
+    m_readBufferCount(0),
+    m_codec(QDbfCodec::codecForCodepage(QDbfTable::CodepageNotSet)),
     m_type(QDbfTablePrivate::SimpleTable),
     m_codepage(QDbfTable::CodepageNotSet),
     m_headerLength(-1),
@@ -106,7 +155,15 @@ QDbfTablePrivate::QDbfTablePrivate() :
     m_fieldsCount(-1),
     m_recordsCount(-1),
     m_currentIndex(-1),
-    m_bufered(false)
+    m_bufered(false),
+    m_schema(0),
+    m_tableSchema(0),
+    m_index(0),
+    m_memo(0),
+    m_memoCacheSize(DEFAULT_MEMO_CACHE_SIZE),
+    m_deletionMapValid(false),
+    m_indexUpdatesDeferred(false),
+    m_indexStale(false)
 {
 }
 
@@ -115,7 +172,13 @@ QDbfTablePrivate::QDbfTablePrivate(const QString &dbfFileName) :
     m_fileName(dbfFileName),
     m_error(QDbfTable::NoError),
     m_openMode(QDbfTable::ReadOnly),
-    m_textCodec(QTextCodec::codecForLocale()),
+    m_openOptions(QDbfTable::NoOptions),
+    m_mappedData(0),
+    m_mappedSize(0),
+    m_readBufferSize(DEFAULT_READ_BUFFER_SIZE),
+    m_readBufferFirstIndex(0),
+    m_readBufferCount(0),
+    m_codec(QDbfCodec::codecForCodepage(QDbfTable::CodepageNotSet)),
     m_type(QDbfTablePrivate::SimpleTable),
     m_codepage(QDbfTable::CodepageNotSet),
     m_headerLength(-1),
@@ -123,7 +186,15 @@ QDbfTablePrivate::QDbfTablePrivate(const QString &dbfFileName) :
     m_fieldsCount(-1),
     m_recordsCount(-1),
     m_currentIndex(-1),
-    m_bufered(false)
+    m_bufered(false),
+    m_schema(0),
+    m_tableSchema(0),
+    m_index(0),
+    m_memo(0),
+    m_memoCacheSize(DEFAULT_MEMO_CACHE_SIZE),
+    m_deletionMapValid(false),
+    m_indexUpdatesDeferred(false),
+    m_indexStale(false)
 {
 }
 
@@ -132,7 +203,13 @@ QDbfTablePrivate::QDbfTablePrivate(const QDbfTablePrivate &other) :
     m_fileName(other.m_fileName),
     m_error(other.m_error),
     m_openMode(other.m_openMode),
-    m_textCodec(other.m_textCodec),
+    m_openOptions(other.m_openOptions),
+    m_mappedData(0),
+    m_mappedSize(0),
+    m_readBufferSize(other.m_readBufferSize),
+    m_readBufferFirstIndex(0),
+    m_readBufferCount(0),
+    m_codec(other.m_codec),
     m_type(other.m_type),
     m_codepage(other.m_codepage),
     m_headerLength(other.m_headerLength),
@@ -142,30 +219,70 @@ QDbfTablePrivate::QDbfTablePrivate(const QDbfTablePrivate &other) :
     m_currentIndex(other.m_currentIndex),
     m_bufered(other.m_bufered),
     m_currentRecord(other.m_currentRecord),
-    m_record(other.m_record)
+    m_tableRecord(other.m_tableRecord),
+    m_record(other.m_record),
+    m_projectionNames(other.m_projectionNames),
+    m_projectionIndexes(other.m_projectionIndexes),
+    m_projection(other.m_projection),
+    m_schema(other.m_schema),
+    m_tableSchema(other.m_tableSchema),
+    m_index(0),
+    m_memo(other.m_memo),
+    m_memoCacheSize(other.m_memoCacheSize),
+    m_deletionMap(other.m_deletionMap),
+    m_deletionMapValid(other.m_deletionMapValid),
+    m_indexUpdatesDeferred(other.m_indexUpdatesDeferred),
+    m_indexStale(false)
 {
+    if (m_schema) {
+        m_schema->ref.ref();
+    }
+
+    if (m_tableSchema) {
+        m_tableSchema->ref.ref();
+    }
+
+    if (m_memo) {
+        m_memo->ref.ref();
+    }
+
     m_file.setFileName(other.m_fileName);
     if (other.isOpen()) {
         m_file.open(other.m_file.openMode());
+        if (other.isMapped()) {
+            mapFile();
+        }
+        if (other.m_index) {
+            openIndex(other.m_index->fileName(), other.m_index->tagName());
+            m_indexStale = other.m_indexStale;
+        }
     }
 }
 
 QDbfTablePrivate::~QDbfTablePrivate()
 {
+    closeIndex();
+    closeMemoFile();
+
     if (isOpen()) {
+        unmapFile();
         m_file.close();
     }
+
+    releaseSchema();
 }
 
-bool QDbfTablePrivate::open(const QString &fileName, QDbfTable::OpenMode openMode)
+bool QDbfTablePrivate::open(const QString &fileName, QDbfTable::OpenMode openMode,
+                            QDbfTable::OpenOptions openOptions)
 {
     m_fileName = fileName;
-    return open(openMode);
+    return open(openMode, openOptions);
 }
 
-bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
+bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode, QDbfTable::OpenOptions openOptions)
 {
     m_openMode = openMode;
+    m_openOptions = openOptions;
     m_error = QDbfTable::NoError;
     m_headerLength = -1;
     m_recordLength = -1;
@@ -173,10 +290,18 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
     m_recordsCount = -1;
     m_currentIndex = -1;
     m_bufered = false;
+    m_tableRecord = QDbfRecord();
     m_record = QDbfRecord();
     m_currentRecord = QDbfRecord();
+    m_projection.clear();
+    releaseSchema();
+    closeMemoFile();
+    invalidateReadBuffer();
+    m_deletionMap.clear();
+    m_deletionMapValid = false;
 
     if (isOpen()) {
+        unmapFile();
         m_file.close();
     }
 
@@ -201,6 +326,10 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
     case 4:
     case 5:
     case 7:
+    case 131:
+    case 139:
+    case 203:
+    case 245:
         m_type = QDbfTablePrivate::SimpleTable;
         break;
     case 48:
@@ -236,6 +365,16 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
     case 0:
         m_codepage = QDbfTable::CodepageNotSet;
         break;
+    case 1:
+        m_codepage = QDbfTable::IBM437;
+        break;
+    case 2:
+        m_codepage = QDbfTable::IBM850;
+        break;
+    case 3:
+    case 87:
+        m_codepage = QDbfTable::Windows1252;
+        break;
     case 38:
     case 101:
         m_codepage = QDbfTable::IBM866;
@@ -259,14 +398,16 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
 
     int offset = 1;
     for (int i = 0; i < fieldDescriptorsLength; i += FIELD_DESCRIPTOR_LENGTH) {
-        QString fieldName;
+        char fieldNameData[FIELD_NAME_LENGTH];
+        int fieldNameLength = 0;
         for (int j = 0; j < FIELD_NAME_LENGTH; j++) {
             const char fieldNameChar = fieldDescriptorsData.at(i + j) & 0xFF;
             if (fieldNameChar == 0) {
                 continue;
             }
-            fieldName.append(m_textCodec->toUnicode(&fieldNameChar, 1));
+            fieldNameData[fieldNameLength++] = fieldNameChar;
         }
+        const QString fieldName = m_codec->toUnicode(fieldNameData, fieldNameLength);
 
         QVariant::Type fieldType = QVariant::Invalid;
         QDbfField::QDbfType fieldQDbfType = QDbfField::UnknownDataType;
@@ -288,9 +429,10 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
             fieldType = QVariant::Bool;
             fieldQDbfType = QDbfField::Logical;
             break;
-        /*case 77: // M
+        case 77: // M
             fieldType = QVariant::String;
-            break;*/
+            fieldQDbfType = QDbfField::Memo;
+            break;
         case 78: // N
             fieldType = QVariant::Double;
             fieldQDbfType = QDbfField::Number;
@@ -305,19 +447,273 @@ bool QDbfTablePrivate::open(QDbfTable::OpenMode openMode)
         field.setLength(fieldLength);
         field.setPrecision(fieldPrecision);
         field.setOffset(offset);
-        m_record.append(field);
+        m_tableRecord.append(field);
 
         offset += fieldLength;
     }
 
+    // a table whose memo file is missing still opens, its memos read as invalid
+    if (!openMemoFile(versionNumber)) {
+        qWarning("QDbfTablePrivate::open(): memo file of %s can not be opened",
+                 qPrintable(m_fileName));
+    }
+
+    if (!applyProjection()) {
+        m_file.close();
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    if (m_openOptions & QDbfTable::MemoryMapped) {
+        mapFile();
+    }
+
     return true;
 }
 
 void QDbfTablePrivate::close()
 {
+    closeIndex();
+    closeMemoFile();
+
     if (isOpen()) {
+        unmapFile();
         m_file.close();
     }
+
+    invalidateReadBuffer();
+    m_deletionMap.clear();
+    m_deletionMapValid = false;
+}
+
+bool QDbfTablePrivate::mapFile() const
+{
+    unmapFile();
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize <= 0) {
+        return false;
+    }
+
+    // on failure (e.g. no address space left) records are read through QFile
+    m_mappedData = m_file.map(0, fileSize);
+    if (!m_mappedData) {
+        return false;
+    }
+
+    m_mappedSize = fileSize;
+
+    return true;
+}
+
+void QDbfTablePrivate::unmapFile() const
+{
+    if (m_mappedData) {
+        m_file.unmap(m_mappedData);
+    }
+
+    m_mappedData = 0;
+    m_mappedSize = 0;
+}
+
+bool QDbfTablePrivate::isMapped() const
+{
+    return m_mappedData != 0;
+}
+
+bool QDbfTablePrivate::setProjection(const QStringList &fieldNames)
+{
+    const QStringList previousNames = m_projectionNames;
+    const QList<int> previousIndexes = m_projectionIndexes;
+
+    m_projectionNames = fieldNames;
+    m_projectionIndexes.clear();
+
+    if (isOpen() && !applyProjection()) {
+        m_projectionNames = previousNames;
+        m_projectionIndexes = previousIndexes;
+        return false;
+    }
+
+    return true;
+}
+
+bool QDbfTablePrivate::setProjection(const QList<int> &fieldIndexes)
+{
+    const QStringList previousNames = m_projectionNames;
+    const QList<int> previousIndexes = m_projectionIndexes;
+
+    m_projectionNames.clear();
+    m_projectionIndexes = fieldIndexes;
+
+    if (isOpen() && !applyProjection()) {
+        m_projectionNames = previousNames;
+        m_projectionIndexes = previousIndexes;
+        return false;
+    }
+
+    return true;
+}
+
+void QDbfTablePrivate::clearProjection()
+{
+    m_projectionNames.clear();
+    m_projectionIndexes.clear();
+
+    if (isOpen()) {
+        applyProjection();
+    }
+}
+
+bool QDbfTablePrivate::applyProjection()
+{
+    QVector<int> projection;
+
+    for (int i = 0; i < m_projectionNames.count(); ++i) {
+        const int index = m_tableRecord.indexOf(m_projectionNames.at(i));
+        if (index < 0) {
+            qWarning("QDbfTablePrivate::applyProjection(): unknown field %s",
+                     qPrintable(m_projectionNames.at(i)));
+            return false;
+        }
+        projection.append(index);
+    }
+
+    for (int i = 0; i < m_projectionIndexes.count(); ++i) {
+        const int index = m_projectionIndexes.at(i);
+        if (index < 0 || index >= m_tableRecord.count()) {
+            qWarning("QDbfTablePrivate::applyProjection(): field index %d is out of range", index);
+            return false;
+        }
+        projection.append(index);
+    }
+
+    m_projection = projection;
+
+    if (m_projection.isEmpty()) {
+        m_record = m_tableRecord;
+    } else {
+        m_record = QDbfRecord();
+        for (int i = 0; i < m_projection.count(); ++i) {
+            m_record.append(m_tableRecord.field(m_projection.at(i)));
+        }
+    }
+
+    // compiled once and shared by every record read from the table
+    releaseSchema();
+    m_schema = new QDbfSchema(m_record, m_recordLength);
+    m_record.setSchema(m_schema);
+
+    // filters resolve their fields in the whole record, a projection does
+    // not hide any
+    if (m_projection.isEmpty()) {
+        m_tableSchema = m_schema;
+        m_tableSchema->ref.ref();
+    } else {
+        m_tableSchema = new QDbfSchema(m_tableRecord, m_recordLength);
+    }
+
+    m_bufered = false;
+    m_currentRecord = QDbfRecord();
+
+    return true;
+}
+
+void QDbfTablePrivate::releaseSchema()
+{
+    if (m_schema && !m_schema->ref.deref()) {
+        delete m_schema;
+    }
+
+    if (m_tableSchema && !m_tableSchema->ref.deref()) {
+        delete m_tableSchema;
+    }
+
+    m_schema = 0;
+    m_tableSchema = 0;
+}
+
+void QDbfTablePrivate::setReadBufferSize(int size)
+{
+    m_readBufferSize = qMax(0, size);
+    invalidateReadBuffer();
+}
+
+int QDbfTablePrivate::readBufferSize() const
+{
+    return m_readBufferSize;
+}
+
+void QDbfTablePrivate::setMemoCacheSize(int size)
+{
+    m_memoCacheSize = qMax(0, size);
+    if (m_memo) {
+        m_memo->setCacheSize(m_memoCacheSize);
+    }
+}
+
+int QDbfTablePrivate::memoCacheSize() const
+{
+    return m_memoCacheSize;
+}
+
+void QDbfTablePrivate::invalidateReadBuffer() const
+{
+    m_readBufferFirstIndex = 0;
+    m_readBufferCount = 0;
+}
+
+const char *QDbfTablePrivate::recordPointer(int index) const
+{
+    if (m_recordLength <= 0) {
+        m_error = QDbfTable::ReadError;
+        return 0;
+    }
+
+    const qint64 position = m_headerLength + static_cast<qint64>(m_recordLength) * index;
+
+    if (m_mappedData && position + m_recordLength > m_mappedSize) {
+        // the file has grown through addRecord() since it was mapped
+        mapFile();
+    }
+
+    if (m_mappedData && position + m_recordLength <= m_mappedSize) {
+        return reinterpret_cast<const char *>(m_mappedData + position);
+    }
+
+    if (index >= m_readBufferFirstIndex &&
+        index < m_readBufferFirstIndex + m_readBufferCount) {
+        return m_readBuffer.constData() + (index - m_readBufferFirstIndex) * m_recordLength;
+    }
+
+    // refill the window starting at index, or ending at it when walking backwards
+    const int windowCount = qMax(1, m_readBufferSize / m_recordLength);
+    int firstIndex = index;
+    if (m_readBufferCount > 0 && index == m_readBufferFirstIndex - 1) {
+        firstIndex = qMax(static_cast<int>(QDbfTablePrivate::FirstRow), index - windowCount + 1);
+    }
+    const int count = qMax(1, qMin(windowCount, size() - firstIndex));
+
+    invalidateReadBuffer();
+
+    if (!m_file.seek(m_headerLength + static_cast<qint64>(m_recordLength) * firstIndex)) {
+        m_error = QDbfTable::ReadError;
+        return 0;
+    }
+
+    m_readBuffer.resize(count * m_recordLength);
+    const qint64 bytesRead = m_file.read(m_readBuffer.data(), m_readBuffer.size());
+    const int recordsRead = bytesRead > 0 ? static_cast<int>(bytesRead / m_recordLength) : 0;
+
+    if (index - firstIndex >= recordsRead) {
+        m_error = QDbfTable::UnspecifiedError;
+        return 0;
+    }
+
+    m_readBufferFirstIndex = firstIndex;
+    m_readBufferCount = recordsRead;
+
+    return m_readBuffer.constData() + (index - firstIndex) * m_recordLength;
 }
 
 bool QDbfTablePrivate::setCodepage(QDbfTable::Codepage codepage)
@@ -337,12 +733,22 @@ bool QDbfTablePrivate::setCodepage(QDbfTable::Codepage codepage)
     switch(codepage) {
     case QDbfTable::CodepageNotSet:
         byte = 0;
+        break;
     case QDbfTable::IBM866:
         byte = 101;
         break;
     case QDbfTable::Windows1251:
         byte = 201;
         break;
+    case QDbfTable::IBM437:
+        byte = 1;
+        break;
+    case QDbfTable::IBM850:
+        byte = 2;
+        break;
+    case QDbfTable::Windows1252:
+        byte = 3;
+        break;
     default:
         return false;
     }
@@ -406,6 +812,36 @@ bool QDbfTablePrivate::next() const
     return seek(at() + 1);
 }
 
+bool QDbfTablePrivate::next(const QDbfFilter &filter) const
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::next(): IODevice is not open");
+        return false;
+    }
+
+    const QDbfFilterMatcher matcher(filter, m_tableSchema, m_codec);
+    if (!matcher.isValid()) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    // only the matching record is decoded, by record() afterwards
+    for (int index = qMax(at() + 1, static_cast<int>(QDbfTablePrivate::FirstRow));
+         index < size(); ++index) {
+        const char *data = recordPointer(index);
+        if (!data) {
+            return false;
+        }
+        if (matcher.matches(data)) {
+            return seek(index);
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return false;
+}
+
 bool QDbfTablePrivate::first() const
 {
     return seek(QDbfTablePrivate::FirstRow);
@@ -458,59 +894,49 @@ QDbfRecord QDbfTablePrivate::record() const
         return m_currentRecord;
     }
 
-    const qint64 position = m_headerLength + m_recordLength * m_currentIndex;
+    m_currentRecord.setRecordIndex(m_currentIndex);
+
+    const char *data = recordPointer(m_currentIndex);
 
-    if (!m_file.seek(position)) {
-        m_error = QDbfTable::ReadError;
+    if (!data) {
         return m_currentRecord;
     }
 
-    m_currentRecord.setRecordIndex(m_currentIndex);
+    m_currentRecord.setDeleted(data[0] == '*' ? true : false);
 
-    const QByteArray recordData = m_file.read(m_recordLength);
+    // fields are decoded by QDbfRecord on first access
+    m_currentRecord.setRawData(QByteArray(data, m_recordLength), m_codec, m_memo);
 
-    if (recordData.count() == 0) {
-        m_error = QDbfTable::UnspecifiedError;
-        return m_currentRecord;
+    m_error = QDbfTable::NoError;
+
+    return m_currentRecord;
+}
+
+QDbfRecordView QDbfTablePrivate::recordView() const
+{
+    if (m_currentIndex < QDbfTablePrivate::FirstRow) {
+        return QDbfRecordView();
     }
 
-    m_currentRecord.setDeleted(recordData.at(0) == '*' ? true : false);
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::recordView(): IODevice is not open");
+        return QDbfRecordView();
+    }
 
-    for (int i = 0; i < m_currentRecord.count(); ++i) {
-        const QByteArray byteArray = recordData.mid(m_currentRecord.field(i).offset(),
-                                                    m_currentRecord.field(i).length());
-        QVariant value;
-        switch (m_currentRecord.field(i).type()) {
-        case QVariant::String:
-            value = m_textCodec->toUnicode(byteArray);
-            break;
-        case QVariant::Date:
-            value = QVariant(QDate(byteArray.mid(0, 4).toInt(),
-                                   byteArray.mid(4, 2).toInt(),
-                                   byteArray.mid(6, 2).toInt()));
-            break;
-        case QVariant::Double:
-            value = byteArray.toDouble();
-            break;
-        case QVariant::Bool: {
-            QString val = QString::fromLatin1(byteArray.toUpper());
-            if (val == QLatin1String("T") ||
-                val == QLatin1String("Y")) {
-                value = true;
-            } else {
-                value = false;
-            }
-            break; }
-        default:
-            value = QVariant::Invalid;
-        }
+    if (!m_file.isReadable()) {
+        m_error = QDbfTable::ReadError;
+        return QDbfRecordView();
+    }
 
-        m_currentRecord.setValue(i, value);
+    const char *data = recordPointer(m_currentIndex);
+
+    if (!data) {
+        return QDbfRecordView();
     }
 
     m_error = QDbfTable::NoError;
 
-    return m_currentRecord;
+    return QDbfRecordView(m_schema, m_codec, data, m_currentIndex);
 }
 
 QVariant QDbfTablePrivate::value(int index) const
@@ -538,173 +964,1097 @@ bool QDbfTablePrivate::addRecord(const QDbfRecord &record)
         return false;
     }
 
-    QByteArray data = recordData(record, true);
+    const QByteArray data = recordData(record, true);
+    if (data.isEmpty()) {
+        return false;
+    }
 
-    const qint64 position = m_headerLength + m_recordLength * m_recordsCount;
+    return writeRecords(data, 1);
+}
 
-    if (!m_file.seek(position)) {
-        m_error = QDbfTable::ReadError;
+bool QDbfTablePrivate::addRecords(const QVector<QDbfRecord> &records)
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::addRecords(): IODevice is not open");
         return false;
     }
 
-    if (m_file.write(data) != static_cast<qint64>(m_recordLength) + 1) {
+    if (!m_file.isWritable()) {
         m_error = QDbfTable::WriteError;
         return false;
     }
 
-    int recordsCount = m_recordsCount + 1;
+    if (records.isEmpty()) {
+        m_error = QDbfTable::NoError;
+        return true;
+    }
 
-    unsigned char recordsCountChars[4];
-    int shift = 0;
-    for (int i = 0; i < 4; ++i) {
-        recordsCountChars[i] = recordsCount >> shift;
-        shift += 8;
+    QByteArray data(m_recordLength * records.size() + 1, ' ');
+    char *pointer = data.data();
+    for (int i = 0; i < records.size(); ++i) {
+        if (!encodeRecord(records.at(i), pointer)) {
+            return false;
+        }
+        pointer += m_recordLength;
+    }
+    *pointer = END_OF_FILE_MARK;
+
+    return writeRecords(data, records.size());
+}
+
+bool QDbfTablePrivate::writeRecords(const QByteArray &data, int count, bool updateHeader)
+{
+    if (count <= 0 || data.size() != m_recordLength * count + 1) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
     }
 
-    if (!m_file.seek(4)) {
+    const int firstIndex = m_recordsCount;
+    const qint64 position = m_headerLength + static_cast<qint64>(m_recordLength) * firstIndex;
+
+    if (!m_file.seek(position)) {
         m_error = QDbfTable::ReadError;
         return false;
     }
 
-    if (m_file.write((const char *) recordsCountChars, 4) != 4) {
+    if (m_file.write(data) != data.size()) {
         m_error = QDbfTable::WriteError;
         return false;
     }
 
-    m_recordsCount++;
+    // bulk loads write the records count once, after their last batch
+    const int recordsCount = m_recordsCount + count;
+    if (updateHeader && !writeRecordsCount(recordsCount)) {
+        return false;
+    }
 
-    m_error = QDbfTable::NoError;
+    m_recordsCount = recordsCount;
 
-    return true;
-}
+    if (m_deletionMapValid) {
+        m_deletionMap.resize(m_recordsCount);
+        for (int i = 0; i < count; ++i) {
+            if (data.at(i * m_recordLength) == '*') {
+                m_deletionMap.setDeleted(firstIndex + i, true);
+            }
+        }
+    }
 
-bool QDbfTablePrivate::updateRecordInTable(const QDbfRecord &record)
-{
-    if (!isOpen()) {
-        qWarning("QDbfTablePrivate::addRecord(): IODevice is not open");
-        return false;
+    invalidateReadBuffer();
+
+    if (isMapped()) {
+        m_file.flush();
     }
 
-    if (!m_file.isWritable()) {
+    if (canUpdateIndex() && !indexRecords(data.constData(), firstIndex, count)) {
         m_error = QDbfTable::WriteError;
         return false;
     }
 
-    QByteArray data = recordData(record);
+    m_error = QDbfTable::NoError;
 
-    const qint64 position = m_headerLength + m_recordLength * record.recordIndex();
+    return true;
+}
 
-    if (!m_file.seek(position)) {
+bool QDbfTablePrivate::writeRecordsCount(int recordsCount)
+{
+    // last update date and records count are adjacent, one write covers both
+    const QDate currentDate = QDate::currentDate();
+    unsigned char header[7];
+    header[0] = (currentDate.year() - 1900) & 0xFF;
+    header[1] = currentDate.month();
+    header[2] = currentDate.day();
+    int shift = 0;
+    for (int i = 0; i < 4; ++i) {
+        header[3 + i] = recordsCount >> shift;
+        shift += 8;
+    }
+
+    if (!m_file.seek(LAST_UPDATE_OFFSET)) {
         m_error = QDbfTable::ReadError;
         return false;
     }
 
-    if (m_file.write(data) != static_cast<qint64>(m_recordLength)) {
+    if (m_file.write(reinterpret_cast<const char *>(header), 7) != 7) {
         m_error = QDbfTable::WriteError;
         return false;
     }
 
-    m_error = QDbfTable::NoError;
-
+    return true;
+}
+
+bool QDbfTablePrivate::updateRecordInTable(const QDbfRecord &record)
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::addRecord(): IODevice is not open");
+        return false;
+    }
+
+    if (!m_file.isWritable()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    // fields outside of the projection and memo block references keep
+    // their stored bytes
+    const char *baseData = recordPointer(record.recordIndex());
+    if (!baseData) {
+        return false;
+    }
+
+    const QByteArray data = recordData(record, false, baseData);
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    // the key of the stored record has to be taken before it is overwritten
+    QByteArray previousKey;
+    if (canUpdateIndex()) {
+        previousKey = m_index->recordKey(baseData);
+    }
+
+    const qint64 position = m_headerLength + static_cast<qint64>(m_recordLength) * record.recordIndex();
+
+    if (!m_file.seek(position)) {
+        m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    if (m_file.write(data) != static_cast<qint64>(m_recordLength)) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (m_deletionMapValid) {
+        m_deletionMap.setDeleted(record.recordIndex(), record.isDeleted());
+    }
+
+    invalidateReadBuffer();
+
+    if (isMapped()) {
+        m_file.flush();
+    }
+
+    if (!previousKey.isEmpty()) {
+        const QByteArray key = m_index->recordKey(data.constData());
+        const quint32 recordNumber = record.recordIndex() + 1;
+        if (key != previousKey &&
+            (!m_index->removeKey(previousKey, recordNumber) ||
+             !m_index->insertKeys(QVector<QDbfIndexKey>() << QDbfIndexKey(key, recordNumber)))) {
+            qWarning("QDbfTablePrivate::updateRecordInTable(): failed to update index %s",
+                     qPrintable(m_index->fileName()));
+            m_indexStale = true;
+            m_error = QDbfTable::WriteError;
+            return false;
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
     return true;
 }
 
 bool QDbfTablePrivate::removeRecord(int index)
 {
-    if (!isOpen()) {
-        qWarning("QDbfTablePrivate::removeRecord(): IODevice is not open");
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::removeRecord(): IODevice is not open");
+        return false;
+    }
+
+    if (!m_file.isWritable()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (index < QDbfTablePrivate::FirstRow ||
+        index > (size() - 1)) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    // deleted records keep their index keys, dBASE does the same
+    const qint64 position = m_headerLength + static_cast<qint64>(m_recordLength) * index;
+
+    if (!m_file.seek(position)) {
+        m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    quint8 byte = '*';
+
+    if (m_file.write(reinterpret_cast<char *>(&byte), 1) != 1) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (m_deletionMapValid) {
+        m_deletionMap.setDeleted(index, true);
+    }
+
+    invalidateReadBuffer();
+
+    if (isMapped()) {
+        m_file.flush();
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::pack(QDbfProgressHandler *handler)
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::pack(): IODevice is not open");
+        return false;
+    }
+
+    if (!m_file.isWritable()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (m_recordLength <= 0) {
+        m_error = QDbfTable::ReadError;
+        return false;
+    }
+
+    const bool mapped = isMapped();
+    unmapFile();
+    invalidateReadBuffer();
+    m_bufered = false;
+    m_currentIndex = QDbfTablePrivate::BeforeFirstRow;
+
+    // live records move towards the start of the file through one buffer.
+    // They are only ever written over deleted records or records already
+    // moved, and the header count is lowered last, so an interrupted pack
+    // loses no live record. It does leave the records moved so far at their
+    // old slots as well, and the table then holds duplicates of them.
+    const int chunkCount = qMax(1, PACK_BUFFER_SIZE / static_cast<int>(m_recordLength));
+    QByteArray buffer(chunkCount * m_recordLength, ' ');
+    int liveCount = 0;
+    for (int first = QDbfTablePrivate::FirstRow; first < m_recordsCount; first += chunkCount) {
+        const int count = qMin(chunkCount, m_recordsCount - first);
+        const qint64 length = static_cast<qint64>(count) * m_recordLength;
+        if (!m_file.seek(m_headerLength + static_cast<qint64>(m_recordLength) * first) ||
+            m_file.read(buffer.data(), length) != length) {
+            m_error = QDbfTable::ReadError;
+            return false;
+        }
+
+        char *out = buffer.data();
+        int keptCount = 0;
+        for (int i = 0; i < count; ++i) {
+            const char *data = buffer.constData() + i * m_recordLength;
+            if (data[0] == '*') {
+                continue;
+            }
+            if (out != data) {
+                memcpy(out, data, m_recordLength);
+            }
+            out += m_recordLength;
+            ++keptCount;
+        }
+
+        // records before the first deleted one stay where they are
+        if (keptCount > 0 && (liveCount != first || keptCount != count)) {
+            const qint64 keptLength = static_cast<qint64>(keptCount) * m_recordLength;
+            if (!m_file.seek(m_headerLength + static_cast<qint64>(m_recordLength) * liveCount) ||
+                m_file.write(buffer.constData(), keptLength) != keptLength) {
+                m_error = QDbfTable::WriteError;
+                return false;
+            }
+        }
+        liveCount += keptCount;
+
+        if (handler) {
+            handler->progress(first + count, m_recordsCount);
+        }
+    }
+
+    const qint64 end = m_headerLength + static_cast<qint64>(m_recordLength) * liveCount;
+    const char endOfFileMark = END_OF_FILE_MARK;
+    if (!m_file.seek(end) || m_file.write(&endOfFileMark, 1) != 1 ||
+        !writeRecordsCount(liveCount) || !m_file.flush() ||
+        !m_file.resize(end + 1)) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    m_recordsCount = liveCount;
+    m_deletionMap.clear();
+    m_deletionMap.resize(m_recordsCount);
+    m_deletionMapValid = true;
+
+    if (mapped) {
+        mapFile();
+    }
+
+    // keys of an attached index point at record numbers that have moved
+    if (m_index) {
+        if (!m_index->isWritable() || !m_index->hasExpression()) {
+            qWarning("QDbfTablePrivate::pack(): index %s can not be rebuilt",
+                     qPrintable(m_index->fileName()));
+            m_indexStale = true;
+        } else if (!rebuildIndex()) {
+            m_indexStale = true;
+            return false;
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::updateDeletionMap() const
+{
+    if (m_deletionMapValid) {
+        return true;
+    }
+
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::updateDeletionMap(): IODevice is not open");
+        return false;
+    }
+
+    // only the first byte of every record is looked at, through the mapping
+    // or the read window
+    m_deletionMap.resize(m_recordsCount);
+    for (int i = 0; i < m_recordsCount; ++i) {
+        const char *data = recordPointer(i);
+        if (!data) {
+            m_deletionMap.clear();
+            return false;
+        }
+        if (data[0] == '*') {
+            m_deletionMap.setDeleted(i, true);
+        }
+    }
+
+    m_deletionMapValid = true;
+
+    return true;
+}
+
+int QDbfTablePrivate::deletedRecordsCount() const
+{
+    return updateDeletionMap() ? m_deletionMap.deletedCount() : -1;
+}
+
+int QDbfTablePrivate::liveRecordsCount() const
+{
+    return updateDeletionMap() ? m_deletionMap.liveCount() : -1;
+}
+
+int QDbfTablePrivate::liveRow(int index) const
+{
+    return updateDeletionMap() ? m_deletionMap.row(index) : -1;
+}
+
+int QDbfTablePrivate::liveRecordIndex(int row) const
+{
+    return updateDeletionMap() ? m_deletionMap.recordIndex(row) : -1;
+}
+
+bool QDbfTablePrivate::scanParallel(QDbfScanHandler *handler, const QDbfFilter *filter,
+                                    int first, int count, int threadCount) const
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::scanParallel(): IODevice is not open");
+        return false;
+    }
+
+    if (count < 0) {
+        count = size() - first;
+    }
+
+    if (!handler || first < QDbfTablePrivate::FirstRow || count < 0 || first + count > size()) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    const QDbfFilterMatcher matcher(filter ? *filter : QDbfFilter(), m_tableSchema, m_codec);
+    if (!matcher.isValid()) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    m_error = QDbfTable::NoError;
+
+    if (count == 0) {
+        return true;
+    }
+
+    // one chunk fills one read window of a reader
+    const int chunkSize = qMax(1, m_readBufferSize / qMax(1, static_cast<int>(m_recordLength)));
+    const int chunksCount = (count - 1) / chunkSize + 1;
+
+    if (threadCount <= 0) {
+        threadCount = QThread::idealThreadCount();
+    }
+    threadCount = qBound(1, threadCount, chunksCount);
+
+    // readers open the file on their own and must see every written record
+    if (m_file.isWritable()) {
+        m_file.flush();
+    }
+
+    const QDbfFilterMatcher *taskMatcher = filter && !filter->isEmpty() ? &matcher : 0;
+    QAtomicInt nextChunk(0);
+    QVector<QDbfScanTask *> tasks;
+    tasks.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        QDbfScanTask *task = new QDbfScanTask(handler, taskMatcher, i, &nextChunk,
+                                              chunksCount, chunkSize, first, first + count);
+        tasks.append(task);
+        if (!task->m_reader.open(this)) {
+            m_error = task->m_reader.error();
+            qDeleteAll(tasks);
+            return false;
+        }
+    }
+
+    if (threadCount == 1) {
+        tasks.first()->run();
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            pool.start(tasks.at(i));
+        }
+        pool.waitForDone();
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        if (tasks.at(i)->m_error != QDbfTable::NoError) {
+            m_error = tasks.at(i)->m_error;
+            break;
+        }
+    }
+
+    qDeleteAll(tasks);
+
+    return m_error == QDbfTable::NoError;
+}
+
+QVector<QDbfAggregate> QDbfTablePrivate::aggregate(const QStringList &fieldNames,
+                                                   const QDbfFilter &filter, int threadCount) const
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::aggregate(): IODevice is not open");
+        return QVector<QDbfAggregate>();
+    }
+
+    // fields are read from the record bytes, so a projection does not hide any
+    QDbfAggregator aggregator;
+    for (int i = 0; i < fieldNames.size(); ++i) {
+        if (!aggregator.addField(m_tableRecord, fieldNames.at(i))) {
+            m_error = QDbfTable::UnspecifiedError;
+            return QVector<QDbfAggregate>();
+        }
+    }
+
+    if (threadCount <= 0) {
+        threadCount = QThread::idealThreadCount();
+    }
+    threadCount = qMax(1, threadCount);
+    aggregator.setThreadCount(threadCount);
+
+    if (!scanParallel(&aggregator, &filter, QDbfTablePrivate::FirstRow, -1, threadCount)) {
+        return QVector<QDbfAggregate>();
+    }
+
+    return aggregator.results();
+}
+
+bool QDbfTablePrivate::columnField(const QString &fieldName, int first, int count,
+                                   QDbfField *field) const
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::readColumn(): IODevice is not open");
+        return false;
+    }
+
+    const int index = m_tableRecord.indexOf(fieldName);
+    if (index < 0 || first < QDbfTablePrivate::FirstRow || count < 0 || first + count > size()) {
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    *field = m_tableRecord.field(index);
+
+    return true;
+}
+
+bool QDbfTablePrivate::readColumn(const QString &fieldName, int first, int count,
+                                  QVector<double> *values, QByteArray *validity) const
+{
+    QDbfField field;
+    if (!columnField(fieldName, first, count, &field)) {
+        return false;
+    }
+
+    if (field.dbfType() != QDbfField::Number && field.dbfType() != QDbfField::FloatingPoint) {
+        qWarning("QDbfTablePrivate::readColumn(): %s is not a number field", qPrintable(fieldName));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    // blank and unreadable numbers are NaN and have their validity bit clear
+    values->resize(count);
+    if (validity) {
+        validity->fill(0, (count + 7) / 8);
+    }
+
+    const int offset = field.offset();
+    const int length = field.length();
+    double *out = values->data();
+    for (int i = 0; i < count; ++i) {
+        const char *data = recordPointer(first + i);
+        if (!data) {
+            return false;
+        }
+        if (parseNumber(data + offset, length, out + i) == NumberValid) {
+            if (validity) {
+                setBit(validity, i);
+            }
+        } else {
+            out[i] = qQNaN();
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::readScaledColumn(const QString &fieldName, int first, int count,
+                                        QVector<qint64> *values, QByteArray *validity) const
+{
+    QDbfField field;
+    if (!columnField(fieldName, first, count, &field)) {
+        return false;
+    }
+
+    if (field.dbfType() != QDbfField::Number) {
+        qWarning("QDbfTablePrivate::readScaledColumn(): %s is not an N field", qPrintable(fieldName));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    values->resize(count);
+    if (validity) {
+        validity->fill(0, (count + 7) / 8);
+    }
+
+    const int offset = field.offset();
+    const int length = field.length();
+    const int scale = qMax(0, field.precision());
+    qint64 *out = values->data();
+    for (int i = 0; i < count; ++i) {
+        const char *data = recordPointer(first + i);
+        if (!data) {
+            return false;
+        }
+        if (parseScaledNumber(data + offset, length, scale, out + i) == NumberValid) {
+            if (validity) {
+                setBit(validity, i);
+            }
+        } else {
+            out[i] = 0;
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::readDateColumn(const QString &fieldName, int first, int count,
+                                      QVector<qint32> *julianDays, QByteArray *validity) const
+{
+    QDbfField field;
+    if (!columnField(fieldName, first, count, &field)) {
+        return false;
+    }
+
+    if (field.dbfType() != QDbfField::Date || field.length() < DATE_LENGTH) {
+        qWarning("QDbfTablePrivate::readDateColumn(): %s is not a date field", qPrintable(fieldName));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    julianDays->resize(count);
+    if (validity) {
+        validity->fill(0, (count + 7) / 8);
+    }
+
+    const int offset = field.offset();
+    qint32 *out = julianDays->data();
+    for (int i = 0; i < count; ++i) {
+        const char *data = recordPointer(first + i);
+        if (!data) {
+            return false;
+        }
+        data += offset;
+
+        const int year = parseDigits(data, 4);
+        const int month = parseDigits(data + 4, 2);
+        const int day = parseDigits(data + 6, 2);
+        const QDate date = year > 0 && month > 0 && day > 0 ? QDate(year, month, day) : QDate();
+        if (date.isValid()) {
+            out[i] = static_cast<qint32>(date.toJulianDay());
+            if (validity) {
+                setBit(validity, i);
+            }
+        } else {
+            out[i] = 0;
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::readLogicalColumn(const QString &fieldName, int first, int count,
+                                         QByteArray *values, QByteArray *validity) const
+{
+    QDbfField field;
+    if (!columnField(fieldName, first, count, &field)) {
+        return false;
+    }
+
+    if (field.dbfType() != QDbfField::Logical || field.length() < 1) {
+        qWarning("QDbfTablePrivate::readLogicalColumn(): %s is not a logical field",
+                 qPrintable(fieldName));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    values->fill(0, (count + 7) / 8);
+    if (validity) {
+        validity->fill(0, (count + 7) / 8);
+    }
+
+    const int offset = field.offset();
+    for (int i = 0; i < count; ++i) {
+        const char *data = recordPointer(first + i);
+        if (!data) {
+            return false;
+        }
+
+        // '?' and blanks are unknown values
+        switch (data[offset]) {
+        case 'T': case 't': case 'Y': case 'y':
+            setBit(values, i);
+            // fall through
+        case 'F': case 'f': case 'N': case 'n':
+            if (validity) {
+                setBit(validity, i);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::readStringColumn(const QString &fieldName, int first, int count,
+                                        QVector<qint32> *offsets, QByteArray *data,
+                                        QByteArray *validity) const
+{
+    QDbfField field;
+    if (!columnField(fieldName, first, count, &field)) {
+        return false;
+    }
+
+    if (field.dbfType() != QDbfField::Character) {
+        qWarning("QDbfTablePrivate::readStringColumn(): %s is not a character field",
+                 qPrintable(fieldName));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    // value i is data[offsets[i], offsets[i + 1]) in UTF-8 without the
+    // trailing blanks; character fields always have a value
+    offsets->resize(count + 1);
+    data->clear();
+    data->reserve(count * field.length());
+    if (validity) {
+        validity->fill(static_cast<char>(0xFF), (count + 7) / 8);
+    }
+
+    const int offset = field.offset();
+    qint32 *out = offsets->data();
+    for (int i = 0; i < count; ++i) {
+        const char *recordData = recordPointer(first + i);
+        if (!recordData) {
+            return false;
+        }
+        recordData += offset;
+
+        int length = field.length();
+        while (length > 0 && recordData[length - 1] == ' ') {
+            --length;
+        }
+
+        out[i] = data->size();
+        m_codec->appendUtf8(recordData, length, data);
+    }
+    out[count] = data->size();
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+bool QDbfTablePrivate::openIndex(const QString &fileName, const QString &tagName)
+{
+    if (!isOpen()) {
+        qWarning("QDbfTablePrivate::openIndex(): IODevice is not open");
+        return false;
+    }
+
+    closeIndex();
+
+    m_index = QDbfIndexFile::open(fileName, tagName, m_codec, m_tableRecord,
+                                  m_file.isWritable());
+    if (!m_index) {
+        m_error = QDbfTable::OpenError;
+        return false;
+    }
+
+    if (!m_index->compileExpression(m_tableRecord) && m_file.isWritable()) {
+        qWarning("QDbfTablePrivate::openIndex(): key expression %s is not supported, "
+                 "index %s will not be updated", qPrintable(m_index->keyExpression()),
+                 qPrintable(fileName));
+    }
+
+    m_error = QDbfTable::NoError;
+
+    return true;
+}
+
+void QDbfTablePrivate::closeIndex()
+{
+    delete m_index;
+    m_index = 0;
+    m_indexStale = false;
+}
+
+bool QDbfTablePrivate::seekKey(const QVariant &from, const QVariant &to) const
+{
+    if (!m_index) {
+        qWarning("QDbfTablePrivate::seekKey(): no index is open");
         return false;
     }
 
-    if (!m_file.isWritable()) {
-        m_error = QDbfTable::WriteError;
+    if (m_indexStale) {
+        qWarning("QDbfTablePrivate::seekKey(): index %s is out of date",
+                 qPrintable(m_index->fileName()));
+        m_error = QDbfTable::UnspecifiedError;
         return false;
     }
 
-    if (index < QDbfTablePrivate::FirstRow ||
-        index > (size() - 1)) {
+    const QByteArray key = m_index->encodeKey(from);
+    const QByteArray upperBound = to.isValid() ? m_index->encodeKey(to) : QByteArray();
+    if (key.isEmpty() || (to.isValid() && upperBound.isEmpty())) {
         m_error = QDbfTable::UnspecifiedError;
         return false;
     }
 
-    const qint64 position = m_headerLength + m_recordLength * index;
+    m_index->setUpperBound(upperBound);
+    if (!m_index->seek(key)) {
+        return false;
+    }
 
-    if (!m_file.seek(position)) {
-        m_error = QDbfTable::ReadError;
+    return seekIndexRecord();
+}
+
+bool QDbfTablePrivate::firstKey() const
+{
+    if (!m_index) {
+        qWarning("QDbfTablePrivate::firstKey(): no index is open");
+        return false;
+    }
+
+    if (m_indexStale) {
+        qWarning("QDbfTablePrivate::firstKey(): index %s is out of date",
+                 qPrintable(m_index->fileName()));
+        m_error = QDbfTable::UnspecifiedError;
+        return false;
+    }
+
+    m_index->setUpperBound(QByteArray());
+    if (!m_index->first()) {
+        return false;
+    }
+
+    return seekIndexRecord();
+}
+
+bool QDbfTablePrivate::nextKey() const
+{
+    if (!m_index || !m_index->next()) {
         return false;
     }
 
-    const QByteArray recordData = m_file.read(m_recordLength);
+    return seekIndexRecord();
+}
 
-    if (recordData.count() != m_recordLength) {
+bool QDbfTablePrivate::seekIndexRecord() const
+{
+    const int index = m_index->recordIndex();
+    if (index < QDbfTablePrivate::FirstRow || index > (size() - 1)) {
+        qWarning("QDbfTablePrivate::seekIndexRecord(): index %s is out of date",
+                 qPrintable(m_index->fileName()));
         m_error = QDbfTable::UnspecifiedError;
         return false;
     }
 
-    quint8 byte = '*';
+    m_error = QDbfTable::NoError;
 
-    if (m_file.write(reinterpret_cast<char *>(&byte), 1) != 1) {
+    return seek(index);
+}
+
+bool QDbfTablePrivate::setIndexUpdatesDeferred(bool deferred)
+{
+    m_indexUpdatesDeferred = deferred;
+
+    // keys skipped while deferred are brought back in one pass
+    if (!deferred && m_index && m_indexStale) {
+        return rebuildIndex();
+    }
+
+    return true;
+}
+
+bool QDbfTablePrivate::rebuildIndex()
+{
+    if (!m_index) {
+        qWarning("QDbfTablePrivate::rebuildIndex(): no index is open");
+        return false;
+    }
+
+    if (!m_index->isWritable() || !m_index->hasExpression()) {
+        m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    QVector<QDbfIndexKey> keys;
+    keys.reserve(size());
+    for (int i = QDbfTablePrivate::FirstRow; i < size(); ++i) {
+        const char *data = recordPointer(i);
+        if (!data) {
+            return false;
+        }
+        keys.append(QDbfIndexKey(m_index->recordKey(data), i + 1));
+    }
+
+    if (!m_index->rebuild(keys)) {
+        qWarning("QDbfTablePrivate::rebuildIndex(): failed to write index %s",
+                 qPrintable(m_index->fileName()));
         m_error = QDbfTable::WriteError;
         return false;
     }
 
+    m_indexStale = false;
     m_error = QDbfTable::NoError;
 
     return true;
 }
 
-void QDbfTablePrivate::setTextCodec()
+bool QDbfTablePrivate::canUpdateIndex()
 {
-    switch (m_codepage) {
-    case QDbfTable::Windows1251:
-        m_textCodec = QTextCodec::codecForName("Windows-1251");
+    if (!m_index || m_indexStale) {
+        return false;
+    }
+
+    if (m_indexUpdatesDeferred) {
+        m_indexStale = true;
+        return false;
+    }
+
+    if (!m_index->isWritable() || !m_index->hasExpression()) {
+        qWarning("QDbfTablePrivate: index %s can not be updated and is out of date now",
+                 qPrintable(m_index->fileName()));
+        m_indexStale = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool QDbfTablePrivate::indexRecords(const char *data, int firstIndex, int count)
+{
+    QVector<QDbfIndexKey> keys;
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        keys.append(QDbfIndexKey(m_index->recordKey(data + i * m_recordLength), firstIndex + i + 1));
+    }
+
+    if (!m_index->insertKeys(keys)) {
+        qWarning("QDbfTablePrivate::indexRecords(): failed to update index %s",
+                 qPrintable(m_index->fileName()));
+        m_indexStale = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool QDbfTablePrivate::openMemoFile(quint8 versionNumber)
+{
+    closeMemoFile();
+
+    bool hasMemo = false;
+    for (int i = 0; i < m_tableRecord.count(); ++i) {
+        if (m_tableRecord.field(i).dbfType() == QDbfField::Memo) {
+            hasMemo = true;
+            break;
+        }
+    }
+
+    if (!hasMemo) {
+        return true;
+    }
+
+    QDbfMemoFile::Format format = QDbfMemoFile::DBase3;
+    QString suffix = QLatin1String("dbt");
+    switch (versionNumber) {
+    case 48:
+    case 49:
+    case 245:
+        format = QDbfMemoFile::FoxPro;
+        suffix = QLatin1String("fpt");
         break;
-    case QDbfTable::IBM866:
-        m_textCodec = QTextCodec::codecForName("IBM 866");
+    case 139:
+    case 203:
+        format = QDbfMemoFile::DBase4;
         break;
     default:
-        m_textCodec = QTextCodec::codecForLocale();
+        break;
+    }
+
+    const QFileInfo fileInfo(m_fileName);
+    const QString baseName = fileInfo.path() + QLatin1Char('/') + fileInfo.completeBaseName() +
+            QLatin1Char('.');
+
+    // the suffix is tried in lower and in upper case
+    m_memo = new QDbfMemoFile();
+    if (!m_memo->open(baseName + suffix, format) &&
+        !m_memo->open(baseName + suffix.toUpper(), format)) {
+        closeMemoFile();
+        return false;
     }
+
+    m_memo->setCacheSize(m_memoCacheSize);
+
+    return true;
+}
+
+void QDbfTablePrivate::closeMemoFile()
+{
+    if (m_memo && !m_memo->ref.deref()) {
+        delete m_memo;
+    }
+
+    m_memo = 0;
+}
+
+void QDbfTablePrivate::setTextCodec()
+{
+    m_codec = QDbfCodec::codecForCodepage(m_codepage);
+}
+
+QByteArray QDbfTablePrivate::recordData(const QDbfRecord &record, bool addEndOfFileMark,
+                                        const char *baseData) const
+{
+    QByteArray data(m_recordLength + (addEndOfFileMark ? 1 : 0), ' ');
+    if (!encodeRecord(record, data.data(), baseData)) {
+        return QByteArray();
+    }
+
+    if (addEndOfFileMark) {
+        data[m_recordLength] = END_OF_FILE_MARK;
+    }
+
+    return data;
 }
 
-QByteArray QDbfTablePrivate::recordData(const QDbfRecord &record, bool addEndOfFileMark) const
+bool QDbfTablePrivate::encodeRecord(const QDbfRecord &record, char *data,
+                                    const char *baseData) const
 {
-    QByteArray data;
-    data.append(record.isDeleted() ? '*' : ' ');
+    if (baseData) {
+        memcpy(data, baseData, m_recordLength);
+    } else {
+        memset(data, ' ', m_recordLength);
+    }
+
+    data[0] = record.isDeleted() ? '*' : ' ';
 
     for (int i = 0; i < m_record.count(); ++i) {
         if (m_record.field(i).d != record.field(i).d) {
             m_error = QDbfTable::UnspecifiedError;
-            return data;
+            return false;
         }
-        switch (record.field(i).dbfType()) {
-        case QDbfField::Character:
-            data.append(m_textCodec->fromUnicode(record.field(i).value().toString().leftJustified(record.field(i).length(), QLatin1Char(' '), true)));
+
+        const QDbfField field = record.field(i);
+        const int fieldLength = field.length();
+        if (field.offset() + fieldLength > m_recordLength) {
+            m_error = QDbfTable::UnspecifiedError;
+            return false;
+        }
+
+        char *fieldPointer = data + field.offset();
+        switch (field.dbfType()) {
+        case QDbfField::Character: {
+            const QString string = field.value().toString();
+            const int length = m_codec->fromUnicode(string.constData(), string.length(),
+                                                    fieldPointer, fieldLength);
+            memset(fieldPointer + length, ' ', fieldLength - length);
             break;
+        }
         case QDbfField::Date:
-            data.append(record.field(i).value().toDate().toString(QString(QLatin1String("yyyyMMdd"))).leftJustified(record.field(i).length(), QLatin1Char(' '), true).toLatin1());
+            formatDate(field.value().toDate(), fieldPointer, fieldLength);
             break;
         case QDbfField::FloatingPoint:
         case QDbfField::Number:
-            data.append(QString(QLatin1String("%1")).arg(record.field(i).value().toDouble(), 0, 'f', record.field(i).precision()).rightJustified(record.field(i).length(), QLatin1Char(' '), true).toLatin1());
+            formatNumber(field.value().toDouble(), field.precision(), fieldPointer, fieldLength);
             break;
         case QDbfField::Logical:
-            data.append(record.field(i).value().toBool() ? 'T' : 'F');
+            if (fieldLength > 0) {
+                fieldPointer[0] = field.value().toBool() ? 'T' : 'F';
+                memset(fieldPointer + 1, ' ', fieldLength - 1);
+            }
             break;
         default:
-            data.append(QString(QLatin1String("")).leftJustified(record.field(i).length(), QLatin1Char(' '), true).toLatin1());
+            // keep the stored bytes of fields that can not be encoded
+            if (!baseData) {
+                memset(fieldPointer, ' ', fieldLength);
+            }
+            break;
         }
     }
 
-    if (addEndOfFileMark) {
-        data.append(QChar(26).toLatin1());
-    }
-
-    return data;
+    return true;
 }
 
 } // namespace Internal
 
+QDbfScanHandler::~QDbfScanHandler()
+{
+}
+
+QDbfProgressHandler::~QDbfProgressHandler()
+{
+}
+
 QDbfTable::QDbfTable() :
     d(new Internal::QDbfTablePrivate())
 {
@@ -758,14 +2108,64 @@ QDbfTable::OpenMode QDbfTable::openMode() const
     return d->m_openMode;
 }
 
+QDbfTable::OpenOptions QDbfTable::openOptions() const
+{
+    return d->m_openOptions;
+}
+
+bool QDbfTable::isMapped() const
+{
+    return d->isMapped();
+}
+
+bool QDbfTable::setProjection(const QStringList &fieldNames)
+{
+    return d->setProjection(fieldNames);
+}
+
+bool QDbfTable::setProjection(const QList<int> &fieldIndexes)
+{
+    return d->setProjection(fieldIndexes);
+}
+
+void QDbfTable::clearProjection()
+{
+    d->clearProjection();
+}
+
+QList<int> QDbfTable::projection() const
+{
+    return d->m_projection.toList();
+}
+
+void QDbfTable::setReadBufferSize(int size)
+{
+    d->setReadBufferSize(size);
+}
+
+int QDbfTable::readBufferSize() const
+{
+    return d->readBufferSize();
+}
+
+void QDbfTable::setMemoCacheSize(int size)
+{
+    d->setMemoCacheSize(size);
+}
+
+int QDbfTable::memoCacheSize() const
+{
+    return d->memoCacheSize();
+}
+
 QDbfTable::DbfTableError QDbfTable::error() const
 {
     return d->m_error;
 }
 
-bool QDbfTable::open(const QString &fileName, OpenMode openMode)
+bool QDbfTable::open(const QString &fileName, OpenMode openMode, OpenOptions openOptions)
 {
-    return d->open(fileName, openMode);
+    return d->open(fileName, openMode, openOptions);
 }
 
 void QDbfTable::close()
@@ -773,9 +2173,9 @@ void QDbfTable::close()
     d->close();
 }
 
-bool QDbfTable::open(OpenMode openMode)
+bool QDbfTable::open(OpenMode openMode, OpenOptions openOptions)
 {
-    return d->open(openMode);
+    return d->open(openMode, openOptions);
 }
 
 bool QDbfTable::setCodepage(QDbfTable::Codepage codepage)
@@ -813,6 +2213,11 @@ bool QDbfTable::next() const
     return d->next();
 }
 
+bool QDbfTable::next(const QDbfFilter &filter) const
+{
+    return d->next(filter);
+}
+
 bool QDbfTable::first() const
 {
     return d->first();
@@ -833,6 +2238,127 @@ QDbfRecord QDbfTable::record() const
     return d->record();
 }
 
+QDbfRecordView QDbfTable::recordView() const
+{
+    return d->recordView();
+}
+
+bool QDbfTable::openIndex(const QString &fileName, const QString &tagName)
+{
+    return d->openIndex(fileName, tagName);
+}
+
+void QDbfTable::closeIndex()
+{
+    d->closeIndex();
+}
+
+bool QDbfTable::hasIndex() const
+{
+    return d->m_index != 0;
+}
+
+QString QDbfTable::indexKeyExpression() const
+{
+    return d->m_index ? d->m_index->keyExpression() : QString();
+}
+
+bool QDbfTable::seekKey(const QVariant &key) const
+{
+    return d->seekKey(key, key);
+}
+
+bool QDbfTable::seekKeyRange(const QVariant &from, const QVariant &to) const
+{
+    return d->seekKey(from, to);
+}
+
+bool QDbfTable::firstKey() const
+{
+    return d->firstKey();
+}
+
+bool QDbfTable::nextKey() const
+{
+    return d->nextKey();
+}
+
+bool QDbfTable::setIndexUpdatesDeferred(bool deferred)
+{
+    return d->setIndexUpdatesDeferred(deferred);
+}
+
+bool QDbfTable::indexUpdatesDeferred() const
+{
+    return d->m_indexUpdatesDeferred;
+}
+
+bool QDbfTable::rebuildIndex()
+{
+    return d->rebuildIndex();
+}
+
+bool QDbfTable::scanParallel(QDbfScanHandler *handler, int threadCount) const
+{
+    return d->scanParallel(handler, 0, 0, -1, threadCount);
+}
+
+bool QDbfTable::scanParallel(QDbfScanHandler *handler, int first, int count,
+                             int threadCount) const
+{
+    return d->scanParallel(handler, 0, first, count, threadCount);
+}
+
+bool QDbfTable::scanParallel(QDbfScanHandler *handler, const QDbfFilter &filter,
+                             int threadCount) const
+{
+    return d->scanParallel(handler, &filter, 0, -1, threadCount);
+}
+
+QVector<QDbfAggregate> QDbfTable::aggregate(const QStringList &fieldNames, int threadCount) const
+{
+    QDbfFilter filter;
+    filter.setDeletedState(QDbfFilter::NotDeleted);
+    return d->aggregate(fieldNames, filter, threadCount);
+}
+
+QVector<QDbfAggregate> QDbfTable::aggregate(const QStringList &fieldNames, const QDbfFilter &filter,
+                                            int threadCount) const
+{
+    return d->aggregate(fieldNames, filter, threadCount);
+}
+
+bool QDbfTable::readColumn(const QString &fieldName, int first, int count, QVector<double> *values,
+                           QByteArray *validity) const
+{
+    return d->readColumn(fieldName, first, count, values, validity);
+}
+
+bool QDbfTable::readScaledColumn(const QString &fieldName, int first, int count,
+                                 QVector<qint64> *values, QByteArray *validity) const
+{
+    return d->readScaledColumn(fieldName, first, count, values, validity);
+}
+
+bool QDbfTable::readDateColumn(const QString &fieldName, int first, int count,
+                               QVector<qint32> *julianDays, QByteArray *validity) const
+{
+    return d->readDateColumn(fieldName, first, count, julianDays, validity);
+}
+
+bool QDbfTable::readLogicalColumn(const QString &fieldName, int first, int count,
+                                  QByteArray *values, QByteArray *validity) const
+{
+    return d->readLogicalColumn(fieldName, first, count, values, validity);
+}
+
+bool QDbfTable::readStringColumn(const QString &fieldName, int first, int count,
+                                 QVector<qint32> *offsets, QByteArray *data,
+                                 QByteArray *validity) const
+{
+    return d->readStringColumn(fieldName, first, count, offsets, data, validity);
+}
+
 QVariant QDbfTable::value(int index) const
 {
     return d->value(index);
@@ -848,6 +2374,11 @@ bool QDbfTable::addRecord(const QDbfRecord &record)
     return d->addRecord(record);
 }
 
+bool QDbfTable::addRecords(const QVector<QDbfRecord> &records)
+{
+    return d->addRecords(records);
+}
+
 bool QDbfTable::updateRecordInTable(const QDbfRecord &record)
 {
     return d->updateRecordInTable(record);
@@ -858,6 +2389,31 @@ bool QDbfTable::removeRecord(int index)
     return d->removeRecord(index);
 }
 
+bool QDbfTable::pack(QDbfProgressHandler *handler)
+{
+    return d->pack(handler);
+}
+
+int QDbfTable::deletedRecordsCount() const
+{
+    return d->deletedRecordsCount();
+}
+
+int QDbfTable::liveRecordsCount() const
+{
+    return d->liveRecordsCount();
+}
+
+int QDbfTable::liveRow(int index) const
+{
+    return d->liveRow(index);
+}
+
+int QDbfTable::liveRecordIndex(int row) const
+{
+    return d->liveRecordIndex(row);
+}
+
 } // namespace QDbf
 
 QDebug operator<<(QDebug debug, const QDbf::QDbfTable &table)
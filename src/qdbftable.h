@@ -3,7 +3,13 @@
 
 #include "qdbf_global.h"
 
+#include <QList>
+#include <QString>
+#include <QVector>
+
 QT_BEGIN_NAMESPACE
+class QByteArray;
+class QStringList;
 class QVariant;
 QT_END_NAMESPACE
 
@@ -12,7 +18,31 @@ namespace Internal {
 class QDbfTablePrivate;
 } // namespace Internal
 
+class QDbfAggregate;
+class QDbfFilter;
 class QDbfRecord;
+class QDbfRecordView;
+class QDbfTableAppender;
+class QDbfTableCursor;
+
+// Receives the records of QDbfTable::scanParallel(). processRecord() is called
+// concurrently from up to threadCount threads, threadIndex tells them apart.
+// Returning false stops the scan after the records already in flight.
+class QDBF_EXPORT QDbfScanHandler
+{
+public:
+    virtual ~QDbfScanHandler();
+    virtual bool processRecord(const QDbfRecordView &record, int threadIndex) = 0;
+};
+
+// Receives the progress of long running operations such as QDbfTable::pack(),
+// done out of total records.
+class QDBF_EXPORT QDbfProgressHandler
+{
+public:
+    virtual ~QDbfProgressHandler();
+    virtual void progress(int done, int total) = 0;
+};
 
 class QDBF_EXPORT QDbfTable
 {
@@ -21,7 +51,10 @@ public:
         CodepageNotSet = 0,
         IBM866,
         Windows1251,
-        UnspecifiedCodepage
+        UnspecifiedCodepage,
+        IBM437,
+        IBM850,
+        Windows1252
     };
 
     enum OpenMode {
@@ -29,6 +62,12 @@ public:
         ReadWrite
     };
 
+    enum OpenOption {
+        NoOptions = 0x0,
+        MemoryMapped = 0x1
+    };
+    Q_DECLARE_FLAGS(OpenOptions, OpenOption)
+
     enum DbfTableError {
         NoError = 0,
         OpenError,
@@ -46,14 +85,29 @@ public:
     QDbfTable &operator=(const QDbfTable &other);
     ~QDbfTable();
 
-    bool open(const QString &fileName, OpenMode openMode = QDbfTable::ReadOnly);
-    bool open(OpenMode openMode = QDbfTable::ReadOnly);
+    bool open(const QString &fileName, OpenMode openMode = QDbfTable::ReadOnly,
+              OpenOptions openOptions = QDbfTable::NoOptions);
+    bool open(OpenMode openMode = QDbfTable::ReadOnly,
+              OpenOptions openOptions = QDbfTable::NoOptions);
 
     void close();
 
     QString fileName() const;
 
     QDbfTable::OpenMode openMode() const;
+    QDbfTable::OpenOptions openOptions() const;
+    bool isMapped() const;
+
+    bool setProjection(const QStringList &fieldNames);
+    bool setProjection(const QList<int> &fieldIndexes);
+    void clearProjection();
+    QList<int> projection() const;
+
+    void setReadBufferSize(int size);
+    int readBufferSize() const;
+
+    void setMemoCacheSize(int size);
+    int memoCacheSize() const;
 
     DbfTableError error() const;
 
@@ -65,21 +119,71 @@ public:
     int at() const;
     bool previous() const;
     bool next() const;
+    bool next(const QDbfFilter &filter) const;
     bool first() const;
     bool last() const;
     bool seek(int index) const;
     QDbfRecord record() const;
+    QDbfRecordView recordView() const;
     QVariant value(int index) const;
 
+    bool openIndex(const QString &fileName, const QString &tagName = QString());
+    void closeIndex();
+    bool hasIndex() const;
+    QString indexKeyExpression() const;
+    bool seekKey(const QVariant &key) const;
+    bool seekKeyRange(const QVariant &from, const QVariant &to) const;
+    bool firstKey() const;
+    bool nextKey() const;
+    bool setIndexUpdatesDeferred(bool deferred);
+    bool indexUpdatesDeferred() const;
+    bool rebuildIndex();
+
+    bool scanParallel(QDbfScanHandler *handler, int threadCount = 0) const;
+    bool scanParallel(QDbfScanHandler *handler, int first, int count, int threadCount = 0) const;
+    bool scanParallel(QDbfScanHandler *handler, const QDbfFilter &filter, int threadCount = 0) const;
+
+    QVector<QDbfAggregate> aggregate(const QStringList &fieldNames, int threadCount = 0) const;
+    QVector<QDbfAggregate> aggregate(const QStringList &fieldNames, const QDbfFilter &filter,
+                                     int threadCount = 0) const;
+
+    bool readColumn(const QString &fieldName, int first, int count, QVector<double> *values,
+                    QByteArray *validity = 0) const;
+    bool readScaledColumn(const QString &fieldName, int first, int count, QVector<qint64> *values,
+                          QByteArray *validity = 0) const;
+    bool readDateColumn(const QString &fieldName, int first, int count, QVector<qint32> *julianDays,
+                        QByteArray *validity = 0) const;
+    bool readLogicalColumn(const QString &fieldName, int first, int count, QByteArray *values,
+                           QByteArray *validity = 0) const;
+    bool readStringColumn(const QString &fieldName, int first, int count, QVector<qint32> *offsets,
+                          QByteArray *data, QByteArray *validity = 0) const;
+
     bool addRecord();
     bool addRecord(const QDbfRecord &record);
+    bool addRecords(const QVector<QDbfRecord> &records);
     bool updateRecordInTable(const QDbfRecord &record);
     bool removeRecord(int index);
+    bool pack(QDbfProgressHandler *handler = 0);
+
+    int deletedRecordsCount() const;
+    int liveRecordsCount() const;
+    int liveRow(int index) const;
+    int liveRecordIndex(int row) const;
 
 private:
     Internal::QDbfTablePrivate *d;
+
+    friend class QDbfArrowWriter;
+    friend class QDbfExporter;
+    friend class QDbfHashIndex;
+    friend class QDbfImporter;
+    friend class QDbfSortedIndex;
+    friend class QDbfTableAppender;
+    friend class QDbfTableCursor;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(QDbfTable::OpenOptions)
+
 } // namespace QDbf
 
 QDebug operator<<(QDebug, const QDbf::QDbfTable&);
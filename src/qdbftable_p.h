@@ -0,0 +1,176 @@
+#ifndef QDBFTABLE_P_H
+#define QDBFTABLE_P_H
+
+#include "qdbfdeletionmap_p.h"
+#include "qdbffield.h"
+#include "qdbfrecord.h"
+#include "qdbfrecordview.h"
+#include "qdbfschema_p.h"
+#include "qdbftable.h"
+
+#include <QFile>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+namespace QDbf {
+namespace Internal {
+
+class QDbfCodec;
+class QDbfIndexFile;
+class QDbfMemoFile;
+
+class QDbfTablePrivate
+{
+public:
+    QDbfTablePrivate();
+    QDbfTablePrivate(const QString &dbfFileName);
+    QDbfTablePrivate(const QDbfTablePrivate &other);
+    ~QDbfTablePrivate();
+
+    enum QDbfTableType
+    {
+        SimpleTable,
+        TableWithDbc
+    };
+
+    enum Location
+    {
+        BeforeFirstRow = -1,
+        FirstRow = 0
+    };
+
+    bool open(const QString &fileName, QDbfTable::OpenMode openMode = QDbfTable::ReadOnly,
+              QDbfTable::OpenOptions openOptions = QDbfTable::NoOptions);
+    bool open(QDbfTable::OpenMode openMode = QDbfTable::ReadOnly,
+              QDbfTable::OpenOptions openOptions = QDbfTable::NoOptions);
+    void close();
+
+    bool mapFile() const;
+    void unmapFile() const;
+    bool isMapped() const;
+
+    bool setProjection(const QStringList &fieldNames);
+    bool setProjection(const QList<int> &fieldIndexes);
+    void clearProjection();
+    bool applyProjection();
+    void releaseSchema();
+
+    void setReadBufferSize(int size);
+    int readBufferSize() const;
+    void setMemoCacheSize(int size);
+    int memoCacheSize() const;
+    void invalidateReadBuffer() const;
+    const char *recordPointer(int index) const;
+
+    bool setCodepage(QDbfTable::Codepage m_codepage);
+    QDbfTable::Codepage codepage() const;
+
+    bool isOpen() const;
+    int size() const;
+    int at() const;
+    bool previous() const;
+    bool next() const;
+    bool first() const;
+    bool last() const;
+    bool seek(int index) const;
+
+    QDbfRecord record() const;
+    QDbfRecordView recordView() const;
+    QVariant value(int index) const;
+    bool addRecord();
+    bool addRecord(const QDbfRecord &record);
+    bool addRecords(const QVector<QDbfRecord> &records);
+    bool writeRecords(const QByteArray &data, int count, bool updateHeader = true);
+    bool updateRecordInTable(const QDbfRecord &record);
+    bool removeRecord(int index);
+    bool pack(QDbfProgressHandler *handler);
+    bool writeRecordsCount(int recordsCount);
+
+    bool updateDeletionMap() const;
+    int deletedRecordsCount() const;
+    int liveRecordsCount() const;
+    int liveRow(int index) const;
+    int liveRecordIndex(int row) const;
+
+    bool next(const QDbfFilter &filter) const;
+
+    bool openIndex(const QString &fileName, const QString &tagName);
+    void closeIndex();
+    bool seekKey(const QVariant &from, const QVariant &to) const;
+    bool firstKey() const;
+    bool nextKey() const;
+    bool seekIndexRecord() const;
+    bool setIndexUpdatesDeferred(bool deferred);
+    bool rebuildIndex();
+    bool canUpdateIndex();
+    bool indexRecords(const char *data, int firstIndex, int count);
+
+    bool scanParallel(QDbfScanHandler *handler, const QDbfFilter *filter,
+                      int first, int count, int threadCount) const;
+    QVector<QDbfAggregate> aggregate(const QStringList &fieldNames, const QDbfFilter &filter,
+                                     int threadCount) const;
+
+    bool columnField(const QString &fieldName, int first, int count, QDbfField *field) const;
+    bool readColumn(const QString &fieldName, int first, int count, QVector<double> *values,
+                    QByteArray *validity) const;
+    bool readScaledColumn(const QString &fieldName, int first, int count, QVector<qint64> *values,
+                          QByteArray *validity) const;
+    bool readDateColumn(const QString &fieldName, int first, int count, QVector<qint32> *julianDays,
+                        QByteArray *validity) const;
+    bool readLogicalColumn(const QString &fieldName, int first, int count, QByteArray *values,
+                           QByteArray *validity) const;
+    bool readStringColumn(const QString &fieldName, int first, int count, QVector<qint32> *offsets,
+                          QByteArray *data, QByteArray *validity) const;
+
+    bool openMemoFile(quint8 versionNumber);
+    void closeMemoFile();
+
+    void setTextCodec();
+    QByteArray recordData(const QDbfRecord &record, bool addEndOfFileMark = false,
+                          const char *baseData = 0) const;
+    bool encodeRecord(const QDbfRecord &record, char *data, const char *baseData = 0) const;
+
+    QAtomicInt ref;
+    QString m_fileName;
+    mutable QDbfTable::DbfTableError m_error;
+    mutable QFile m_file;
+    QDbfTable::OpenMode m_openMode;
+    QDbfTable::OpenOptions m_openOptions;
+    mutable uchar *m_mappedData;
+    mutable qint64 m_mappedSize;
+    int m_readBufferSize;
+    mutable QByteArray m_readBuffer;
+    mutable int m_readBufferFirstIndex;
+    mutable int m_readBufferCount;
+    const QDbfCodec *m_codec;
+    QDbfTableType m_type;
+    QDbfTable::Codepage m_codepage;
+    qint16 m_headerLength;
+    qint16 m_recordLength;
+    qint16 m_fieldsCount;
+    int m_recordsCount;
+    mutable int m_currentIndex;
+    mutable bool m_bufered;
+    mutable QDbfRecord m_currentRecord;
+    QDbfRecord m_tableRecord;
+    QDbfRecord m_record;
+    QStringList m_projectionNames;
+    QList<int> m_projectionIndexes;
+    QVector<int> m_projection;
+    QDbfSchema *m_schema;
+    // every field of the stored records, for filters on raw record bytes
+    QDbfSchema *m_tableSchema;
+    QDbfIndexFile *m_index;
+    QDbfMemoFile *m_memo;
+    int m_memoCacheSize;
+    mutable QDbfDeletionMap m_deletionMap;
+    mutable bool m_deletionMapValid;
+    bool m_indexUpdatesDeferred;
+    bool m_indexStale;
+};
+
+} // namespace Internal
+} // namespace QDbf
+
+#endif // QDBFTABLE_P_H
@@ -0,0 +1,97 @@
+#include "qdbftableappender.h"
+
+#include "qdbfrecord.h"
+#include "qdbftable_p.h"
+
+#include <QDebug>
+
+namespace QDbf {
+
+QDbfTableAppender::QDbfTableAppender(QDbfTable &table, int batchSize) :
+    d(table.d),
+    m_batchSize(qMax(1, batchSize)),
+    m_pendingCount(0),
+    m_recordLength(0)
+{
+    d->ref.ref();
+}
+
+QDbfTableAppender::~QDbfTableAppender()
+{
+    flush();
+    if (!d->ref.deref()) {
+        delete d;
+    }
+}
+
+bool QDbfTableAppender::append(const QDbfRecord &record)
+{
+    if (!d->isOpen()) {
+        qWarning("QDbfTableAppender::append(): IODevice is not open");
+        return false;
+    }
+
+    if (!d->m_file.isWritable()) {
+        d->m_error = QDbfTable::WriteError;
+        return false;
+    }
+
+    if (m_pendingCount == 0) {
+        // the table may have been reopened since the last batch
+        m_recordLength = d->m_recordLength;
+        m_buffer.reserve(m_recordLength * m_batchSize + 1);
+    }
+
+    const int offset = m_buffer.size();
+    m_buffer.resize(offset + m_recordLength);
+    if (!d->encodeRecord(record, m_buffer.data() + offset)) {
+        m_buffer.resize(offset);
+        return false;
+    }
+    ++m_pendingCount;
+
+    if (m_pendingCount >= m_batchSize) {
+        return flush();
+    }
+
+    return true;
+}
+
+bool QDbfTableAppender::flush()
+{
+    if (m_pendingCount == 0) {
+        return true;
+    }
+
+    if (!d->isOpen() || m_recordLength != d->m_recordLength) {
+        qWarning("QDbfTableAppender::flush(): table was closed with pending records");
+        m_buffer.clear();
+        m_pendingCount = 0;
+        return false;
+    }
+
+    m_buffer.append(char(26));
+    const bool result = d->writeRecords(m_buffer, m_pendingCount);
+
+    m_buffer.resize(0);
+    m_pendingCount = 0;
+
+    return result;
+}
+
+int QDbfTableAppender::batchSize() const
+{
+    return m_batchSize;
+}
+
+int QDbfTableAppender::pendingCount() const
+{
+    return m_pendingCount;
+}
+
+QDbfTable::DbfTableError QDbfTableAppender::error() const
+{
+    return d->m_error;
+}
+
+} // namespace QDbf
@@ -0,0 +1,44 @@
+#ifndef QDBFTABLEAPPENDER_H
+#define QDBFTABLEAPPENDER_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+#include <QByteArray>
+
+namespace QDbf {
+namespace Internal {
+class QDbfTablePrivate;
+} // namespace Internal
+
+class QDbfRecord;
+
+// Collects appended records in one contiguous buffer and writes them to the
+// table in batches. Pending records are written by flush() or on destruction.
+class QDBF_EXPORT QDbfTableAppender
+{
+public:
+    explicit QDbfTableAppender(QDbfTable &table, int batchSize = 4096);
+    ~QDbfTableAppender();
+
+    bool append(const QDbfRecord &record);
+    bool flush();
+
+    int batchSize() const;
+    int pendingCount() const;
+
+    QDbfTable::DbfTableError error() const;
+
+private:
+    Q_DISABLE_COPY(QDbfTableAppender)
+
+    Internal::QDbfTablePrivate *d;
+    QByteArray m_buffer;
+    int m_batchSize;
+    int m_pendingCount;
+    int m_recordLength;
+};
+
+} // namespace QDbf
+
+#endif // QDBFTABLEAPPENDER_H
@@ -0,0 +1,173 @@
+#include "qdbftablecursor.h"
+
+#include "qdbffilter_p.h"
+#include "qdbfreader_p.h"
+#include "qdbfrecord.h"
+#include "qdbfrecordview.h"
+#include "qdbftable_p.h"
+
+#include <QVariant>
+
+namespace QDbf {
+namespace Internal {
+
+class QDbfTableCursorPrivate
+{
+public:
+    QDbfTableCursorPrivate();
+
+    QDbfReader m_reader;
+    int m_currentIndex;
+    bool m_bufered;
+    QDbfRecord m_currentRecord;
+};
+
+QDbfTableCursorPrivate::QDbfTableCursorPrivate() :
+    m_currentIndex(QDbfTablePrivate::BeforeFirstRow),
+    m_bufered(false)
+{
+}
+
+} // namespace Internal
+
+QDbfTableCursor::QDbfTableCursor(const QDbfTable &table) :
+    d(new Internal::QDbfTableCursorPrivate())
+{
+    if (!table.d->isOpen()) {
+        qWarning("QDbfTableCursor::QDbfTableCursor(): IODevice is not open");
+        return;
+    }
+
+    // pending writes of the table must be visible to the new file handle
+    if (table.d->m_file.isWritable()) {
+        table.d->m_file.flush();
+    }
+
+    d->m_reader.open(table.d);
+}
+
+QDbfTableCursor::~QDbfTableCursor()
+{
+    delete d;
+}
+
+bool QDbfTableCursor::isValid() const
+{
+    return d->m_reader.isOpen();
+}
+
+QDbfTable::DbfTableError QDbfTableCursor::error() const
+{
+    return d->m_reader.error();
+}
+
+int QDbfTableCursor::size() const
+{
+    return d->m_reader.size();
+}
+
+int QDbfTableCursor::at() const
+{
+    return d->m_currentIndex;
+}
+
+bool QDbfTableCursor::previous()
+{
+    if (at() <= Internal::QDbfTablePrivate::FirstRow) {
+        return false;
+    }
+
+    return seek(qMin(at(), size()) - 1);
+}
+
+bool QDbfTableCursor::next()
+{
+    if (at() >= size() - 1) {
+        return false;
+    }
+
+    return seek(at() + 1);
+}
+
+bool QDbfTableCursor::next(const QDbfFilter &filter)
+{
+    const Internal::QDbfFilterMatcher matcher(filter, d->m_reader.tableSchema(),
+                                              d->m_reader.codec());
+    if (!matcher.isValid()) {
+        return false;
+    }
+
+    for (int index = qMax(at() + 1, static_cast<int>(Internal::QDbfTablePrivate::FirstRow));
+         index < size(); ++index) {
+        const char *data = d->m_reader.recordPointer(index);
+        if (!data) {
+            return false;
+        }
+        if (matcher.matches(data)) {
+            return seek(index);
+        }
+    }
+
+    return false;
+}
+
+bool QDbfTableCursor::first()
+{
+    return seek(Internal::QDbfTablePrivate::FirstRow);
+}
+
+bool QDbfTableCursor::last()
+{
+    return seek(size() - 1);
+}
+
+bool QDbfTableCursor::seek(int index)
+{
+    const int previousIndex = d->m_currentIndex;
+
+    if (index < Internal::QDbfTablePrivate::FirstRow) {
+        d->m_currentIndex = Internal::QDbfTablePrivate::BeforeFirstRow;
+    } else if (index > (size() - 1)) {
+        d->m_currentIndex = size() - 1;
+    } else {
+        d->m_currentIndex = index;
+    }
+
+    if (previousIndex != d->m_currentIndex) {
+        d->m_bufered = false;
+    }
+
+    return d->m_currentIndex == index;
+}
+
+QDbfRecord QDbfTableCursor::record() const
+{
+    if (d->m_bufered) {
+        return d->m_currentRecord;
+    }
+
+    if (d->m_currentIndex < Internal::QDbfTablePrivate::FirstRow) {
+        return d->m_reader.emptyRecord();
+    }
+
+    d->m_currentRecord = d->m_reader.record(d->m_currentIndex);
+    d->m_bufered = true;
+
+    return d->m_currentRecord;
+}
+
+QDbfRecordView QDbfTableCursor::recordView() const
+{
+    if (d->m_currentIndex < Internal::QDbfTablePrivate::FirstRow) {
+        return QDbfRecordView();
+    }
+
+    return d->m_reader.recordView(d->m_currentIndex);
+}
+
+QVariant QDbfTableCursor::value(int index) const
+{
+    return record().value(index);
+}
+
+} // namespace QDbf
@@ -0,0 +1,53 @@
+#ifndef QDBFTABLECURSOR_H
+#define QDBFTABLECURSOR_H
+
+#include "qdbf_global.h"
+#include "qdbftable.h"
+
+QT_BEGIN_NAMESPACE
+class QVariant;
+QT_END_NAMESPACE
+
+namespace QDbf {
+namespace Internal {
+class QDbfTableCursorPrivate;
+} // namespace Internal
+
+class QDbfFilter;
+class QDbfRecord;
+class QDbfRecordView;
+
+// Independent read position over an open table. Every cursor reads through
+// a file handle and buffer of its own, so cursors created from one table may
+// be used concurrently from different threads without locking.
+class QDBF_EXPORT QDbfTableCursor
+{
+public:
+    explicit QDbfTableCursor(const QDbfTable &table);
+    ~QDbfTableCursor();
+
+    bool isValid() const;
+    QDbfTable::DbfTableError error() const;
+
+    int size() const;
+    int at() const;
+    bool previous();
+    bool next();
+    bool next(const QDbfFilter &filter);
+    bool first();
+    bool last();
+    bool seek(int index);
+
+    QDbfRecord record() const;
+    QDbfRecordView recordView() const;
+    QVariant value(int index) const;
+
+private:
+    Q_DISABLE_COPY(QDbfTableCursor)
+
+    Internal::QDbfTableCursorPrivate *d;
+};
+
+} // namespace QDbf
+
+#endif // QDBFTABLECURSOR_H
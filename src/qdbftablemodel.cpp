@@ -3,9 +3,10 @@
 #include "qdbffield.h"
 #include "qdbfrecord.h"
 
+#include <QCache>
 #include <QDebug>
 
-#define DBF_PREFETCH 255
+#define DBF_RECORD_CACHE_SIZE 1024
 
 namespace QDbf {
 namespace Internal {
@@ -32,18 +33,15 @@ public:
                        const QVariant &value, int role = Qt::DisplayRole);
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
-    bool canFetchMore(const QModelIndex &index = QModelIndex()) const;
-    void fetchMore(const QModelIndex &index = QModelIndex());
+    QDbfRecord record(int row) const;
 
     QDbfTableModel *q;
     QString m_filePath;
     bool m_readOnly;
     QDbfTable *const m_dbfTable;
     QDbfRecord m_record;
-    QVector<QDbfRecord> m_records;
+    mutable QCache<int, QDbfRecord> m_records;
     QVector<QHash<int, QVariant> > m_headers;
-    int m_deletedRecordsCount;
-    int m_lastRecordIndex;
 };
 
 QDbfTableModelPrivate::QDbfTableModelPrivate() :
@@ -51,8 +49,7 @@ QDbfTableModelPrivate::QDbfTableModelPrivate() :
     m_filePath(QString::null),
     m_readOnly(false),
     m_dbfTable(new QDbfTable()),
-    m_deletedRecordsCount(0),
-    m_lastRecordIndex(-1)
+    m_records(DBF_RECORD_CACHE_SIZE)
 {
 }
 
@@ -61,8 +58,7 @@ QDbfTableModelPrivate::QDbfTableModelPrivate(const QString &filePath) :
     m_filePath(filePath),
     m_readOnly(false),
     m_dbfTable(new QDbfTable()),
-    m_deletedRecordsCount(0),
-    m_lastRecordIndex(-1)
+    m_records(DBF_RECORD_CACHE_SIZE)
 {
 }
 
@@ -84,8 +80,6 @@ bool QDbfTableModelPrivate::open(bool readOnly)
     m_record = QDbfRecord();
     m_records.clear();
     m_headers.clear();
-    m_deletedRecordsCount = 0;
-    m_lastRecordIndex = -1;
 
     const QDbfTable::OpenMode &openMode = m_readOnly
             ? QDbfTable::ReadOnly
@@ -97,17 +91,20 @@ bool QDbfTableModelPrivate::open(bool readOnly)
 
     m_record = m_dbfTable->record();
 
-    if (canFetchMore()) {
-        fetchMore();
-    }
-
     return true;
 }
 
 int QDbfTableModelPrivate::rowCount(const QModelIndex &index) const
 {
     Q_UNUSED(index);
-    return m_records.count();
+
+    // rows are the live records, the deletion map of the table maps them
+    // to record indexes without reading the records in between
+    if (!m_dbfTable->isOpen()) {
+        return 0;
+    }
+
+    return qMax(0, m_dbfTable->liveRecordsCount());
 }
 
 int QDbfTableModelPrivate::columnCount(const QModelIndex &index) const
@@ -124,7 +121,7 @@ Qt::ItemFlags QDbfTableModelPrivate::flags(const QModelIndex &index) const
         return flags;
     }
 
-    QVariant value = m_records.at(index.row()).value(index.column());
+    QVariant value = record(index.row()).value(index.column());
 
     if (value.type() == QVariant::Bool) {
         flags |= Qt::ItemIsTristate;
@@ -146,14 +143,15 @@ bool QDbfTableModelPrivate::setData(const QModelIndex &index, const QVariant &va
     }
 
     if (index.isValid() && role == Qt::EditRole) {
-        QVariant oldValue = m_records.at(index.row()).value(index.column());
-        m_records[index.row()].setValue(index.column(), value);
+        QDbfRecord newRecord(record(index.row()));
+        newRecord.setValue(index.column(), value);
 
-        if (!m_dbfTable->updateRecordInTable(m_records.at(index.row()))) {
-            m_records[index.row()].setValue(index.column(), oldValue);
+        if (!m_dbfTable->updateRecordInTable(newRecord)) {
             return false;
         }
 
+        m_records.insert(index.row(), new QDbfRecord(newRecord));
+
         emit q->dataChanged(index, index);
 
         return true;
@@ -173,7 +171,7 @@ QVariant QDbfTableModelPrivate::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
-    QVariant value = m_records.at(index.row()).value(index.column());
+    QVariant value = record(index.row()).value(index.column());
 
     switch (role) {
     case Qt::DisplayRole:
@@ -239,46 +237,22 @@ QVariant QDbfTableModelPrivate::headerData(int section, Qt::Orientation orientat
     return QVariant();
 }
 
-bool QDbfTableModelPrivate::canFetchMore(const QModelIndex &index) const
+QDbfRecord QDbfTableModelPrivate::record(int row) const
 {
-    if (!index.isValid() && m_dbfTable->isOpen() &&
-        (m_records.size() + m_deletedRecordsCount < m_dbfTable->size())) {
-        return true;
+    const QDbfRecord *cached = m_records.object(row);
+    if (cached) {
+        return *cached;
     }
 
-    return false;
-}
-
-void QDbfTableModelPrivate::fetchMore(const QModelIndex &index)
-{
-    if (index.isValid()) {
-        return;
+    const int recordIndex = m_dbfTable->liveRecordIndex(row);
+    if (recordIndex < 0 || !m_dbfTable->seek(recordIndex)) {
+        return QDbfRecord();
     }
 
-    if (!m_dbfTable->seek(m_lastRecordIndex)) {
-        return;
-    }
-
-    const int fetchSize = qMin(m_dbfTable->size() - m_records.count() -
-                               m_deletedRecordsCount, DBF_PREFETCH);
-
-    q->beginInsertRows(index, m_records.size() + 1, m_records.size() + fetchSize);
+    const QDbfRecord result(m_dbfTable->record());
+    m_records.insert(row, new QDbfRecord(result));
 
-    int fetchedRecordsCount = 0;
-    while (m_dbfTable->next()) {
-        const QDbfRecord record(m_dbfTable->record());
-        if (record.isDeleted()) {
-            ++m_deletedRecordsCount;
-            continue;
-        }
-        m_records.append(record);
-        m_lastRecordIndex = m_dbfTable->at();
-        if (++fetchedRecordsCount >= fetchSize) {
-            break;
-        }
-    }
-
-    q->endInsertRows();
+    return result;
 }
 
 } // namespace Internal
@@ -312,6 +286,22 @@ bool QDbfTableModel::open(bool readOnly)
     return d->open(readOnly);
 }
 
+bool QDbfTableModel::setProjection(const QStringList &fieldNames)
+{
+    // the table keeps its projection when the new one is rejected, and so
+    // does the model
+    beginResetModel();
+    const bool result = d->m_dbfTable->setProjection(fieldNames);
+    if (result) {
+        d->m_record = d->m_dbfTable->record();
+        d->m_records.clear();
+        d->m_headers.clear();
+    }
+    endResetModel();
+
+    return result;
+}
+
 bool QDbfTableModel::readOnly() const
 {
     return d->m_readOnly;
@@ -357,14 +347,4 @@ bool QDbfTableModel::setData(const QModelIndex &index, const QVariant &value, in
     return d->setData(index, value, role);
 }
 
-bool QDbfTableModel::canFetchMore(const QModelIndex &index) const
-{
-    return d->canFetchMore(index);
-}
-
-void QDbfTableModel::fetchMore(const QModelIndex &index)
-{
-    d->fetchMore(index);
-}
-
 } // namespace QDbf
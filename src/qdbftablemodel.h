@@ -22,6 +22,8 @@ public:
     bool open(const QString &filePath, bool readOnly = false);
     bool open(bool readOnly = false);
 
+    bool setProjection(const QStringList &fieldNames);
+
     void close();
 
     bool readOnly() const;
@@ -41,9 +43,6 @@ public:
 
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
-    bool canFetchMore(const QModelIndex &index = QModelIndex()) const;
-    void fetchMore(const QModelIndex &index = QModelIndex());
-
 private:
     Internal::QDbfTableModelPrivate *const d;
 
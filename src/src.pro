@@ -8,13 +8,58 @@ INCLUDEPATH += $$PWD
 DEPENDPATH += $$INCLUDEPATH
 
 SOURCES += \
+    qdbfaggregate.cpp \
+    qdbfarrowwriter.cpp \
+    qdbfcdxindex.cpp \
+    qdbfcodec.cpp \
+    qdbfdeletionmap.cpp \
+    qdbfexporter.cpp \
     qdbffield.cpp \
+    qdbffilter.cpp \
+    qdbfhashindex.cpp \
+    qdbfimporter.cpp \
+    qdbfindex.cpp \
+    qdbfindexexpression.cpp \
+    qdbfmdxindex.cpp \
+    qdbfmemofile.cpp \
+    qdbfndxindex.cpp \
+    qdbfnumeric.cpp \
+    qdbfreader.cpp \
     qdbfrecord.cpp \
+    qdbfrecordview.cpp \
+    qdbfschema.cpp \
+    qdbfsortedindex.cpp \
     qdbftable.cpp \
+    qdbftableappender.cpp \
+    qdbftablecursor.cpp \
     qdbftablemodel.cpp
 HEADERS += \
+    qdbfaggregate.h \
+    qdbfaggregate_p.h \
+    qdbfarrowwriter.h \
+    qdbfcdxindex_p.h \
+    qdbfcodec_p.h \
+    qdbfdeletionmap_p.h \
+    qdbfexporter.h \
     qdbffield.h \
+    qdbffilter.h \
+    qdbffilter_p.h \
+    qdbfhashindex.h \
+    qdbfimporter.h \
+    qdbfindex_p.h \
+    qdbfindexexpression_p.h \
+    qdbfmdxindex_p.h \
+    qdbfmemofile_p.h \
+    qdbfndxindex_p.h \
+    qdbfnumeric_p.h \
+    qdbfreader_p.h \
     qdbfrecord.h \
+    qdbfrecordview.h \
+    qdbfschema_p.h \
+    qdbfsortedindex.h \
     qdbftable.h \
+    qdbftable_p.h \
+    qdbftableappender.h \
+    qdbftablecursor.h \
     qdbftablemodel.h \
     qdbf_global.h